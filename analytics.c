@@ -0,0 +1,118 @@
+#include "headers/business_logic_internal.h"
+
+// Reports over the whole catalog. They read nothing but the price and stock columns, see
+// merch_columns_t, front to back.
+//
+// Each loop goes through the columns Lane_block merch at a time, with an inner loop of exactly
+// Lane_block steps and no calls or branches in it. A loop of a known length is what gcc -O2
+// turns into SIMD code, so the inner loops run several merch per instruction. The few merch
+// after the last whole block are done one by one.
+//
+// Prices are at least 1 and stocks never go below 0, so the products and sums are done unsigned,
+// which every SIMD instruction set can widen to 64 bits.
+
+#define Lane_block 16
+
+long long bl_total_stock_value(db_t *db)
+{
+    load_snapshot_merch(db);
+    const int *restrict prices = db->columns.prices;
+    const int *restrict stocks = db->columns.stocks;
+    int size = db->columns.size;
+    unsigned long long total = 0;
+    int id = 0;
+    
+    for(; id + Lane_block <= size; id += Lane_block)
+    {
+        unsigned long long block = 0;
+        for(int lane = 0; lane < Lane_block; ++lane)
+        {
+            block += (unsigned long long) (unsigned int) prices[id + lane] * (unsigned int) stocks[id + lane];
+        }
+        total += block;
+    }
+    for(; id < size; ++id)
+    {
+        total += (unsigned long long) (unsigned int) prices[id] * (unsigned int) stocks[id];
+    }
+    return (long long) total;
+}
+
+size_t bl_count_low_stock(db_t *db, int below)
+{
+    load_snapshot_merch(db);
+    const int *restrict stocks = db->columns.stocks;
+    int size = db->columns.size;
+    size_t count = 0;
+    int id = 0;
+    
+    for(; id + Lane_block <= size; id += Lane_block)
+    {
+        int block = 0;
+        for(int lane = 0; lane < Lane_block; ++lane)
+        {
+            block += stocks[id + lane] < below;
+        }
+        count += block;
+    }
+    for(; id < size; ++id)
+    {
+        count += stocks[id] < below;
+    }
+    return count;
+}
+
+bool bl_price_stats(db_t *db, bl_price_stats_t *stats)
+{
+    load_snapshot_merch(db);
+    const int *restrict prices = db->columns.prices;
+    int size = db->columns.size;
+    if(size == 0)
+    {
+        return false;
+    }
+    
+    int lowest[Lane_block];     //Lane i holds the lowest price of the merch at i, i + Lane_block, ...
+    int highest[Lane_block];
+    unsigned long long sums[Lane_block];
+    for(int lane = 0; lane < Lane_block; ++lane)
+    {
+        lowest[lane]    = prices[0];
+        highest[lane]   = prices[0];
+        sums[lane]      = 0;
+    }
+    
+    int id = 0;
+    for(; id + Lane_block <= size; id += Lane_block)
+    {
+        for(int lane = 0; lane < Lane_block; ++lane)
+        {
+            int price = prices[id + lane];
+            lowest[lane]    = price < lowest[lane] ? price : lowest[lane];
+            highest[lane]   = price > highest[lane] ? price : highest[lane];
+            sums[lane]     += (unsigned int) price;
+        }
+    }
+    
+    int min = lowest[0];
+    int max = highest[0];
+    unsigned long long sum = 0;
+    for(int lane = 0; lane < Lane_block; ++lane)
+    {
+        min  = lowest[lane] < min ? lowest[lane] : min;
+        max  = highest[lane] > max ? highest[lane] : max;
+        sum += sums[lane];
+    }
+    for(; id < size; ++id)
+    {
+        min  = prices[id] < min ? prices[id] : min;
+        max  = prices[id] > max ? prices[id] : max;
+        sum += (unsigned int) prices[id];
+    }
+    
+    stats->no_merch     = size;
+    stats->min_price    = min;
+    stats->max_price    = max;
+    stats->avg_price    = (double) sum / size;
+    return true;
+}
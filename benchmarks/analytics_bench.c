@@ -0,0 +1,96 @@
+#include "../headers/business_logic_internal.h"
+#include <time.h>
+
+// Measures the catalog reports, bl_total_stock_value, bl_count_low_stock and bl_price_stats,
+// against the same sums made the old way, by ioopm_hash_table_apply_to_all calling a function
+// for every merch.
+// Usage: analytics_bench [no_merch] [no_runs]
+
+typedef struct scan scan_t;
+
+struct scan
+{
+    db_t        *db;
+    long long   value;
+    size_t      low;
+    int         below;
+    int         min_price;
+    int         max_price;
+    long long   price_sum;
+};
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void scan_apply(ioopm_hash_table_t *ht, elem_t name, elem_t id, void *arg)
+{
+    scan_t *scan = arg;
+    merch_t *merch = scan->db->columns.records[id.int_val];
+    int price = merch_price(merch);
+    int stock = merch_stock(merch);
+    
+    scan->value += (long long) price * stock;
+    scan->low   += stock < scan->below;
+    scan->min_price = price < scan->min_price ? price : scan->min_price;
+    scan->max_price = price > scan->max_price ? price : scan->max_price;
+    scan->price_sum += price;
+}
+
+int main(int argc, char *argv[])
+{
+    int no_merch    = argc > 1 ? atoi(argv[1]) : 1000000;
+    int no_runs     = argc > 2 ? atoi(argv[2]) : 20;
+    int below       = 10;
+    
+    db_t *db = create_webstore();
+    char name[32];
+    char shelf[16];
+    unsigned int seed = 42;
+    double start = now();
+    for(int i = 0; i < no_merch; ++i)
+    {
+        sprintf(name, "merch%d", i);
+        sprintf(shelf, "%c%d", 'A' + i % 26, i / 26);
+        bl_add_merchandise(db, name, strdup("benchmark merch"), 1 + rand_r(&seed) % 1000);
+        bl_replenish(db, name, shelf, rand_r(&seed) % 100);
+    }
+    printf("merch: %d, runs: %d, stocked in %.1fs\n", no_merch, no_runs, now() - start);
+    
+    scan_t scan = { .db = db, .below = below };
+    start = now();
+    for(int run = 0; run < no_runs; ++run)
+    {
+        scan = (scan_t) { .db = db, .below = below, .min_price = 1 << 30 };
+        ioopm_hash_table_apply_to_all(db->merch, scan_apply, &scan);
+    }
+    double callback_s = (now() - start) / no_runs;
+    
+    long long value = 0;
+    size_t low = 0;
+    bl_price_stats_t stats;
+    start = now();
+    for(int run = 0; run < no_runs; ++run)
+    {
+        value   = bl_total_stock_value(db);
+        low     = bl_count_low_stock(db, below);
+        bl_price_stats(db, &stats);
+    }
+    double columns_s = (now() - start) / no_runs;
+    
+    if(value != scan.value || low != scan.low || stats.min_price != scan.min_price || stats.max_price != scan.max_price
+       || stats.avg_price != (double) scan.price_sum / no_merch)
+    {
+        printf("the reports do not match the callback scan\n");
+        return 1;
+    }
+    printf("value %lld, %zu merch below %d, prices %d-%d, avg %.2f\n", value, low, below, stats.min_price, stats.max_price, stats.avg_price);
+    printf("apply_to_all callbacks: %8.3f ms per scan, %6.2f ns per merch\n", callback_s * 1e3, callback_s * 1e9 / no_merch);
+    printf("column reports:         %8.3f ms per scan, %6.2f ns per merch\n", columns_s * 1e3, columns_s * 1e9 / no_merch);
+    
+    destroy_webstore(db);
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "../headers/business_logic.h"
+#include <time.h>
+
+// Measures carts checked out per second, one by one with bl_checkout and in
+// batches with bl_checkout_batch.
+// Usage: checkout_bench [no_carts] [no_merch] [items_per_cart] [no_workers]
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static db_t *create_stocked_webstore(int no_merch, int stock_per_merch)
+{
+    db_t *db = create_webstore();
+    char name[32];
+    char shelf[16];
+    
+    for(int i = 0; i < no_merch; ++i)
+    {
+        sprintf(name, "merch%d", i);
+        bl_add_merchandise(db, name, strdup("benchmark merch"), 1 + i % 100);
+        for(int s = 0; s < 4; ++s)      //Four shelves per merch
+        {
+            sprintf(shelf, "%c%d", 'A' + s, i);
+            bl_replenish(db, name, shelf, stock_per_merch / 4 + 1);
+        }
+    }
+    return db;
+}
+
+static void fill_carts(db_t *db, int *cart_ids, int no_carts, int no_merch, int items_per_cart)
+{
+    char name[32];
+    unsigned int seed = 42;
+    
+    for(int i = 0; i < no_carts; ++i)
+    {
+        cart_ids[i] = bl_create_cart(db);
+        for(int j = 0; j < items_per_cart; ++j)
+        {
+            sprintf(name, "merch%d", rand_r(&seed) % no_merch);
+            bl_add_to_cart(db, cart_ids[i], name, 1);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int no_carts        = argc > 1 ? atoi(argv[1]) : 20000;
+    int no_merch        = argc > 2 ? atoi(argv[2]) : 5000;
+    int items_per_cart  = argc > 3 ? atoi(argv[3]) : 5;
+    int no_workers      = argc > 4 ? atoi(argv[4]) : 0;
+    int stock           = no_carts * items_per_cart / no_merch * 4 + 8;
+    
+    int *cart_ids = calloc(no_carts, sizeof(int));
+    bool *results = calloc(no_carts, sizeof(bool));
+    
+    db_t *db = create_stocked_webstore(no_merch, stock);
+    fill_carts(db, cart_ids, no_carts, no_merch, items_per_cart);
+    double start = now();
+    for(int i = 0; i < no_carts; ++i)
+    {
+        bl_checkout(db, cart_ids[i]);
+    }
+    double sequential = now() - start;
+    destroy_webstore(db);
+    
+    db = create_stocked_webstore(no_merch, stock);
+    fill_carts(db, cart_ids, no_carts, no_merch, items_per_cart);
+    start = now();
+    size_t checked_out = bl_checkout_batch(db, cart_ids, no_carts, results, no_workers);
+    double batched = now() - start;
+    destroy_webstore(db);
+    
+    printf("carts: %d, merch: %d, items per cart: %d\n", no_carts, no_merch, items_per_cart);
+    printf("bl_checkout:       %10.0f carts/s\n", no_carts / sequential);
+    printf("bl_checkout_batch: %10.0f carts/s (%zu checked out)\n", checked_out / batched, checked_out);
+    
+    free(cart_ids);
+    free(results);
+    return 0;
+}
@@ -0,0 +1,384 @@
+#include "../headers/protocol.h"
+
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// Load generator for the store server. It stocks the store with merch, then every connection
+// creates a few carts and sends a mix of cart operations and stock lookups, keeping up to
+// depth requests in flight. Reports requests per second and latency percentiles, where the
+// latency of a request is the time from when it is sent to when its response is read.
+// Usage: load_client [-u socket_path | -t port] [-c connections] [-n requests_per_connection]
+//                    [-d depth] [-m no_merch]
+
+#define Carts_per_connection    16
+#define Max_request_bytes       128     //Enough for every request this client sends
+#define Read_size               (64 << 10)
+
+typedef struct options options_t;
+typedef struct connection connection_t;
+typedef struct worker worker_t;
+
+struct options
+{
+    char                *socket_path;
+    int                 port;
+    int                 no_connections;
+    int                 no_requests;
+    int                 depth;
+    int                 no_merch;
+};
+
+struct connection
+{
+    int                 fd;
+    char                *out;           //Requests not yet sent
+    size_t              out_used;
+    char                in[Read_size];
+    size_t              in_used;
+    size_t              in_read;        //Responses before this have been taken
+    uint32_t            next_tag;
+    uint32_t            expected_tag;
+};
+
+struct worker
+{
+    options_t           *options;
+    int                 worker_no;
+    pthread_t           thread;
+    pthread_barrier_t   *start;
+    uint64_t            *latencies;     //Of every request, in ns
+    unsigned long       no_failed;
+    bool                broken;         //The connection failed or the server broke the protocol
+};
+
+static uint64_t now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*=================================================================
+ *  Connections
+ *=================================================================*/
+
+static bool open_connection(options_t *options, connection_t *conn, size_t max_queued)
+{
+    memset(conn, 0, sizeof(connection_t));
+    if(options->port > 0)
+    {
+        struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(options->port) };
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int no_delay = 1;
+        conn->fd = socket(AF_INET, SOCK_STREAM, 0);
+        setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+        if(connect(conn->fd, (struct sockaddr *) &addr, sizeof(addr)) != 0)
+        {
+            close(conn->fd);
+            return false;
+        }
+    }
+    else
+    {
+        struct sockaddr_un addr = { .sun_family = AF_UNIX };
+        strncpy(addr.sun_path, options->socket_path, sizeof(addr.sun_path) - 1);
+        conn->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(connect(conn->fd, (struct sockaddr *) &addr, sizeof(addr)) != 0)
+        {
+            close(conn->fd);
+            return false;
+        }
+    }
+    
+    conn->out = malloc(max_queued * Max_request_bytes);
+    return true;
+}
+
+static void close_connection(connection_t *conn)
+{
+    close(conn->fd);
+    free(conn->out);
+}
+
+static void queue_request(connection_t *conn, operation_t *op)
+{
+    conn->out_used += encode_request(conn->out + conn->out_used, conn->next_tag++, op);
+}
+
+static bool send_requests(connection_t *conn)
+{
+    char *buf = conn->out;
+    while(conn->out_used > 0)
+    {
+        ssize_t sent = write(conn->fd, buf, conn->out_used);
+        if(sent <= 0)
+        {
+            return false;
+        }
+        buf += sent;
+        conn->out_used -= sent;
+    }
+    return true;
+}
+
+//True if a response has been read and not yet taken
+static bool has_response(connection_t *conn)
+{
+    return conn->in_used - conn->in_read >= Response_size;
+}
+
+//Takes the next response, reading from the socket if needed. Returns false if the connection
+//broke or the response is not for the oldest request in flight
+static bool next_response(connection_t *conn, bool *succeeded, int *result)
+{
+    if(!has_response(conn))
+    {
+        memmove(conn->in, conn->in + conn->in_read, conn->in_used - conn->in_read);
+        conn->in_used -= conn->in_read;
+        conn->in_read = 0;
+        while(!has_response(conn))
+        {
+            ssize_t received = read(conn->fd, conn->in + conn->in_used, Read_size - conn->in_used);
+            if(received <= 0)
+            {
+                return false;
+            }
+            conn->in_used += received;
+        }
+    }
+    
+    uint32_t tag;
+    decode_response(conn->in + conn->in_read, &tag, succeeded, result);
+    conn->in_read += Response_size;
+    return tag == conn->expected_tag++;
+}
+
+//Sends the queued requests and takes all their responses
+static bool run_queued(connection_t *conn, int no_requests, int *results, unsigned long *no_failed)
+{
+    if(!send_requests(conn))
+    {
+        return false;
+    }
+    for(int i = 0; i < no_requests; ++i)
+    {
+        bool succeeded;
+        int result;
+        if(!next_response(conn, &succeeded, &result))
+        {
+            return false;
+        }
+        *no_failed += succeeded ? 0 : 1;
+        if(results != NULL)
+        {
+            results[i] = result;
+        }
+    }
+    return true;
+}
+
+/*=================================================================
+ *  Load
+ *=================================================================*/
+
+//Adds the merch and puts plenty of each on a shelf. Merch that already exist are left as they are
+static bool stock_store(options_t *options)
+{
+    connection_t conn;
+    if(!open_connection(options, &conn, 2 * options->no_merch))
+    {
+        return false;
+    }
+    
+    char name[32];
+    char shelf[16];
+    unsigned long no_failed = 0;
+    for(int i = 0; i < options->no_merch; ++i)
+    {
+        operation_t replenish = { .kind = Op_replenish, .name = name, .amount = 1000000 };
+        sprintf(name, "merch%d", i);
+        sprintf(shelf, "%c%d", 'A' + i % 26, i / 26);
+        parse_shelf_id(shelf, &replenish.shelf_id);
+        queue_request(&conn, &(operation_t) { .kind = Op_add_merch, .name = name, .desc = "load test merch", .price = 1 + i % 100 });
+        queue_request(&conn, &replenish);
+    }
+    bool stocked = run_queued(&conn, 2 * options->no_merch, NULL, &no_failed);
+    close_connection(&conn);
+    return stocked;
+}
+
+static void queue_random_request(connection_t *conn, int *cart_ids, int no_merch, unsigned int *seed)
+{
+    char name[32];
+    int cart_id = cart_ids[rand_r(seed) % Carts_per_connection];
+    int roll = rand_r(seed) % 100;
+    sprintf(name, "merch%d", rand_r(seed) % no_merch);
+    
+    if(roll < 40)
+    {
+        queue_request(conn, &(operation_t) { .kind = Op_add_to_cart, .cart_id = cart_id, .name = name, .amount = 1 });
+    }
+    else if(roll < 50)
+    {
+        queue_request(conn, &(operation_t) { .kind = Op_remove_from_cart, .cart_id = cart_id, .name = name, .amount = 1 });
+    }
+    else if(roll < 75)
+    {
+        queue_request(conn, &(operation_t) { .kind = Op_calculate_cost, .cart_id = cart_id });
+    }
+    else
+    {
+        queue_request(conn, &(operation_t) { .kind = Op_available_stock, .name = name });
+    }
+}
+
+static void *run_worker(void *arg)
+{
+    worker_t *worker = arg;
+    options_t *options = worker->options;
+    int depth = options->depth;
+    int no_requests = options->no_requests;
+    unsigned int seed = 42 + worker->worker_no;
+    connection_t conn;
+    int cart_ids[Carts_per_connection];
+    uint64_t *sent_at = calloc(depth, sizeof(uint64_t));   //Indexed by request number % depth
+    
+    worker->broken = !open_connection(options, &conn, depth > Carts_per_connection ? depth : Carts_per_connection);
+    for(int i = 0; !worker->broken && i < Carts_per_connection; ++i)
+    {
+        queue_request(&conn, &(operation_t) { .kind = Op_create_cart });
+    }
+    worker->broken = worker->broken || !run_queued(&conn, Carts_per_connection, cart_ids, &worker->no_failed);
+    pthread_barrier_wait(worker->start);
+    
+    int sent = 0;
+    int received = 0;
+    while(!worker->broken && received < no_requests)
+    {
+        uint64_t now = now_ns();
+        for(; sent < no_requests && sent - received < depth; ++sent)
+        {
+            queue_random_request(&conn, cart_ids, options->no_merch, &seed);
+            sent_at[sent % depth] = now;
+        }
+        worker->broken = !send_requests(&conn);
+        
+        do  //Take at least one response, then all that have already arrived
+        {
+            bool succeeded;
+            int result;
+            if(worker->broken || !next_response(&conn, &succeeded, &result))
+            {
+                worker->broken = true;
+                break;
+            }
+            worker->latencies[received] = now_ns() - sent_at[received % depth];
+            worker->no_failed += succeeded ? 0 : 1;
+            ++received;
+        }
+        while(has_response(&conn));
+    }
+    
+    if(conn.out != NULL)
+    {
+        close_connection(&conn);
+    }
+    free(sent_at);
+    return NULL;
+}
+
+static int compare_latencies(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_us(uint64_t *sorted, size_t count, double percentile)
+{
+    size_t index = (size_t) (percentile / 100 * (count - 1));
+    return sorted[index] / 1e3;
+}
+
+int main(int argc, char *argv[])
+{
+    options_t options = { .socket_path = "webstore.sock", .no_connections = 4, .no_requests = 100000, .depth = 32, .no_merch = 1000 };
+    for(int i = 1; i + 1 < argc; i += 2)
+    {
+        char *value = argv[i + 1];
+        switch(argv[i][0] == '-' ? argv[i][1] : '?')
+        {
+            case 'u': options.socket_path = value; break;
+            case 't': options.port = atoi(value); break;
+            case 'c': options.no_connections = atoi(value); break;
+            case 'n': options.no_requests = atoi(value); break;
+            case 'd': options.depth = atoi(value); break;
+            case 'm': options.no_merch = atoi(value); break;
+            default:
+                fprintf(stderr, "usage: load_client [-u socket_path | -t port] [-c connections] [-n requests_per_connection] "
+                                "[-d depth] [-m no_merch]\n");
+                return 1;
+        }
+    }
+    if(options.no_connections < 1 || options.no_requests < 1 || options.depth < 1 || options.no_merch < 1)
+    {
+        fprintf(stderr, "all counts must be positive\n");
+        return 1;
+    }
+    
+    if(!stock_store(&options))
+    {
+        fprintf(stderr, "could not stock the store\n");
+        return 1;
+    }
+    
+    size_t total = (size_t) options.no_connections * options.no_requests;
+    uint64_t *latencies = calloc(total, sizeof(uint64_t));
+    worker_t *workers = calloc(options.no_connections, sizeof(worker_t));
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, options.no_connections + 1);
+    
+    for(int i = 0; i < options.no_connections; ++i)
+    {
+        workers[i] = (worker_t) { .options = &options, .worker_no = i, .start = &start,
+                                  .latencies = latencies + (size_t) i * options.no_requests };
+        pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]);
+    }
+    pthread_barrier_wait(&start);   //Every connection has its carts
+    uint64_t start_time = now_ns();
+    
+    unsigned long no_failed = 0;
+    bool broken = false;
+    for(int i = 0; i < options.no_connections; ++i)
+    {
+        pthread_join(workers[i].thread, NULL);
+        no_failed += workers[i].no_failed;
+        broken = broken || workers[i].broken;
+    }
+    double seconds = (now_ns() - start_time) / 1e9;
+    pthread_barrier_destroy(&start);
+    
+    if(broken)
+    {
+        fprintf(stderr, "a connection to the server failed\n");
+    }
+    else
+    {
+        qsort(latencies, total, sizeof(uint64_t), compare_latencies);
+        printf("connections: %d, depth: %d, requests: %zu (%lu failed)\n", options.no_connections, options.depth, total, no_failed);
+        printf("throughput: %.0f requests/s\n", total / seconds);
+        printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n", percentile_us(latencies, total, 50),
+               percentile_us(latencies, total, 90), percentile_us(latencies, total, 99), percentile_us(latencies, total, 99.9),
+               latencies[total - 1] / 1e3);
+    }
+    
+    free(latencies);
+    free(workers);
+    return broken ? 1 : 0;
+}
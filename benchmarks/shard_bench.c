@@ -0,0 +1,153 @@
+#include "../headers/sharded_store.h"
+#include <time.h>
+#include <unistd.h>
+
+// Measures operations per second on one store and on sharded stores of 1, 2, 4, ... shards.
+// Every round creates carts, fills them with merch picked at random among no_merch while
+// asking for costs and stock, then checks them all out and restocks.
+// Usage: shard_bench [no_rounds] [carts_per_round] [no_merch] [max_shards]
+
+#define Items_per_cart 5
+
+typedef struct bench bench_t;
+
+struct bench
+{
+    db_t            *db;            //Either db or sdb is used
+    sharded_db_t    *sdb;
+    operation_t     *ops;
+    bool            *succeeded;
+    int             *results;
+    char            **names;
+    int             *shelf_ids;     //shelf_ids[i] is the shelf of merch i
+    int             no_merch;
+    int             carts_per_round;
+    unsigned int    seed;
+};
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run_ops(bench_t *bench, size_t no_ops)
+{
+    if(bench->sdb)
+    {
+        bl_sharded_apply_batch(bench->sdb, bench->ops, no_ops, bench->succeeded, bench->results);
+        return;
+    }
+    for(size_t i = 0; i < no_ops; ++i)
+    {
+        bench->succeeded[i] = apply_operation(bench->db, &bench->ops[i], &bench->results[i]);
+    }
+}
+
+static void stock_catalog(bench_t *bench)
+{
+    size_t no_ops = 0;
+    for(int i = 0; i < bench->no_merch; ++i)
+    {
+        bench->ops[no_ops++] = (operation_t) { .kind = Op_add_merch, .name = bench->names[i], .desc = "benchmark merch", .price = 1 + i % 100 };
+        bench->ops[no_ops++] = (operation_t) { .kind = Op_replenish, .name = bench->names[i], .shelf_id = bench->shelf_ids[i], .amount = 1000000 };
+    }
+    run_ops(bench, no_ops);
+}
+
+//Returns the number of operations applied
+static size_t run_round(bench_t *bench)
+{
+    int no_carts = bench->carts_per_round;
+    int cart_ids[no_carts];
+    size_t no_ops = 0;
+    
+    for(int i = 0; i < no_carts; ++i)
+    {
+        bench->ops[i] = (operation_t) { .kind = Op_create_cart };
+    }
+    run_ops(bench, no_carts);
+    memcpy(cart_ids, bench->results, sizeof(cart_ids));
+    
+    for(int i = 0; i < no_carts; ++i)
+    {
+        for(int j = 0; j < Items_per_cart; ++j)
+        {
+            char *name = bench->names[rand_r(&bench->seed) % bench->no_merch];
+            bench->ops[no_ops++] = (operation_t) { .kind = Op_add_to_cart, .cart_id = cart_ids[i], .name = name, .amount = 1 };
+            bench->ops[no_ops++] = (operation_t) { .kind = Op_available_stock, .name = name };
+        }
+        bench->ops[no_ops++] = (operation_t) { .kind = Op_calculate_cost, .cart_id = cart_ids[i] };
+    }
+    for(int i = 0; i < no_carts; ++i)
+    {
+        bench->ops[no_ops++] = (operation_t) { .kind = Op_checkout, .cart_id = cart_ids[i] };
+        int merch = rand_r(&bench->seed) % bench->no_merch;
+        bench->ops[no_ops++] = (operation_t) { .kind = Op_replenish, .name = bench->names[merch], .shelf_id = bench->shelf_ids[merch], .amount = Items_per_cart };
+    }
+    run_ops(bench, no_ops);
+    return no_carts + no_ops;
+}
+
+static double run_bench(bench_t *bench, int no_rounds)
+{
+    bench->seed = 42;
+    stock_catalog(bench);
+    
+    size_t no_ops = 0;
+    double start = now();
+    for(int i = 0; i < no_rounds; ++i)
+    {
+        no_ops += run_round(bench);
+    }
+    return no_ops / (now() - start);
+}
+
+int main(int argc, char *argv[])
+{
+    int no_rounds       = argc > 1 ? atoi(argv[1]) : 50;
+    int carts_per_round = argc > 2 ? atoi(argv[2]) : 2000;
+    int no_merch        = argc > 3 ? atoi(argv[3]) : 20000;
+    int max_shards      = argc > 4 ? atoi(argv[4]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    
+    size_t max_ops = 2 * no_merch + carts_per_round * (2 * Items_per_cart + 3);
+    bench_t bench = { .no_merch = no_merch, .carts_per_round = carts_per_round };
+    bench.ops       = calloc(max_ops, sizeof(operation_t));
+    bench.succeeded = calloc(max_ops, sizeof(bool));
+    bench.results   = calloc(max_ops, sizeof(int));
+    bench.names     = calloc(no_merch, sizeof(char *));
+    bench.shelf_ids = calloc(no_merch, sizeof(int));
+    char shelf[16];
+    for(int i = 0; i < no_merch; ++i)
+    {
+        bench.names[i] = malloc(16);
+        sprintf(bench.names[i], "merch%d", i);
+        sprintf(shelf, "%c%d", 'A' + i % 26, i / 26);
+        parse_shelf_id(shelf, &bench.shelf_ids[i]);
+    }
+    
+    printf("rounds: %d, carts per round: %d, merch: %d\n", no_rounds, carts_per_round, no_merch);
+    bench.db = create_webstore();
+    printf("one store:  %10.0f ops/s\n", run_bench(&bench, no_rounds));
+    destroy_webstore(bench.db);
+    bench.db = NULL;
+    
+    for(int no_shards = 1; no_shards <= max_shards; no_shards *= 2)
+    {
+        bench.sdb = bl_create_sharded(no_shards);
+        printf("%2d shards: %10.0f ops/s\n", no_shards, run_bench(&bench, no_rounds));
+        bl_destroy_sharded(bench.sdb);
+    }
+    
+    for(int i = 0; i < no_merch; ++i)
+    {
+        free(bench.names[i]);
+    }
+    free(bench.names);
+    free(bench.shelf_ids);
+    free(bench.ops);
+    free(bench.succeeded);
+    free(bench.results);
+    return 0;
+}
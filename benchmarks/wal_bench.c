@@ -0,0 +1,79 @@
+#include "../headers/business_logic.h"
+#include <time.h>
+
+// Measures the cost of logging changes to a store kept on disk: changes per second and
+// commit latency when every change waits for its own sync, and when a batch checkout
+// commits many changes with one sync.
+// Usage: wal_bench [dir] [no_changes] [no_carts]
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void print_stats(char *label, bl_log_stats_t *before, bl_log_stats_t *after, int no_changes, double time)
+{
+    unsigned long no_commits = after->no_commits - before->no_commits;
+    unsigned long no_syncs = after->no_syncs - before->no_syncs;
+    printf("%-22s %10.0f changes/s, %6lu syncs, %8.1f us per commit (max %.1f us)\n", label, no_changes / time,
+           no_syncs, no_commits ? (after->commit_ns - before->commit_ns) / 1e3 / no_commits : 0.0,
+           after->max_commit_ns / 1e3);
+}
+
+int main(int argc, char *argv[])
+{
+    char *dir       = argc > 1 ? argv[1] : "wal_bench_store";
+    int no_changes  = argc > 2 ? atoi(argv[2]) : 5000;
+    int no_carts    = argc > 3 ? atoi(argv[3]) : 20000;
+    
+    db_t *db = bl_open_store(dir);
+    if(db == NULL)
+    {
+        fprintf(stderr, "could not open %s\n", dir);
+        return 1;
+    }
+    bl_log_stats_t start_stats, end_stats;
+    char name[32];
+    char shelf[16];
+    
+    bl_log_stats(db, &start_stats);
+    double start = now();
+    for(int i = 0; i < no_changes; ++i)
+    {
+        sprintf(name, "merch%d", i);
+        sprintf(shelf, "A%d", i);
+        bl_add_merchandise(db, name, strdup("benchmark merch"), 1 + i % 100);
+        bl_replenish(db, name, shelf, no_carts);
+    }
+    double single = now() - start;
+    bl_log_stats(db, &end_stats);
+    print_stats("one change per sync:", &start_stats, &end_stats, 2 * no_changes, single);
+    
+    int *cart_ids = calloc(no_carts, sizeof(int));
+    bool *results = calloc(no_carts, sizeof(bool));
+    for(int i = 0; i < no_carts; ++i)
+    {
+        sprintf(name, "merch%d", i % no_changes);
+        cart_ids[i] = bl_create_cart(db);
+        bl_add_to_cart(db, cart_ids[i], name, 1);
+    }
+    
+    bl_log_stats(db, &start_stats);
+    start = now();
+    size_t checked_out = bl_checkout_batch(db, cart_ids, no_carts, results, 0);
+    double batched = now() - start;
+    bl_log_stats(db, &end_stats);
+    print_stats("batch checkout:", &start_stats, &end_stats, checked_out, batched);
+    
+    start = now();
+    destroy_webstore(db);
+    db = bl_open_store(dir);
+    printf("%-22s %10.3f s to reopen, %lu bytes logged\n", "replay:", now() - start, end_stats.no_bytes);
+    destroy_webstore(db);
+    
+    free(cart_ids);
+    free(results);
+    return 0;
+}
@@ -1,54 +1,84 @@
 #include "headers/business_logic.h"
+#include "headers/business_logic_internal.h"
 #include "headers/generic_utils.h"
-#include "quicksort/q-sort.h"
 
 #include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
 
-struct webstore_db
+bool int_key_eq(elem_t k1, elem_t k2)
 {
-    ioopm_hash_table_t  *merch;
-    ioopm_hash_table_t  *storage;
-    ioopm_hash_table_t  *carts;
-    int                 carts_created;
-};
+    return k1.int_val == k2.int_val;
+}
 
-typedef struct webstore_db db_t;
 
-struct merch
+static bool shelf_comp(elem_t a, elem_t b)
 {
-    char            *name;
-    char            *desc;
-    int             price;
-    int             stock;
-    ioopm_list_t    *locs;
-};
-
-typedef struct merch merch_t;
+    shelf_t *shelf_a = a.ptr_val;
+    shelf_t *shelf_b = b.ptr_val;
+    return(shelf_a->shelf_id == shelf_b->shelf_id);
+}
 
-struct shelf
-{
-    char    *shelf_name;
-    int     quantity;
-};
+/*=================================================================
+ *  Shelf identifiers
+ *=================================================================*/
 
-typedef struct shelf shelf_t;
+// A shelf name is one letter followed by 1-6 digits, e.g. "A25". It is packed as
+// | letter (bits 23-27) | digit count (bits 20-22) | number (bits 0-19) |
+// The digit count is kept so that "A5" and "A05" stay different shelves.
+// The letter is never 0, so a packed id is always a valid (positive) hash key.
+#define Shelf_number_bits   20
+#define Shelf_digits_bits   3
+#define Shelf_max_digits    6
 
-static bool string_key_eq(elem_t k1, elem_t k2)
+bool parse_shelf_id(char *shelf_name, int *shelf_id)
 {
-  return (strcmp(k1.str_val, k2.str_val) == 0);    ; // if elem_t has field char *string
+    if(!isalpha(shelf_name[0]))
+    {
+        return false;
+    }
+    
+    int letter = toupper(shelf_name[0]) - 'A' + 1;
+    int number = 0;
+    int digits = 0;
+    for(char *c = shelf_name + 1; *c != '\0'; ++c, ++digits)
+    {
+        if(!is_digit(*c) || digits == Shelf_max_digits)
+        {
+            return false;
+        }
+        number = number * 10 + (*c - '0');
+    }
+    if(digits == 0)
+    {
+        return false;
+    }
+    
+    *shelf_id = (letter << (Shelf_number_bits + Shelf_digits_bits)) | (digits << Shelf_number_bits) | number;
+    return true;
 }
 
-static bool int_key_eq(elem_t k1, elem_t k2)
+void shelf_id_to_name(int shelf_id, char *buf)
 {
-    return k1.int_val == k2.int_val;
+    int number  = shelf_id & ((1 << Shelf_number_bits) - 1);
+    int digits  = (shelf_id >> Shelf_number_bits) & ((1 << Shelf_digits_bits) - 1);
+    int letter  = shelf_id >> (Shelf_number_bits + Shelf_digits_bits);
+    
+    sprintf(buf, "%c%0*d", 'A' + letter - 1, digits, number);
 }
 
-
-static bool shelf_comp(elem_t a, elem_t b)
+bool valid_shelf_id(int shelf_id)
 {
-    shelf_t *shelf_a = a.ptr_val;
-    shelf_t *shelf_b = b.ptr_val;
-    return(strcmp(shelf_a->shelf_name, shelf_b->shelf_name) == 0);
+    int number  = shelf_id & ((1 << Shelf_number_bits) - 1);
+    int digits  = (shelf_id >> Shelf_number_bits) & ((1 << Shelf_digits_bits) - 1);
+    int letter  = shelf_id >> (Shelf_number_bits + Shelf_digits_bits);
+    
+    int limit = 1;
+    for(int i = 0; i < digits; ++i)
+    {
+        limit *= 10;
+    }
+    return letter >= 1 && letter <= 'Z' - 'A' + 1 && digits >= 1 && digits <= Shelf_max_digits && number < limit;
 }
 
 /*=================================================================
@@ -67,6 +97,22 @@ int string_knr_hash(elem_t key)
     return result % INT_MAX;
 }
 
+static int name_cmp(elem_t a, elem_t b)
+{
+    return strcmp(a.str_val, b.str_val);
+}
+
+static int price_cmp(elem_t a, elem_t b)
+{
+    merch_t *merch_a = a.ptr_val;
+    merch_t *merch_b = b.ptr_val;
+    if(merch_price(merch_a) != merch_price(merch_b))
+    {
+        return merch_price(merch_a) < merch_price(merch_b) ? -1 : 1;
+    }
+    return strcmp(merch_a->name, merch_b->name);
+}
+
 int int_knr_hash(elem_t key)
 {
     return key.int_val;
@@ -75,54 +121,161 @@ int int_knr_hash(elem_t key)
 db_t *create_webstore()
 {
     db_t *webstore = calloc(1, sizeof(db_t));
-    webstore->merch         = ioopm_hash_table_create(string_key_eq, string_key_eq, string_knr_hash);
-    webstore->storage       = ioopm_hash_table_create(string_key_eq, string_key_eq, string_knr_hash);
-    webstore->carts         = ioopm_hash_table_create(int_key_eq, false, int_knr_hash);
+    webstore->tables        = ioopm_allocator_create(&ioopm_heap_vtable, NULL);
+    webstore->merch         = ioopm_hash_table_create_with_allocator(ioopm_interned_eq, false, ioopm_interned_hash, webstore->tables);
+    webstore->storage       = ioopm_hash_table_create_with_allocator(int_key_eq, ioopm_interned_eq, int_knr_hash, webstore->tables);
+    webstore->carts         = ioopm_slot_map_create();
+    webstore->names         = ioopm_string_pool_create();
+    webstore->merch_names   = ioopm_sorted_array_create(name_cmp);
+    webstore->merch_by_price = ioopm_sorted_array_create(price_cmp);
+    webstore->low_stock     = ioopm_indexed_heap_create();
+    webstore->scratch       = ioopm_arena_create(64 << 10);
     webstore->carts_created = 0;
+#ifdef BL_PROFILE
+    webstore->profile       = create_profile();
+#endif
     
     return webstore;
 }
 
+bool destroy_merch(db_t *db, char *merch_name);
+bool bl_remove_cart(db_t *db, int cart_id);
+
+static void remove_cart_apply(int cart_id, elem_t ignored, void *db)
+{
+    bl_remove_cart(db, cart_id);
+}
+
 void destroy_webstore(db_t *webstore)
 {
+    if(webstore->wal)
+    {
+        close_log(webstore);    //Tearing the store down is not a change to log
+    }
+    ioopm_slot_map_apply_to_all(webstore->carts, remove_cart_apply, webstore);
+    ioopm_sorted_array_destroy(&webstore->merch_names);   //Before the merch, so they are not taken out of it one by one
+    ioopm_sorted_array_destroy(&webstore->merch_by_price);
+    ioopm_indexed_heap_destroy(&webstore->low_stock);
+    destroy_desc_index(webstore);
+    while(webstore->free_carts)
+    {
+        cart_t *next = webstore->free_carts->next_free;
+        ioopm_hash_table_destroy(&webstore->free_carts->items);
+        free(webstore->free_carts);
+        webstore->free_carts = next;
+    }
+    
+    ioopm_arena_push_frame(webstore->scratch);
+    ioopm_list_t *merch_names = ioopm_hash_table_keys_in(webstore->merch, webstore->scratch);
+    ioopm_list_iterator_t *iter = ioopm_list_iterator(merch_names);
+    elem_t name;
+    
+    bool has_next = ioopm_iterator_current(iter, &name);
+    while(has_next)
+    {
+        destroy_merch(webstore, name.str_val);  //Also destroys the shelves the merch is stored on
+        has_next = ioopm_iterator_next(iter, &name);
+    }
+    ioopm_arena_pop_frame(webstore->scratch);
+    
     ioopm_hash_table_destroy(&webstore->merch);
     ioopm_hash_table_destroy(&webstore->storage);
-    ioopm_hash_table_destroy(&webstore->carts);
+    ioopm_allocator_destroy(&webstore->tables);
+    ioopm_slot_map_destroy(&webstore->carts);
+    if(webstore->cart_timers)
+    {
+        ioopm_timer_wheel_destroy(&webstore->cart_timers);
+    }
+    ioopm_string_pool_destroy(&webstore->names);
+    if(webstore->texts)
+    {
+        ioopm_arena_destroy(&webstore->texts);
+    }
+    if(webstore->snapshot)
+    {
+        close_snapshot(webstore);
+    }
+    ioopm_arena_destroy(&webstore->scratch);
+#ifdef BL_PROFILE
+    destroy_profile(webstore->profile);
+#endif
+    free(webstore->columns.prices);
+    free(webstore->columns.stocks);
+    free(webstore->columns.records);
     free(webstore);
-    
+
+}
+
+ioopm_allocator_stats_t bl_table_memory(db_t *db)
+{
+    return ioopm_allocator_stats(db->tables);
 }
 //------------------------------------------------------------------------------------------------------------------------
 //------------------------------------------------------------------------------------------------------------------------
 //------------------------------------------------------------------------------------------------------------------------
 //------------------------------ Start of add merchandise
 
-merch_t *create_merch(char *merch_name, char *merch_desc, int merch_price)
+merch_t *create_merch(db_t *db, char *merch_name, char *merch_desc, int merch_price)
 {
+    merch_columns_t *columns = &db->columns;
+    if(columns->size == columns->capacity)
+    {
+        columns->capacity = columns->capacity ? columns->capacity * 2 : 64;
+        columns->prices  = realloc(columns->prices, columns->capacity * sizeof(int));
+        columns->stocks  = realloc(columns->stocks, columns->capacity * sizeof(int));
+        columns->records = realloc(columns->records, columns->capacity * sizeof(merch_t *));
+    }
+    
     merch_t *new_merch = calloc(1, sizeof(merch_t));
     new_merch->name     = merch_name;
     new_merch->desc     = merch_desc;
-    new_merch->price    = merch_price;
-    new_merch->stock    = 0;            //When new merch is added, stock is always 0.
-    new_merch->locs     = ioopm_linked_list_create(shelf_comp);
+    new_merch->owns_desc = true;
+    new_merch->columns  = columns;
+    new_merch->id       = columns->size++;
+    columns->records[new_merch->id] = new_merch;
+    merch_price(new_merch) = merch_price;
+    merch_stock(new_merch) = 0;         //When new merch is added, stock is always 0.
+    atomic_init(&new_merch->reserved, 0);
+    atomic_init(&new_merch->available, 0);
+    new_merch->locs     = ioopm_hash_table_create(int_key_eq, shelf_comp, int_knr_hash);
+    new_merch->carts    = ioopm_hash_table_create(int_key_eq, false, int_knr_hash);
     return new_merch;
 }
 
 bool merch_exists(db_t *db, char *merch_name)
 {
-    elem_t ignore_value;
-    return ioopm_hash_table_lookup(db->merch, str_elem(merch_name), &ignore_value);
+    return get_merch(db, merch_name) != NULL;
 }
 
 bool bl_add_merchandise(db_t *db, char *merch_name, char *merch_desc, int price)
 {
+    PROFILE_OP(db, Prof_add_merchandise);
     if(merch_exists(db, merch_name) || price < 1)
     {
         return false; //The merch already exists or an invalid price has been set, nothing will be done
     }
     
-    merch_t *new_merch = create_merch(merch_name, merch_desc, price);
-    
-    return ioopm_hash_table_insert(db->merch, str_elem(merch_name), ptr_elem(new_merch));
+    char *name = ioopm_string_pool_intern(db->names, merch_name);
+    insert_merch(db, create_merch(db, name, merch_desc, price));
+    return commit_operation(db, &(operation_t) { .kind = Op_add_merch, .name = name, .desc = merch_desc, .price = price });
+}
+
+void insert_merch(db_t *db, merch_t *merch)
+{
+    ioopm_hash_table_insert(db->merch, str_elem(merch->name), int_elem(merch->id));
+    ioopm_sorted_array_insert(db->merch_names, str_elem(merch->name));
+    ioopm_sorted_array_insert(db->merch_by_price, ptr_elem(merch));
+    merch->stock_handle = ioopm_indexed_heap_insert(db->low_stock, merch_stock(merch), ptr_elem(merch));
+    index_desc(db, merch);
+}
+
+///@brief moves a merch whose stock changed to its new place in db->low_stock
+static void stock_changed(db_t *db, merch_t *merch)
+{
+    if(db->low_stock)
+    {
+        ioopm_indexed_heap_update(db->low_stock, merch->stock_handle, merch_stock(merch));
+    }
 }
 
 //------------------------------ End of add merchandise
@@ -136,50 +289,62 @@ bool bl_add_merchandise(db_t *db, char *merch_name, char *merch_desc, int price)
 //------------------------------------------------------------------------------------------------------------------------
 //------------------------------------------------------------------------------------------------------------------------
 //------------------------------ Start of remove merchandise
+merch_t *get_interned_merch(db_t *db, char *name)
+{
+    elem_t id;
+    
+    if(!ioopm_hash_table_lookup(db->merch, str_elem(name), &id))  //No trip through the pool, name is already canonical
+    {
+        return load_snapshot_name(db, name);
+    }
+    return db->columns.records[id.int_val];
+}
+
 merch_t *get_merch(db_t *db, char *merch_name)
 {
-    merch_t *merch;
-    elem_t hashed_merch;
+    char *name = ioopm_string_pool_lookup(db->names, merch_name);
+    if(name == NULL)
+    {
+        return load_snapshot_name(db, merch_name); //No merch has this name, unless one in the snapshot is not built yet
+    }
+    
+    return get_interned_merch(db, name);
+}
 
-    ioopm_hash_table_lookup(db->merch, str_elem(merch_name), &hashed_merch);
+shelf_t *get_shelf(merch_t *merch, int shelf_id)
+{
+    elem_t hashed_shelf = ptr_elem(NULL);
+    
+    ioopm_hash_table_lookup(merch->locs, int_elem(shelf_id), &hashed_shelf);
     
-    merch = (merch_t *) hashed_merch.ptr_val;
-    return merch;
+    return (shelf_t *) hashed_shelf.ptr_val;
 }
 
 
-void destroy_shelf(db_t *db, char *shelf_name)
+void destroy_shelf(db_t *db, int shelf_id)
 {
     elem_t result;
     elem_t gotten_shelf;
-    ioopm_hash_table_lookup(db->storage, str_elem(shelf_name), &result);
+    if(!ioopm_hash_table_lookup(db->storage, int_elem(shelf_id), &result))
+    {
+        return; //The shelf is not in use, nothing to destroy
+    }
     
     merch_t *merch;
     merch = get_merch(db, result.str_val);
     
-    ioopm_list_t *list = merch->locs;
-    int no_of_storage_locs = ioopm_linked_list_size(list);
-    int i = 0;
-    shelf_t *shelf;
-    for(; i < no_of_storage_locs; i++)
+    ioopm_hash_table_remove(merch->locs, int_elem(shelf_id), &gotten_shelf);
+    shelf_t *shelf = (shelf_t *) gotten_shelf.ptr_val;
+    merch_stock(merch) -= shelf->quantity;
+    atomic_fetch_sub(&merch->available, shelf->quantity);
+    stock_changed(db, merch);
+    
+    ioopm_hash_table_remove(db->storage, int_elem(shelf_id), &result);  //The name is borrowed from the merch
+    free(shelf);
+    if(db->shelves)
     {
-        
-        gotten_shelf = ioopm_linked_list_get(list, i);
-        shelf = (shelf_t *) gotten_shelf.ptr_val;
-        
-        if(strcmp(shelf->shelf_name, shelf_name)==0)
-        {
-            ioopm_linked_list_remove(list, i, &gotten_shelf); 
-            free(shelf->shelf_name);
-            free(shelf);
-            i = no_of_storage_locs; //We break the loop
-        }
-        
-        
+        release_shelf(db, shelf_id);
     }
-    
-    free(result.str_val);
-    ioopm_hash_table_remove(db->storage, str_elem(shelf_name), &result);
 }
 
 
@@ -190,23 +355,62 @@ void destroy_stock(db_t *db, char *merch_name)
     merch = get_merch(db, merch_name);
     
     elem_t res;
-    ioopm_list_iterator_t *iter = ioopm_list_iterator(merch->locs);
+    ioopm_arena_push_frame(db->scratch);
+    ioopm_list_t *shelves = ioopm_hash_table_values_in(merch->locs, db->scratch);  //A copy, so the shelves can be destroyed while iterating
+    ioopm_list_iterator_t *iter = ioopm_list_iterator(shelves);
     
-    bool has_next = true;
+    bool has_next = ioopm_iterator_current(iter, &res);
     shelf_t *shelf;
     
     while(has_next)
     {
-        
-        ioopm_iterator_current(iter, &res);
+    
         shelf = (shelf_t *) res.ptr_val;
-        destroy_shelf(db, shelf->shelf_name);
+        destroy_shelf(db, shelf->shelf_id);
         has_next = ioopm_iterator_next(iter, &res);
-        
+    
     }
     
-    ioopm_iterator_destroy(&iter);
+    ioopm_arena_pop_frame(db->scratch);
+}
+
+void remove_from_all_carts(db_t *db, merch_t *merch)
+{
+    ioopm_arena_push_frame(db->scratch);
+    ioopm_list_t *carts = ioopm_hash_table_values_in(merch->carts, db->scratch);
+    ioopm_list_iterator_t *iter = ioopm_list_iterator(carts);
+    elem_t res;
+    elem_t amount;
     
+    bool has_next = ioopm_iterator_current(iter, &res);
+    while(has_next)
+    {
+        cart_t *cart = (cart_t *) res.ptr_val;
+        ioopm_hash_table_remove(cart->items, str_elem(merch->name), &amount);
+        cart->total -= amount.int_val * merch_price(merch);
+        has_next = ioopm_iterator_next(iter, &res);
+    }
+    
+    ioopm_arena_pop_frame(db->scratch);
+    ioopm_hash_table_clear(merch->carts);
+}
+
+///@brief gives the id of a merch that is being destroyed to the last merch in db->columns
+static void remove_from_columns(db_t *db, merch_t *merch)
+{
+    merch_columns_t *columns = &db->columns;
+    int last = --columns->size;
+    if(merch->id == last)
+    {
+        return;
+    }
+    
+    merch_t *moved = columns->records[last];
+    columns->prices[merch->id]  = columns->prices[last];
+    columns->stocks[merch->id]  = columns->stocks[last];
+    columns->records[merch->id] = moved;
+    moved->id = merch->id;
+    ioopm_hash_table_insert(db->merch, str_elem(moved->name), int_elem(moved->id));
 }
 
 bool destroy_merch(db_t *db, char *merch_name)
@@ -214,18 +418,32 @@ bool destroy_merch(db_t *db, char *merch_name)
     merch_t *merch;
     merch = get_merch(db, merch_name);
     
-    if(merch->stock > 0) //The merch has no stock
+    if(!ioopm_hash_table_is_empty(merch->locs)) //The merch is stored on at least one shelf
     {
         destroy_stock(db, merch_name);
     }
     
-    ioopm_linked_list_destroy(merch->locs);
+    ioopm_hash_table_destroy(&merch->locs);
+    
+    remove_from_all_carts(db, merch);
+    ioopm_hash_table_destroy(&merch->carts);
     
     elem_t ignore_value;
     bool remove_result;        
-    remove_result = ioopm_hash_table_remove(db->merch, str_elem(merch_name), &ignore_value);
-    free(merch->name);
-    free(merch->desc);
+    remove_result = ioopm_hash_table_remove(db->merch, str_elem(merch->name), &ignore_value);
+    if(db->merch_names)
+    {
+        ioopm_sorted_array_remove(db->merch_names, str_elem(merch->name));
+        ioopm_sorted_array_remove(db->merch_by_price, ptr_elem(merch));
+        ioopm_indexed_heap_remove(db->low_stock, merch->stock_handle);
+    }
+    remove_from_columns(db, merch);     //After merch_by_price, which reads the price
+    ioopm_string_pool_release(db->names, merch->name);   //merch_name may be this very string, so it is not used after this
+    unindex_desc(db, merch);
+    if(merch->owns_desc)
+    {
+        free(merch->desc);
+    }
     free(merch);
     
     
@@ -234,14 +452,16 @@ bool destroy_merch(db_t *db, char *merch_name)
 
 bool bl_remove_merchandise(db_t *db, char *merch_name)
 {
+    PROFILE_OP(db, Prof_remove_merchandise);
     if(!merch_exists(db, merch_name))
     {
         return false; //The merch does not exist. Nothing is removed
     }
     
+    log_operation(db, &(operation_t) { .kind = Op_remove_merch, .name = merch_name });
     destroy_merch(db, merch_name);
     
-    return true;
+    return commit_log(db);
 }
 
 //------------------------------ End of remove merchandise
@@ -254,99 +474,787 @@ bool bl_remove_merchandise(db_t *db, char *merch_name)
 //------------------------------------------------------------------------------------------------------------------------
 //------------------------------------------------------------------------------------------------------------------------
 //------------------------------------------------------------------------------------------------------------------------
-//------------------------------ Start of list merchandise
+//------------------------------ Start of edit merchandise
 
-char **get_all_keys(ioopm_hash_table_t *ht)
+void rename_merch(db_t *db, merch_t *merch, char *new_name)
 {
+    elem_t ignore_value;
+    char *old_name = merch->name;
+    char *name = ioopm_string_pool_intern(db->names, new_name);
     
-    size_t no_keys = ioopm_hash_table_size(ht);
-    char **keys = calloc(no_keys, sizeof(char*));
-    if(no_keys > 0)
+    ioopm_sorted_array_remove(db->merch_by_price, ptr_elem(merch));   //Ordered by name among equal prices, so out while the name changes
+    ioopm_hash_table_remove(db->merch, str_elem(old_name), &ignore_value);
+    ioopm_hash_table_insert(db->merch, str_elem(name), int_elem(merch->id));
+    ioopm_sorted_array_remove(db->merch_names, str_elem(old_name));
+    ioopm_sorted_array_insert(db->merch_names, str_elem(name));
+    
+    ioopm_arena_push_frame(db->scratch);
+    ioopm_list_t *shelf_ids = ioopm_hash_table_keys_in(merch->locs, db->scratch);
+    ioopm_list_iterator_t *shelf_iter = ioopm_list_iterator(shelf_ids);
+    elem_t shelf_id;
+    bool has_shelf = ioopm_iterator_current(shelf_iter, &shelf_id);
+    while(has_shelf)
     {
-        
-        ioopm_list_t *list = ioopm_hash_table_keys(ht);
-        
-        ioopm_list_iterator_t *iter = ioopm_list_iterator(list);
-        elem_t res;
-        
-        bool iter_has_value = ioopm_iterator_current(iter, &res);
-        
-        for(int i = 0; iter_has_value; i++)
+        ioopm_hash_table_insert(db->storage, shelf_id, str_elem(name));
+        has_shelf = ioopm_iterator_next(shelf_iter, &shelf_id);
+    }
+    
+    ioopm_list_t *carts = ioopm_hash_table_values_in(merch->carts, db->scratch);
+    ioopm_list_iterator_t *cart_iter = ioopm_list_iterator(carts);
+    elem_t res;
+    elem_t amount;
+    bool has_cart = ioopm_iterator_current(cart_iter, &res);
+    while(has_cart)
+    {
+        cart_t *cart = (cart_t *) res.ptr_val;
+        ioopm_hash_table_remove(cart->items, str_elem(old_name), &amount);
+        ioopm_hash_table_insert(cart->items, str_elem(name), amount);
+        has_cart = ioopm_iterator_next(cart_iter, &res);
+    }
+    ioopm_arena_pop_frame(db->scratch);
+    
+    merch->name = name;
+    ioopm_sorted_array_insert(db->merch_by_price, ptr_elem(merch));
+    ioopm_string_pool_release(db->names, old_name);
+}
+
+void reprice_merch(db_t *db, merch_t *merch, int new_price)
+{
+    ioopm_arena_push_frame(db->scratch);
+    ioopm_list_t *carts = ioopm_hash_table_values_in(merch->carts, db->scratch);
+    ioopm_list_iterator_t *iter = ioopm_list_iterator(carts);
+    elem_t res;
+    elem_t amount;
+    
+    bool has_next = ioopm_iterator_current(iter, &res);
+    while(has_next)
+    {
+        cart_t *cart = (cart_t *) res.ptr_val;
+        ioopm_hash_table_lookup(cart->items, str_elem(merch->name), &amount);
+        cart->total += amount.int_val * (new_price - merch_price(merch));  //Only the carts holding this merch are touched
+        has_next = ioopm_iterator_next(iter, &res);
+    }
+    
+    ioopm_arena_pop_frame(db->scratch);
+    ioopm_sorted_array_remove(db->merch_by_price, ptr_elem(merch));
+    merch_price(merch) = new_price;
+    ioopm_sorted_array_insert(db->merch_by_price, ptr_elem(merch));
+}
+
+bool bl_edit_merchandise(db_t *db, char *merch_name, char *new_name, char *new_desc, int new_price)
+{
+    PROFILE_OP(db, Prof_edit_merchandise);
+    merch_t *merch = get_merch(db, merch_name);
+    if(merch == NULL || new_price < 1)
+    {
+        return false; //The merch does not exist or an invalid price has been set, nothing is edited
+    }
+    
+    merch_t *other = get_merch(db, new_name);
+    if(other != NULL && other != merch)
+    {
+        return false; //The new name is already taken by another merch
+    }
+    
+    log_operation(db, &(operation_t) { .kind = Op_edit_merch, .name = merch_name, .new_name = new_name,
+                                       .desc = new_desc, .price = new_price });  //Before merch_name may be released by the rename
+    if(other == NULL)
+    {
+        rename_merch(db, merch, new_name);
+    }
+    if(new_price != merch_price(merch))
+    {
+        reprice_merch(db, merch, new_price);
+    }
+    unindex_desc(db, merch);
+    if(merch->owns_desc)
+    {
+        free(merch->desc);
+    }
+    merch->desc = new_desc;
+    merch->owns_desc = true;
+    index_desc(db, merch);
+    
+    return commit_log(db);
+}
+
+//------------------------------ End of edit merchandise
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+
+
+
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------ Start of replenish
+
+shelf_t *create_shelf(int shelf_id, int quantity)
+{
+    shelf_t *new_shelf = calloc(1, sizeof(shelf_t));
+    new_shelf->shelf_id     = shelf_id;
+    new_shelf->quantity     = quantity;
+    return new_shelf;
+}
+
+bool bl_replenish(db_t *db, char *merch_name, char *shelf_name, int amount)
+{
+    PROFILE_OP(db, Prof_replenish);
+    int shelf_id;
+    merch_t *merch = get_merch(db, merch_name);
+    if(merch == NULL || amount < 1 || !parse_shelf_id(shelf_name, &shelf_id))
+    {
+        return false; //The merch does not exist or an invalid amount or shelf was given, nothing is stocked
+    }
+    
+    if(!stock_shelf(db, merch, shelf_id, amount))
+    {
+        return false; //The shelf holds another merch
+    }
+    
+    return commit_operation(db, &(operation_t) { .kind = Op_replenish, .name = merch->name, .shelf_id = shelf_id, .amount = amount });
+}
+
+bool stock_shelf(db_t *db, merch_t *merch, int shelf_id, int amount)
+{
+    shelf_t *shelf = get_shelf(merch, shelf_id);
+    if(shelf == NULL)
+    {
+        elem_t ignore_value;
+        load_snapshot_shelf(db, shelf_id);     //Its merch may not be built yet
+        if(ioopm_hash_table_lookup(db->storage, int_elem(shelf_id), &ignore_value))
         {
-            keys[i] = res.str_val;
-            iter_has_value = ioopm_iterator_next(iter, &res);
+            return false; //The shelf already holds another merch
+        }
+        if(db->shelves && !claim_shelf(db, shelf_id))
+        {
+            return false; //The shelf holds a merch on another shard
         }
         
-        ioopm_iterator_destroy(&iter);
-        return keys;
+        shelf = create_shelf(shelf_id, 0);
+        ioopm_hash_table_insert(merch->locs, int_elem(shelf_id), ptr_elem(shelf));
+        ioopm_hash_table_insert(db->storage, int_elem(shelf_id), str_elem(merch->name));
     }
     
-    //There are no merch 
-    free(keys);
-    keys = calloc(1, sizeof(char*));
-    keys[0] = NULL;
-    return keys;
+    shelf->quantity += amount;
+    merch_stock(merch) += amount;
+    atomic_fetch_add(&merch->available, amount);
+    stock_changed(db, merch);
+    return true;
 }
 
+//------------------------------ End of replenish
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+
+
+
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------ Start of list merchandise
 
 void bl_list_merchandise(db_t *db)
 {
-    size_t no_merch = ioopm_hash_table_size(db->merch);
+    PROFILE_OP(db, Prof_list_merchandise);
+    load_snapshot_merch(db);
+    size_t no_merch = ioopm_sorted_array_size(db->merch_names);
+    bool continue_listing = true;
+    int loop_counter = 0;
     
-    if(no_merch > 0)
+    for(size_t i = 0; i < no_merch && continue_listing; ++i)
     {
-        char **all_merch;
-        
-        all_merch = get_all_keys(db->merch);
-        no_merch = ioopm_hash_table_size(db->merch);
+        printf("%zu. %s\n", i+1, ioopm_sorted_array_get(db->merch_names, i).str_val);
         
-        sort_keys(all_merch, no_merch);
+        loop_counter++;
         
-        bool continue_listing = true;
-        int i = 0;
-        int loop_counter = 0;
-        
-        while(i < no_merch && continue_listing)
+        while(loop_counter > 19)
         {
-            printf("%d. %s\n", i+1, all_merch[i]);
-            
-            loop_counter++;
+            int ans;
+            ans = ask_question_int("continue listing?\n y/n\n");
             
-            while(loop_counter > 19)
+            if(ans == 'y')
             {
-                int ans;
-                ans = ask_question_int("continue listing?\n y/n\n");
-                
-                if(ans == 'y')
-                {
-                    loop_counter = 0;
-                }
-                if(ans == 'n')
-                {
-                    continue_listing = false;
-                }
+                loop_counter = 0;
             }
-            
+            if(ans == 'n')
+            {
+                continue_listing = false;
+                break;
+            }
+        }
+    
+    }
+
+}
+
+size_t bl_find_merch_by_prefix(db_t *db, char *prefix, char **names, size_t max_names)
+{
+    PROFILE_OP(db, Prof_find_merch_by_prefix);
+    load_snapshot_merch(db);
+    size_t prefix_length = strlen(prefix);
+    size_t no_merch = ioopm_sorted_array_size(db->merch_names);
+    size_t no_found = 0;
+    
+    //Names with the prefix are all together, starting where the prefix itself would go
+    for(size_t i = ioopm_sorted_array_lower_bound(db->merch_names, str_elem(prefix)); i < no_merch && no_found < max_names; ++i)
+    {
+        char *name = ioopm_sorted_array_get(db->merch_names, i).str_val;
+        if(strncmp(name, prefix, prefix_length) != 0)
+        {
+            break;
+        }
+        names[no_found++] = name;
+    }
+    return no_found;
+}
+
+size_t bl_find_merch_by_price(db_t *db, int min_price, int max_price, size_t skip, char **names, size_t max_names)
+{
+    PROFILE_OP(db, Prof_find_merch_by_price);
+    load_snapshot_merch(db);
+    merch_columns_t probe = { .prices = &min_price };
+    merch_t first = { .name = "", .columns = &probe, .id = 0 };  //Goes before every merch priced min_price
+    size_t no_merch = ioopm_sorted_array_size(db->merch_by_price);
+    size_t no_found = 0;
+    
+    for(size_t i = ioopm_sorted_array_lower_bound(db->merch_by_price, ptr_elem(&first)) + skip; i < no_merch && no_found < max_names; ++i)
+    {
+        merch_t *merch = ioopm_sorted_array_get(db->merch_by_price, i).ptr_val;
+        if(merch_price(merch) > max_price)
+        {
+            break;
         }
+        names[no_found++] = merch->name;
+    }
+    return no_found;
+}
+
+//------------------------------ End of list merchandise
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+
+
+
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------ Start of carts
+
+cart_t *get_cart(db_t *db, int cart_id)
+{
+    elem_t hashed_cart = ptr_elem(NULL);
+    
+    ioopm_slot_map_lookup(db->carts, cart_id, &hashed_cart);  //Fails for ids of removed carts, even if their slot is reused
+    return (cart_t *) hashed_cart.ptr_val;
+}
+
+int cart_amount(cart_t *cart, merch_t *merch)
+{
+    elem_t amount = int_elem(0);
+    ioopm_hash_table_lookup(cart->items, str_elem(merch->name), &amount);
+    return amount.int_val;
+}
+
+cart_t *create_cart(db_t *db)
+{
+    cart_t *new_cart = db->free_carts;
+    if(new_cart != NULL)
+    {
+        db->free_carts = new_cart->next_free;   //Its items were cleared when it was removed
+    }
+    else
+    {
+        new_cart = calloc(1, sizeof(cart_t));
+        new_cart->items = ioopm_hash_table_create(ioopm_interned_eq, false, ioopm_interned_hash);
+    }
+    new_cart->total     = 0;
+    new_cart->timer     = No_timer;
+    new_cart->next_free = NULL;
+    return new_cart;
+}
+
+int bl_create_cart(db_t *db)
+{
+    PROFILE_OP(db, Prof_create_cart);
+    cart_t *new_cart    = create_cart(db);
+    new_cart->cart_id   = ioopm_slot_map_insert(db->carts, ptr_elem(new_cart));
+    if(new_cart->cart_id == 0)
+    {
+        new_cart->next_free = db->free_carts;
+        db->free_carts = new_cart;
+        return 0; //No ids are left, nothing is created
+    }
+    db->carts_created  += 1;
+    schedule_cart_expiry(db, new_cart);
+    if(!commit_operation(db, &(operation_t) { .kind = Op_create_cart, .cart_id = new_cart->cart_id }))
+    {
+        remove_cart(db, new_cart, true);
+        return 0; //The log has failed, the cart is not handed out
+    }
+    
+    return new_cart->cart_id;
+}
+
+bool reserve_stock(merch_t *merch, int amount)
+{
+    int available = atomic_load(&merch->available);
+    do
+    {
+        if(available < amount)
+        {
+            return false; //Everything else is already in other carts
+        }
+    }
+    while(!atomic_compare_exchange_weak(&merch->available, &available, available - amount));
+    
+    atomic_fetch_add(&merch->reserved, amount);
+    return true;
+}
+
+void release_stock(merch_t *merch, int amount)
+{
+    atomic_fetch_sub(&merch->reserved, amount);
+    atomic_fetch_add(&merch->available, amount);
+}
+
+void remove_cart(db_t *db, cart_t *cart, bool release_reservations)
+{
+    ioopm_arena_push_frame(db->scratch);
+    ioopm_list_t *names = ioopm_hash_table_keys_in(cart->items, db->scratch);
+    ioopm_list_iterator_t *iter = ioopm_list_iterator(names);
+    elem_t name;
+    elem_t ignore_value;
+    
+    bool has_next = ioopm_iterator_current(iter, &name);
+    while(has_next)
+    {
+        merch_t *merch = get_interned_merch(db, name.str_val);
+        ioopm_hash_table_remove(merch->carts, int_elem(cart->cart_id), &ignore_value);
+        if(release_reservations)
+        {
+            release_stock(merch, cart_amount(cart, merch));
+        }
+        has_next = ioopm_iterator_next(iter, &name);
+    }
+    ioopm_arena_pop_frame(db->scratch);
+    
+    cancel_cart_expiry(db, cart);
+    ioopm_slot_map_remove(db->carts, cart->cart_id, &ignore_value);
+    ioopm_hash_table_clear(cart->items);
+    cart->next_free = db->free_carts;
+    db->free_carts = cart;
+}
+
+bool bl_remove_cart(db_t *db, int cart_id)
+{
+    PROFILE_OP(db, Prof_remove_cart);
+    cart_t *cart = get_cart(db, cart_id);
+    if(cart == NULL)
+    {
+        return false; //The cart does not exist, nothing is removed
+    }
+    
+    remove_cart(db, cart, true);
+    return commit_operation(db, &(operation_t) { .kind = Op_remove_cart, .cart_id = cart_id });
+}
+
+bool bl_add_to_cart(db_t *db, int cart_id, char *merch_name, int amount)
+{
+    PROFILE_OP(db, Prof_add_to_cart);
+    cart_t *cart = get_cart(db, cart_id);
+    merch_t *merch = get_merch(db, merch_name);
+    if(cart == NULL || merch == NULL || amount < 1)
+    {
+        return false; //The cart or merch does not exist or an invalid amount was given
+    }
+    
+    if(!reserve_stock(merch, amount))
+    {
+        return false; //There is not enough in stock that is not already in a cart
+    }
+    
+    put_in_cart(cart, merch, amount);
+    touch_cart(db, cart);
+    return commit_operation(db, &(operation_t) { .kind = Op_add_to_cart, .cart_id = cart_id, .name = merch->name, .amount = amount });
+}
+
+void put_in_cart(cart_t *cart, merch_t *merch, int amount)
+{
+    int new_amount = cart_amount(cart, merch) + amount;
+    ioopm_hash_table_insert(cart->items, str_elem(merch->name), int_elem(new_amount));
+    ioopm_hash_table_insert(merch->carts, int_elem(cart->cart_id), ptr_elem(cart));
+    cart->total += amount * merch_price(merch);
+}
+
+bool bl_remove_from_cart(db_t *db, int cart_id, char *merch_name, int amount)
+{
+    PROFILE_OP(db, Prof_remove_from_cart);
+    cart_t *cart = get_cart(db, cart_id);
+    merch_t *merch = get_merch(db, merch_name);
+    if(cart == NULL || merch == NULL || amount < 1)
+    {
+        return false; //The cart or merch does not exist or an invalid amount was given
+    }
+    
+    int new_amount = cart_amount(cart, merch) - amount;
+    if(new_amount < 0)
+    {
+        return false; //There are not that many of the merch in the cart
+    }
+    
+    release_stock(merch, amount);
+    elem_t ignore_value;
+    if(new_amount == 0)
+    {
+        ioopm_hash_table_remove(cart->items, str_elem(merch->name), &ignore_value);
+        ioopm_hash_table_remove(merch->carts, int_elem(cart_id), &ignore_value);
+    }
+    else
+    {
+        ioopm_hash_table_insert(cart->items, str_elem(merch->name), int_elem(new_amount));
+    }
+    cart->total -= amount * merch_price(merch);
+    touch_cart(db, cart);
+    return commit_operation(db, &(operation_t) { .kind = Op_remove_from_cart, .cart_id = cart_id, .name = merch->name, .amount = amount });
+}
+
+bool bl_calculate_cost(db_t *db, int cart_id, int *cost)
+{
+    PROFILE_OP(db, Prof_calculate_cost);
+    cart_t *cart = get_cart(db, cart_id);
+    if(cart == NULL)
+    {
+        return false;
+    }
+    
+    *cost = cart->total;
+    return true;
+}
+
+//If emptied is NULL, shelves are destroyed as soon as they are empty. Otherwise their ids are
+//appended to emptied and they are left in place, so that nothing but the merch itself is touched.
+void take_from_shelves(db_t *db, merch_t *merch, int amount, ioopm_list_t *emptied)
+{
+    ioopm_arena_t *scratch = db ? db->scratch : NULL;  //Batch checkout workers share the db, so they allocate on their own
+    if(scratch)
+    {
+        ioopm_arena_push_frame(scratch);
+    }
+    ioopm_list_t *shelves = ioopm_hash_table_values_in(merch->locs, scratch);  //A copy, so emptied shelves can be destroyed while iterating
+    ioopm_list_iterator_t *iter = ioopm_list_iterator(shelves);
+    elem_t res;
+    
+    bool has_next = ioopm_iterator_current(iter, &res);
+    while(has_next && amount > 0)
+    {
+        shelf_t *shelf = (shelf_t *) res.ptr_val;
+        int taken = shelf->quantity < amount ? shelf->quantity : amount;
         
-        free(all_merch);
+        shelf->quantity     -= taken;
+        merch_stock(merch)  -= taken;
+        amount              -= taken;
+        if(shelf->quantity == 0 && emptied != NULL)
+        {
+            ioopm_linked_list_append(emptied, int_elem(shelf->shelf_id));
+        }
+        else if(shelf->quantity == 0)
+        {
+            destroy_shelf(db, shelf->shelf_id);
+        }
+        has_next = ioopm_iterator_next(iter, &res);
+    }
+    
+    ioopm_iterator_destroy(&iter);
+    ioopm_linked_list_destroy(shelves);
+    if(db)
+    {
+        ioopm_arena_pop_frame(scratch);
+        stock_changed(db, merch);   //Batch checkouts, which have no db here, do it once the batch is done
+    }
+}
+
+bool bl_checkout(db_t *db, int cart_id)
+{
+    PROFILE_OP(db, Prof_checkout);
+    cart_t *cart = get_cart(db, cart_id);
+    if(cart == NULL)
+    {
+        return false;
+    }
+    //Everything in the cart is reserved, so it is all on the shelves and nothing has to be checked first
+    
+    ioopm_arena_push_frame(db->scratch);
+    ioopm_list_t *names = ioopm_hash_table_keys_in(cart->items, db->scratch);
+    ioopm_list_t *amounts = ioopm_hash_table_values_in(cart->items, db->scratch);
+    ioopm_list_iterator_t *name_iter = ioopm_list_iterator(names);
+    ioopm_list_iterator_t *amount_iter = ioopm_list_iterator(amounts);
+    elem_t name, amount;
+    
+    bool has_next = ioopm_iterator_current(name_iter, &name) && ioopm_iterator_current(amount_iter, &amount);
+    while(has_next)
+    {
+        merch_t *merch = get_interned_merch(db, name.str_val);
+        take_from_shelves(db, merch, amount.int_val, NULL);
+        atomic_fetch_sub(&merch->reserved, amount.int_val);  //Stock and reservation drop together, available stays the same
+        has_next = ioopm_iterator_next(name_iter, &name) && ioopm_iterator_next(amount_iter, &amount);
+    }
+    
+    ioopm_arena_pop_frame(db->scratch);
+    
+    remove_cart(db, cart, false);
+    return commit_operation(db, &(operation_t) { .kind = Op_checkout, .cart_id = cart_id });
+}
+
+bool bl_available_stock(db_t *db, char *merch_name, int *available)
+{
+    PROFILE_OP(db, Prof_available_stock);
+    merch_t *merch = get_merch(db, merch_name);
+    if(merch == NULL)
+    {
+        return false;
+    }
+    
+    *available = atomic_load(&merch->available);
+    return true;
+}
+
+size_t bl_find_low_stock(db_t *db, int below, char **names, int *stock, size_t max_names)
+{
+    PROFILE_OP(db, Prof_find_low_stock);
+    load_snapshot_merch(db);
+    ioopm_arena_push_frame(db->scratch);
+    elem_t *merch = ioopm_arena_alloc(db->scratch, (max_names + 1) * sizeof(elem_t));
+    size_t no_found = ioopm_indexed_heap_smallest_in(db->low_stock, below, merch, stock, max_names, db->scratch);
+    for(size_t i = 0; i < no_found; ++i)
+    {
+        names[i] = ((merch_t *) merch[i].ptr_val)->name;
+    }
+    ioopm_arena_pop_frame(db->scratch);
+    return no_found;
+}
+
+//------------------------------ End of carts
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------ Start of batch checkout
+
+// A batch checkout runs in three steps:
+//  1. The carts are looked up and their items gathered into jobs. Each job is put in the first
+//     wave after every earlier job that shares a merch with it.
+//  2. The waves run one after the other on a pool of workers. Jobs in the same wave share no
+//     merch, so they only touch their own shelves and can run in parallel without locks.
+//  3. Shelves that were emptied and the checked out carts are removed from the shared tables.
+// Only carts that contend for the same merch end up in different waves.
+
+typedef struct checkout_job checkout_job_t;
+typedef struct checkout_batch checkout_batch_t;
+typedef struct checkout_worker checkout_worker_t;
+
+struct checkout_job
+{
+    cart_t          *cart;
+    merch_t         **merch;
+    int             *amounts;
+    size_t          no_items;
+    int             wave;
+    ioopm_list_t    *emptied;       //Ids of shelves this job emptied
+};
+
+struct checkout_batch
+{
+    db_t                *db;
+    checkout_job_t      **order;        //Jobs sorted by wave
+    size_t              *wave_starts;   //Index in order of the first job of each wave, plus one past the end
+    int                 no_waves;
+    int                 no_workers;
+    pthread_barrier_t   wave_done;
+};
+
+struct checkout_worker
+{
+    checkout_batch_t    *batch;
+    int                 worker_no;
+    pthread_t           thread;
+};
+
+void create_checkout_job(cart_t *cart, checkout_job_t *job, db_t *db, ioopm_hash_table_t *last_waves)
+{
+    ioopm_arena_push_frame(db->scratch);
+    ioopm_list_t *names = ioopm_hash_table_keys_in(cart->items, db->scratch);
+    ioopm_list_t *amounts = ioopm_hash_table_values_in(cart->items, db->scratch);
+    ioopm_list_iterator_t *name_iter = ioopm_list_iterator(names);
+    ioopm_list_iterator_t *amount_iter = ioopm_list_iterator(amounts);
+    elem_t name, amount;
+    
+    job->cart       = cart;
+    job->no_items   = ioopm_hash_table_size(cart->items);
+    job->merch      = calloc(job->no_items, sizeof(merch_t *));
+    job->amounts    = calloc(job->no_items, sizeof(int));
+    job->wave       = 0;
+    job->emptied    = ioopm_linked_list_create(int_key_eq);
+    
+    bool has_next = ioopm_iterator_current(name_iter, &name) && ioopm_iterator_current(amount_iter, &amount);
+    for(int i = 0; has_next; ++i)
+    {
+        elem_t last_wave;
+        job->merch[i] = get_interned_merch(db, name.str_val);
+        job->amounts[i] = amount.int_val;
+        if(ioopm_hash_table_lookup(last_waves, name, &last_wave) && last_wave.int_val >= job->wave)
+        {
+            job->wave = last_wave.int_val + 1;  //Must run after the last job that takes this merch
+        }
+        has_next = ioopm_iterator_next(name_iter, &name) && ioopm_iterator_next(amount_iter, &amount);
+    }
+    
+    for(int i = 0; i < job->no_items; ++i)
+    {
+        ioopm_hash_table_insert(last_waves, str_elem(job->merch[i]->name), int_elem(job->wave));
     }
     
+    ioopm_arena_pop_frame(db->scratch);
 }
 
+void run_checkout_job(checkout_job_t *job)
+{
+    for(int i = 0; i < job->no_items; ++i)
+    {
+        take_from_shelves(NULL, job->merch[i], job->amounts[i], job->emptied);
+        atomic_fetch_sub(&job->merch[i]->reserved, job->amounts[i]);
+    }
+}
 
+void *checkout_worker(void *arg)
+{
+    checkout_worker_t *worker = arg;
+    checkout_batch_t *batch = worker->batch;
+    
+    for(int wave = 0; wave < batch->no_waves; ++wave)
+    {
+        for(size_t i = batch->wave_starts[wave] + worker->worker_no; i < batch->wave_starts[wave + 1]; i += batch->no_workers)
+        {
+            run_checkout_job(batch->order[i]);
+        }
+        pthread_barrier_wait(&batch->wave_done);   //No job of the next wave may start before this wave is done
+    }
+    return NULL;
+}
 
+void run_checkout_waves(checkout_batch_t *batch)
+{
+    checkout_worker_t workers[batch->no_workers];
+    pthread_barrier_init(&batch->wave_done, NULL, batch->no_workers);
+    
+    for(int i = 0; i < batch->no_workers; ++i)
+    {
+        workers[i].batch = batch;
+        workers[i].worker_no = i;
+        if(i > 0)
+        {
+            pthread_create(&workers[i].thread, NULL, checkout_worker, &workers[i]);
+        }
+    }
+    checkout_worker(&workers[0]);   //The calling thread is worker 0
+    
+    for(int i = 1; i < batch->no_workers; ++i)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+    pthread_barrier_destroy(&batch->wave_done);
+}
 
-int main()
+size_t bl_checkout_batch(db_t *db, int *cart_ids, size_t no_carts, bool *results, int no_workers)
 {
-    db_t *yo = create_webstore();
+    PROFILE_OP(db, Prof_checkout_batch);
+    checkout_job_t *jobs = calloc(no_carts, sizeof(checkout_job_t));
+    ioopm_hash_table_t *last_waves = ioopm_hash_table_create(ioopm_interned_eq, false, ioopm_interned_hash);
+    ioopm_hash_table_t *seen = ioopm_hash_table_create(int_key_eq, false, int_knr_hash);
+    size_t no_jobs = 0;
+    int no_waves = 0;
+    
+    for(size_t i = 0; i < no_carts; ++i)
+    {
+        elem_t ignore_value;
+        cart_t *cart = get_cart(db, cart_ids[i]);
+        results[i] = cart != NULL && !ioopm_hash_table_lookup(seen, int_elem(cart_ids[i]), &ignore_value);  //A cart listed twice is checked out once
+        if(results[i])
+        {
+            ioopm_hash_table_insert(seen, int_elem(cart_ids[i]), int_elem(0));
+            create_checkout_job(cart, &jobs[no_jobs], db, last_waves);
+            no_waves = jobs[no_jobs].wave >= no_waves ? jobs[no_jobs].wave + 1 : no_waves;
+            no_jobs++;
+        }
+    }
+    ioopm_hash_table_destroy(&last_waves);
+    ioopm_hash_table_destroy(&seen);
+    
+    checkout_batch_t batch = { .db = db, .no_waves = no_waves };
+    batch.order         = calloc(no_jobs + 1, sizeof(checkout_job_t *));
+    batch.wave_starts   = calloc(no_waves + 1, sizeof(size_t));
+    for(size_t i = 0; i < no_jobs; ++i)     //Counting sort of the jobs by wave
+    {
+        batch.wave_starts[jobs[i].wave + 1]++;
+    }
+    for(int wave = 0; wave < no_waves; ++wave)
+    {
+        batch.wave_starts[wave + 1] += batch.wave_starts[wave];
+    }
+    size_t *next_slot = calloc(no_waves + 1, sizeof(size_t));
+    memcpy(next_slot, batch.wave_starts, (no_waves + 1) * sizeof(size_t));
+    for(size_t i = 0; i < no_jobs; ++i)
+    {
+        batch.order[next_slot[jobs[i].wave]++] = &jobs[i];
+    }
+    free(next_slot);
+    
+    if(no_workers < 1)
+    {
+        no_workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    batch.no_workers = no_workers > (int) no_jobs ? (int) no_jobs : no_workers;
+    if(batch.no_workers > 0)
+    {
+        run_checkout_waves(&batch);
+    }
     
-    char *name = ask_question_string("name\n");
-    char *desc = ask_question_string("desc\n");
+    for(size_t i = 0; i < no_jobs; ++i)
+    {
+        elem_t shelf_id;
+        while(ioopm_linked_list_remove(jobs[i].emptied, 0, &shelf_id))
+        {
+            destroy_shelf(db, shelf_id.int_val);
+        }
+        ioopm_linked_list_destroy(jobs[i].emptied);
+        log_operation(db, &(operation_t) { .kind = Op_checkout, .cart_id = jobs[i].cart->cart_id });
+        remove_cart(db, jobs[i].cart, false);
+        for(int j = 0; j < jobs[i].no_items; ++j)
+        {
+            stock_changed(db, jobs[i].merch[j]);
+        }
+        free(jobs[i].merch);
+        free(jobs[i].amounts);
+    }
+    
+    if(!commit_log(db))     //One wait for the whole batch
+    {
+        memset(results, 0, no_carts * sizeof(bool));
+        no_jobs = 0; //The log has failed, no checkout is reported as done
+    }
     
-    bl_add_merchandise(yo, name, desc, 4);
-    printf("Hello world!\n");
-    bl_remove_merchandise(yo, name);
-    destroy_webstore(yo);
-    return 0;
-}
\ No newline at end of file
+    free(batch.order);
+    free(batch.wave_starts);
+    free(jobs);
+    return no_jobs;
+}
+
+//------------------------------ End of batch checkout
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------------------
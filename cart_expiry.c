@@ -0,0 +1,113 @@
+#include "headers/business_logic_internal.h"
+
+#include <time.h>
+
+// Expiry of abandoned carts, for bl_set_cart_timeout and bl_expire_carts.
+//
+// Every cart has a timer in db->cart_timers, due timeout ms after the cart was created. A change
+// to the cart only records when it was made in touched, it does not move the timer. When the timer
+// is due the cart is checked: if it was touched since, the timer is set again for timeout ms after
+// that, else the cart is removed and what it held goes back to the stock. So each cart costs O(1)
+// per timeout, however much it is changed, and finding the expired carts never looks at the others.
+
+#define Expire_batch 64     //Carts handed out by the wheel at a time
+
+static uint64_t now_ms()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void schedule_cart_expiry(db_t *db, cart_t *cart)
+{
+    if(db->cart_timers == NULL)
+    {
+        return; //Carts do not expire
+    }
+    cart->touched = now_ms();
+    cart->timer = ioopm_timer_wheel_schedule(db->cart_timers, cart->touched + db->cart_timeout_ms, int_elem(cart->cart_id));
+}
+
+void touch_cart(db_t *db, cart_t *cart)
+{
+    if(db->cart_timers)
+    {
+        cart->touched = now_ms();
+    }
+}
+
+void cancel_cart_expiry(db_t *db, cart_t *cart)
+{
+    if(cart->timer != No_timer)
+    {
+        ioopm_timer_wheel_cancel(db->cart_timers, cart->timer);
+        cart->timer = No_timer;
+    }
+}
+
+static void cancel_apply(int cart_id, elem_t cart, void *db)
+{
+    cancel_cart_expiry(db, cart.ptr_val);
+}
+
+static void schedule_apply(int cart_id, elem_t cart, void *db)
+{
+    schedule_cart_expiry(db, cart.ptr_val);
+}
+
+void bl_set_cart_timeout(db_t *db, int timeout_ms)
+{
+    if(db->cart_timers)
+    {
+        ioopm_slot_map_apply_to_all(db->carts, cancel_apply, db);
+        ioopm_timer_wheel_destroy(&db->cart_timers);
+    }
+    db->cart_timeout_ms = timeout_ms > 0 ? timeout_ms : 0;
+    if(db->cart_timeout_ms > 0)
+    {
+        db->cart_timers = ioopm_timer_wheel_create(now_ms());
+        ioopm_slot_map_apply_to_all(db->carts, schedule_apply, db);  //The time is counted from now
+    }
+}
+
+size_t bl_expire_carts(db_t *db)
+{
+    if(db->cart_timers == NULL)
+    {
+        return 0;
+    }
+    
+    uint64_t now = now_ms();
+    elem_t due[Expire_batch];
+    size_t no_due;
+    size_t no_expired = 0;
+    do
+    {
+        no_due = ioopm_timer_wheel_advance(db->cart_timers, now, due, Expire_batch);
+        for(size_t i = 0; i < no_due; ++i)
+        {
+            get_cart(db, due[i].int_val)->timer = No_timer;   //First, its handle may go to a timer set below
+        }
+        for(size_t i = 0; i < no_due; ++i)
+        {
+            cart_t *cart = get_cart(db, due[i].int_val);
+            uint64_t deadline = cart->touched + db->cart_timeout_ms;
+            if(deadline > now)
+            {
+                cart->timer = ioopm_timer_wheel_schedule(db->cart_timers, deadline, due[i]);
+                continue; //It was changed since the timer was set
+            }
+            remove_cart(db, cart, true);
+            log_operation(db, &(operation_t) { .kind = Op_remove_cart, .cart_id = due[i].int_val });
+            no_expired += 1;
+        }
+    }
+    while(no_due == Expire_batch);
+    
+    if(no_expired > 0)
+    {
+        commit_log(db); //Once for all of them
+    }
+    return no_expired;
+}
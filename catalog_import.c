@@ -0,0 +1,187 @@
+#include "headers/business_logic_internal.h"
+#include "headers/generic_utils.h"
+
+#include <limits.h>
+
+// Bulk loading of catalog and stock files. A file is read into memory in one go and
+// split into fields in place, so parsing allocates nothing per row or field. Rows are
+// only inserted once the whole file is split, after the tables have been sized for them.
+
+#define No_fields 3
+
+typedef struct row row_t;
+
+struct row
+{
+    char *fields[No_fields];
+};
+
+// A row is "first<sep>middle<sep>last" where sep is a tab if the line has one, else a comma.
+// The middle field may itself hold the separator, so the last field starts after the last one.
+static bool split_row(char *line, char *end, row_t *row)
+{
+    char sep = memchr(line, '\t', end - line) ? '\t' : ',';
+    char *first_sep = memchr(line, sep, end - line);
+    char *last_sep = end - 1;
+    while(last_sep > line && *last_sep != sep)
+    {
+        --last_sep;
+    }
+    
+    if(first_sep == NULL || first_sep == last_sep)
+    {
+        return false; //Fewer than three fields
+    }
+    
+    *first_sep = '\0';
+    *last_sep = '\0';
+    *end = '\0';
+    row->fields[0] = line;
+    row->fields[1] = first_sep + 1;
+    row->fields[2] = last_sep + 1;
+    return true;
+}
+
+static size_t split_rows(char *buf, size_t length, row_t **rows)
+{
+    size_t no_lines = 1;
+    for(char *c = memchr(buf, '\n', length); c; c = memchr(c + 1, '\n', buf + length - c - 1))
+    {
+        ++no_lines;
+    }
+    
+    *rows = calloc(no_lines, sizeof(row_t));
+    size_t no_rows = 0;
+    char *line = buf;
+    char *buf_end = buf + length;
+    
+    while(line < buf_end)
+    {
+        char *end = memchr(line, '\n', buf_end - line);
+        char *next = end ? end + 1 : buf_end;
+        end = end ? end : buf_end;
+        if(end > line && end[-1] == '\r')
+        {
+            --end;
+        }
+        
+        if(split_row(line, end, &(*rows)[no_rows]))
+        {
+            ++no_rows;
+        }
+        line = next;
+    }
+    return no_rows;
+}
+
+static bool parse_positive(char *str, int *result)
+{
+    int value = 0;
+    if(*str == '\0')
+    {
+        return false;
+    }
+    for(; *str != '\0'; ++str)
+    {
+        if(!is_digit(*str) || value > (INT_MAX - 9) / 10)
+        {
+            return false;
+        }
+        value = value * 10 + (*str - '0');
+    }
+    *result = value;
+    return value > 0;
+}
+
+long bl_import_catalog(db_t *db, char *path)
+{
+    size_t length;
+    char *buf = read_file(path, &length);
+    if(buf == NULL)
+    {
+        return -1;
+    }
+    
+    row_t *rows;
+    size_t no_rows = split_rows(buf, length, &rows);
+    ioopm_hash_table_reserve(db->merch, ioopm_hash_table_size(db->merch) + no_rows);
+    if(db->texts == NULL)
+    {
+        db->texts = ioopm_arena_create(0);
+    }
+    
+    long added = 0;
+    for(size_t i = 0; i < no_rows; ++i)
+    {
+        char *name = rows[i].fields[0];
+        char *desc = rows[i].fields[1];
+        int price;
+        if(!not_empty(name) || !parse_positive(rows[i].fields[2], &price))
+        {
+            continue; //A header line or an invalid row is skipped
+        }
+        
+        char *interned = ioopm_string_pool_intern(db->names, name);
+        if(get_interned_merch(db, interned) != NULL)
+        {
+            ioopm_string_pool_release(db->names, interned);
+            continue; //The merch already exists
+        }
+        
+        merch_t *merch = create_merch(db, interned, ioopm_arena_strndup(db->texts, desc, strlen(desc)), price);
+        merch->owns_desc = false;
+        insert_merch(db, merch);
+        log_operation(db, &(operation_t) { .kind = Op_add_merch, .name = interned, .desc = merch->desc, .price = price });
+        ++added;
+    }
+    if(!commit_log(db))
+    {
+        added = -1; //The log has failed
+    }
+    
+    free(rows);
+    free(buf);
+    return added;
+}
+
+long bl_import_stock(db_t *db, char *path)
+{
+    size_t length;
+    char *buf = read_file(path, &length);
+    if(buf == NULL)
+    {
+        return -1;
+    }
+    
+    row_t *rows;
+    size_t no_rows = split_rows(buf, length, &rows);
+    ioopm_hash_table_reserve(db->storage, ioopm_hash_table_size(db->storage) + no_rows);
+    
+    long stocked = 0;
+    char *last_name = "";
+    merch_t *merch = NULL;
+    for(size_t i = 0; i < no_rows; ++i)
+    {
+        int shelf_id, amount;
+        if(strcmp(rows[i].fields[0], last_name) != 0)   //Stock files are usually grouped by merch
+        {
+            last_name = rows[i].fields[0];
+            merch = get_merch(db, last_name);
+        }
+        
+        if(merch != NULL && parse_shelf_id(rows[i].fields[1], &shelf_id) && parse_positive(rows[i].fields[2], &amount)
+           && stock_shelf(db, merch, shelf_id, amount))
+        {
+            log_operation(db, &(operation_t) { .kind = Op_replenish, .name = merch->name, .shelf_id = shelf_id, .amount = amount });
+            ++stocked;
+        }
+    }
+    if(!commit_log(db))
+    {
+        stocked = -1; //The log has failed
+    }
+    
+    free(rows);
+    free(buf);
+    return stocked;
+}
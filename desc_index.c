@@ -0,0 +1,469 @@
+#include "headers/business_logic_internal.h"
+
+#include <ctype.h>
+#include <stdint.h>
+
+// Index of the words of the merch descriptions, for bl_search_descriptions. It is built the
+// first time a search is made, and from then on every change to a description updates it.
+//
+// Each indexed description gets a doc id. Ids only grow, so the posting list of a word, the
+// ids of the descriptions that have it, is in order and a new description is appended to it.
+// A list is stored as the varint gaps between its ids, mostly one byte each. A description
+// that is removed or replaced is not taken out of the lists of its words, its id is only
+// forgotten in docs. Each list counts how many of its ids are forgotten, and is rewritten
+// without them once they are half of it. Once half of all ids are forgotten, the live
+// descriptions are given new ids from 1, in the same order, so the lists stay in order and
+// docs and the ids a search decodes do not keep growing with every change.
+
+#define Max_word_size 32    //Longer words are cut to this many chars
+
+typedef struct posting_list posting_list_t;
+
+struct posting_list
+{
+    uint8_t     *gaps;
+    size_t      size;
+    size_t      capacity;
+    int         last_id;
+    int         no_ids;
+    int         no_dead;        //Ids of descriptions that are no longer indexed
+    int         last_dead;      //Last id counted in no_dead, so a word twice in a description counts once
+};
+
+struct desc_index
+{
+    ioopm_string_pool_t *words;
+    ioopm_hash_table_t  *postings;  //interned word => posting_list_t *
+    merch_t             **docs;     //doc id => merch, NULL if the description is no longer indexed
+    int                 last_id;
+    int                 no_dead;    //Ids forgotten in docs since the ids were last given out
+    int                 capacity;
+};
+
+/*=================================================================
+ *  Words
+ *=================================================================*/
+
+//Copies the next word of text, lower case, to word, which holds Max_word_size + 1 chars
+//Returns the text after the word, or NULL if there are no more words
+static char *next_word(char *text, char *word)
+{
+    while(*text != '\0' && !isalnum((unsigned char) *text))
+    {
+        ++text;
+    }
+    if(*text == '\0')
+    {
+        return NULL;
+    }
+    
+    int length = 0;
+    for(; isalnum((unsigned char) *text); ++text)
+    {
+        if(length < Max_word_size)
+        {
+            word[length++] = tolower((unsigned char) *text);
+        }
+    }
+    word[length] = '\0';
+    return text;
+}
+
+static posting_list_t *get_postings(desc_index_t *index, char *word)
+{
+    elem_t list = ptr_elem(NULL);
+    char *interned = ioopm_string_pool_lookup(index->words, word);
+    if(interned)
+    {
+        ioopm_hash_table_lookup(index->postings, str_elem(interned), &list);
+    }
+    return list.ptr_val;
+}
+
+/*=================================================================
+ *  Posting lists
+ *=================================================================*/
+
+static void put_gap(posting_list_t *list, uint32_t gap)
+{
+    if(list->size + 5 > list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 8;
+        list->gaps = realloc(list->gaps, list->capacity);
+    }
+    while(gap >= 0x80)
+    {
+        list->gaps[list->size++] = (uint8_t) (gap | 0x80);
+        gap >>= 7;
+    }
+    list->gaps[list->size++] = (uint8_t) gap;
+}
+
+static uint32_t get_gap(uint8_t **pos)
+{
+    uint32_t gap = 0;
+    for(int shift = 0; ; shift += 7)
+    {
+        uint8_t byte = *(*pos)++;
+        gap |= (uint32_t) (byte & 0x7f) << shift;
+        if(byte < 0x80)
+        {
+            return gap;
+        }
+    }
+}
+
+static void append_id(posting_list_t *list, int id)
+{
+    if(id == list->last_id)
+    {
+        return; //The word is twice in the description
+    }
+    put_gap(list, id - list->last_id);
+    list->last_id = id;
+    list->no_ids += 1;
+}
+
+//Rewrites a list without the ids of descriptions that are no longer indexed, and with the
+//new ids in new_ids if it is not NULL
+static void compact_postings(desc_index_t *index, posting_list_t *list, int *new_ids)
+{
+    uint8_t *old_gaps = list->gaps;
+    uint8_t *pos = old_gaps;
+    uint8_t *end = old_gaps + list->size;
+    
+    list->gaps      = malloc(list->size + 5);
+    list->capacity  = list->size + 5;
+    list->size      = 0;
+    list->last_id   = 0;
+    list->no_ids    = 0;
+    list->no_dead   = 0;
+    for(int id = 0; pos < end; )
+    {
+        id += get_gap(&pos);
+        if(index->docs[id] != NULL)
+        {
+            append_id(list, new_ids ? new_ids[id] : id);
+        }
+    }
+    free(old_gaps);
+}
+
+typedef struct renumbering renumbering_t;
+
+struct renumbering
+{
+    desc_index_t    *index;
+    int             *new_ids;   //Old id => new id
+};
+
+static void renumber_postings_apply(ioopm_hash_table_t *ht, elem_t word, elem_t list, void *renumbering)
+{
+    renumbering_t *numbers = renumbering;
+    compact_postings(numbers->index, list.ptr_val, numbers->new_ids);
+    ((posting_list_t *) list.ptr_val)->last_dead = 0;   //Old ids mean nothing now
+}
+
+//Gives the live descriptions new ids from 1, in the order of their old ids, and rewrites the
+//lists with them. No list is left empty, those that were all dead were removed as they died.
+static void renumber_docs(desc_index_t *index)
+{
+    int *new_ids = calloc(index->last_id + 1, sizeof(int));
+    int no_live = 0;
+    for(int id = 1; id <= index->last_id; ++id)
+    {
+        if(index->docs[id] != NULL)
+        {
+            new_ids[id] = ++no_live;
+        }
+    }
+    
+    renumbering_t numbers = { .index = index, .new_ids = new_ids };
+    ioopm_hash_table_apply_to_all(index->postings, renumber_postings_apply, &numbers);
+    for(int id = 1; id <= index->last_id; ++id)
+    {
+        if(index->docs[id] != NULL)
+        {
+            index->docs[new_ids[id]] = index->docs[id];
+            index->docs[new_ids[id]]->doc_id = new_ids[id];
+        }
+    }
+    for(int id = no_live + 1; id <= index->last_id; ++id)
+    {
+        index->docs[id] = NULL;
+    }
+    index->last_id = no_live;
+    index->no_dead = 0;
+    free(new_ids);
+}
+
+//Keeps the ids in ids that are also in list, returns how many there are
+static size_t intersect_postings(int *ids, size_t no_ids, posting_list_t *list)
+{
+    uint8_t *pos = list->gaps;
+    uint8_t *end = list->gaps + list->size;
+    size_t kept = 0;
+    size_t i = 0;
+    
+    for(int id = 0; i < no_ids && pos < end; )
+    {
+        id += get_gap(&pos);
+        while(i < no_ids && ids[i] < id)
+        {
+            ++i;
+        }
+        if(i < no_ids && ids[i] == id)
+        {
+            ids[kept++] = ids[i++];
+        }
+    }
+    return kept;
+}
+
+//Sets ids to the ids in list of descriptions that are still indexed, returns how many there are
+static size_t live_postings(desc_index_t *index, posting_list_t *list, int *ids)
+{
+    uint8_t *pos = list->gaps;
+    uint8_t *end = list->gaps + list->size;
+    size_t no_ids = 0;
+    
+    for(int id = 0; pos < end; )
+    {
+        id += get_gap(&pos);
+        if(index->docs[id] != NULL)
+        {
+            ids[no_ids++] = id;
+        }
+    }
+    return no_ids;
+}
+
+/*=================================================================
+ *  Changes
+ *=================================================================*/
+
+void index_desc(db_t *db, merch_t *merch)
+{
+    desc_index_t *index = db->descs;
+    if(index == NULL)
+    {
+        return; //No search has been made yet
+    }
+    
+    if(index->last_id + 1 == index->capacity)
+    {
+        index->capacity *= 2;
+        index->docs = realloc(index->docs, index->capacity * sizeof(merch_t *));
+    }
+    int id = ++index->last_id;
+    index->docs[id] = merch;
+    merch->doc_id = id;
+    
+    char word[Max_word_size + 1];
+    for(char *text = next_word(merch->desc, word); text != NULL; text = next_word(text, word))
+    {
+        posting_list_t *list = get_postings(index, word);
+        if(list == NULL)
+        {
+            list = calloc(1, sizeof(posting_list_t));
+            ioopm_hash_table_insert(index->postings, str_elem(ioopm_string_pool_intern(index->words, word)), ptr_elem(list));
+        }
+        append_id(list, id);
+    }
+}
+
+void unindex_desc(db_t *db, merch_t *merch)
+{
+    desc_index_t *index = db->descs;
+    if(index == NULL || merch->doc_id == 0)
+    {
+        return;
+    }
+    
+    int id = merch->doc_id;
+    index->docs[id] = NULL;
+    merch->doc_id = 0;
+    
+    char word[Max_word_size + 1];
+    for(char *text = next_word(merch->desc, word); text != NULL; text = next_word(text, word))
+    {
+        posting_list_t *list = get_postings(index, word);
+        if(list == NULL || list->last_dead == id)
+        {
+            continue; //Already counted, the word is twice in the description
+        }
+        list->last_dead = id;
+        list->no_dead += 1;
+        if(list->no_dead * 2 < list->no_ids)
+        {
+            continue;
+        }
+        
+        compact_postings(index, list, NULL);
+        if(list->no_ids == 0)
+        {
+            elem_t ignored, interned;
+            ioopm_hash_table_remove_w_key(index->postings, str_elem(ioopm_string_pool_lookup(index->words, word)), &ignored, &interned);
+            ioopm_string_pool_release(index->words, interned.str_val);
+            free(list->gaps);
+            free(list);
+        }
+    }
+    
+    index->no_dead += 1;
+    if(index->no_dead * 2 >= index->last_id)
+    {
+        renumber_docs(index);
+    }
+}
+
+static void build_desc_index(db_t *db)
+{
+    desc_index_t *index = calloc(1, sizeof(desc_index_t));
+    index->words    = ioopm_string_pool_create();
+    index->postings = ioopm_hash_table_create(ioopm_interned_eq, false, ioopm_interned_hash);
+    index->capacity = db->columns.size + 16;
+    index->docs     = calloc(index->capacity, sizeof(merch_t *));
+    db->descs = index;
+    for(int id = 0; id < db->columns.size; ++id)
+    {
+        index_desc(db, db->columns.records[id]);
+    }
+}
+
+static void free_postings_apply(ioopm_hash_table_t *ht, elem_t word, elem_t list, void *index)
+{
+    free(((posting_list_t *) list.ptr_val)->gaps);
+    free(list.ptr_val);
+    ioopm_string_pool_release(((desc_index_t *) index)->words, word.str_val);
+}
+
+void destroy_desc_index(db_t *db)
+{
+    desc_index_t *index = db->descs;
+    if(index == NULL)
+    {
+        return;
+    }
+    
+    for(int id = 1; id <= index->last_id; ++id)
+    {
+        if(index->docs[id])
+        {
+            index->docs[id]->doc_id = 0;
+        }
+    }
+    ioopm_hash_table_apply_to_all(index->postings, free_postings_apply, index);
+    ioopm_hash_table_destroy(&index->postings);
+    ioopm_string_pool_destroy(&index->words);
+    free(index->docs);
+    free(index);
+    db->descs = NULL;
+}
+
+/*=================================================================
+ *  Search
+ *=================================================================*/
+
+//Sets ids to the ids of the descriptions with all the words in the alternative, returns how many there are
+static size_t match_alternative(desc_index_t *index, posting_list_t **lists, size_t no_lists, int *ids)
+{
+    for(size_t i = 1; i < no_lists; ++i)    //Shortest list first, it bounds the result
+    {
+        if(lists[i]->no_ids < lists[0]->no_ids)
+        {
+            posting_list_t *shortest = lists[i];
+            lists[i] = lists[0];
+            lists[0] = shortest;
+        }
+    }
+    
+    size_t no_ids = live_postings(index, lists[0], ids);
+    for(size_t i = 1; i < no_lists && no_ids > 0; ++i)
+    {
+        no_ids = intersect_postings(ids, no_ids, lists[i]);
+    }
+    return no_ids;
+}
+
+//Merges the ids of an alternative into the ids found so far, both in order
+static int *unite_ids(int *found, size_t *no_found, int *ids, size_t no_ids)
+{
+    int *united = malloc((*no_found + no_ids + 1) * sizeof(int));
+    size_t i = 0, j = 0, k = 0;
+    while(i < *no_found || j < no_ids)
+    {
+        if(j == no_ids || (i < *no_found && found[i] < ids[j]))
+        {
+            united[k++] = found[i++];
+        }
+        else
+        {
+            i += i < *no_found && found[i] == ids[j] ? 1 : 0;
+            united[k++] = ids[j++];
+        }
+    }
+    free(found);
+    *no_found = k;
+    return united;
+}
+
+size_t bl_search_descriptions(db_t *db, char *query, char **names, size_t max_names)
+{
+    PROFILE_OP(db, Prof_search_descriptions);
+    load_snapshot_merch(db);
+    if(db->descs == NULL)
+    {
+        build_desc_index(db);
+    }
+    desc_index_t *index = db->descs;
+    
+    char *text = strdup(query);
+    posting_list_t **lists = calloc(strlen(query) / 2 + 1, sizeof(posting_list_t *));
+    int *ids = malloc((index->last_id + 1) * sizeof(int));
+    int *found = NULL;
+    size_t no_found = 0;
+    size_t no_lists = 0;
+    bool matchable = true;  //False once a word of the alternative is in no description
+    
+    char word[Max_word_size + 1];
+    char *save_ptr;
+    for(char *token = strtok_r(text, " \t\n", &save_ptr); ; token = strtok_r(NULL, " \t\n", &save_ptr))
+    {
+        if(token == NULL || strcmp(token, "OR") == 0)
+        {
+            if(matchable && no_lists > 0)
+            {
+                size_t no_ids = match_alternative(index, lists, no_lists, ids);
+                found = unite_ids(found, &no_found, ids, no_ids);
+            }
+            if(token == NULL)
+            {
+                break;
+            }
+            matchable = true;
+            no_lists = 0;
+            continue;
+        }
+        for(char *rest = next_word(token, word); rest != NULL; rest = next_word(rest, word))
+        {
+            posting_list_t *list = get_postings(index, word);
+            matchable = matchable && list != NULL;
+            if(list)
+            {
+                lists[no_lists++] = list;
+            }
+        }
+    }
+    
+    size_t no_names = 0;
+    for(size_t i = 0; i < no_found && no_names < max_names; ++i)
+    {
+        names[no_names++] = index->docs[found[i]]->name;
+    }
+    free(found);
+    free(ids);
+    free(lists);
+    free(text);
+    return no_names;
+}
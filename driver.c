@@ -0,0 +1,385 @@
+#include "headers/business_logic.h"
+#include "headers/operations.h"
+#include "headers/generic_utils.h"
+
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+
+// Runs a script of store operations at full speed, without prompts, and reports how many
+// operations of each kind ran and how long they took.
+//
+// A script is text, one operation per line in the form read by parse_operation, or binary:
+// Script_magic followed by operations as written by encode_operation. Empty lines and lines
+// starting with '#' are skipped. Carts are numbered by the script itself: "create_cart 7"
+// creates a cart and every later operation on cart 7 uses it, whatever id the store gave it.
+//
+// Usage: driver [-s store_dir] [-t trace_file] script
+//                                              runs script, on a store kept in store_dir if given,
+//                                              and writes the spans of the hash tables to trace_file
+//                                              as Chrome trace events if given, see trace.h
+//        driver -c script binary_script        converts a text script to a binary one
+//        driver -g no_ops [seed]               writes a random text script to stdout
+//
+// Built with -DBL_PROFILE (make driver_profile), it also prints the latency percentiles of
+// each bl_* call the script made, see bl_profile_dump.
+
+#define Script_magic    "WSSCRIPT"
+#define Magic_size      8
+
+typedef struct script script_t;
+typedef struct op_stats op_stats_t;
+
+struct script
+{
+    char            *buf;           //The file, the operations point into it
+    operation_t     *ops;
+    size_t          no_ops;
+};
+
+struct op_stats
+{
+    unsigned long   count;
+    unsigned long   failed;         //Calls that returned false
+    uint64_t        ns;
+};
+
+static uint64_t now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void add_op(script_t *script, size_t *capacity, operation_t *op)
+{
+    if(script->no_ops == *capacity)
+    {
+        *capacity *= 2;
+        script->ops = realloc(script->ops, *capacity * sizeof(operation_t));
+    }
+    script->ops[script->no_ops++] = *op;
+}
+
+static bool parse_text(script_t *script, size_t length, size_t *capacity)
+{
+    char *line = script->buf;
+    char *end = script->buf + length;
+    for(int line_no = 1; line < end; ++line_no)
+    {
+        char *newline = memchr(line, '\n', end - line);
+        char *next = newline ? newline + 1 : end;
+        *(newline ? newline : end) = '\0';
+        
+        operation_t op;
+        char *first = line + strspn(line, " \t\r");
+        if(*first != '\0' && *first != '#')
+        {
+            if(!parse_operation(line, &op))
+            {
+                fprintf(stderr, "line %d: not an operation\n", line_no);
+                return false;
+            }
+            add_op(script, capacity, &op);
+        }
+        line = next;
+    }
+    return true;
+}
+
+static bool decode_binary(script_t *script, size_t length, size_t *capacity)
+{
+    size_t offset = Magic_size;
+    while(offset < length)
+    {
+        operation_t op;
+        size_t used = decode_operation(script->buf + offset, length - offset, &op);
+        if(used == 0)
+        {
+            fprintf(stderr, "byte %zu: not an operation\n", offset);
+            return false;
+        }
+        add_op(script, capacity, &op);
+        offset += used;
+    }
+    return true;
+}
+
+static bool load_script(char *path, script_t *script)
+{
+    size_t length;
+    script->buf = read_file(path, &length);
+    script->ops = NULL;
+    if(script->buf == NULL)
+    {
+        fprintf(stderr, "could not read %s\n", path);
+        return false;
+    }
+    
+    size_t capacity = 1024;
+    script->ops = calloc(capacity, sizeof(operation_t));
+    script->no_ops = 0;
+    if(length >= Magic_size && memcmp(script->buf, Script_magic, Magic_size) == 0)
+    {
+        return decode_binary(script, length, &capacity);
+    }
+    return parse_text(script, length, &capacity);
+}
+
+static void free_script(script_t *script)
+{
+    free(script->ops);
+    free(script->buf);
+}
+
+/*=================================================================
+ *  Running
+ *=================================================================*/
+
+static bool cart_no_eq(elem_t a, elem_t b)
+{
+    return a.int_val == b.int_val;
+}
+
+static int cart_no_hash(elem_t key)
+{
+    return (int) ((unsigned int) key.int_val % INT_MAX) + 1;
+}
+
+static void print_stats(op_stats_t *stats, uint64_t total_ns, size_t no_ops)
+{
+    printf("%-18s %10s %10s %12s %10s %12s\n", "operation", "count", "failed", "total ms", "mean us", "ops/s");
+    for(op_kind_t kind = Op_add_merch; kind < No_op_kinds; ++kind)
+    {
+        if(stats[kind].count > 0)
+        {
+            printf("%-18s %10lu %10lu %12.2f %10.3f %12.0f\n", operation_name(kind), stats[kind].count, stats[kind].failed,
+                   stats[kind].ns / 1e6, stats[kind].ns / 1e3 / stats[kind].count, stats[kind].count / (stats[kind].ns / 1e9));
+        }
+    }
+    printf("%-18s %10zu %10s %12.2f %10.3f %12.0f\n", "all", no_ops, "", total_ns / 1e6, total_ns / 1e3 / no_ops,
+           no_ops / (total_ns / 1e9));
+}
+
+static void run_script(db_t *db, script_t *script)
+{
+    op_stats_t stats[No_op_kinds] = { { 0 } };
+    ioopm_hash_table_t *carts = ioopm_hash_table_create(cart_no_eq, false, cart_no_hash);  //Script cart number => cart id
+    
+    uint64_t start = now_ns();
+    for(size_t i = 0; i < script->no_ops; ++i)
+    {
+        operation_t op = script->ops[i];
+        elem_t cart_id = int_elem(0);   //Not a cart id, for carts the script never created
+        if(op.kind != Op_create_cart)
+        {
+            ioopm_hash_table_lookup(carts, int_elem(op.cart_id), &cart_id);
+            op.cart_id = cart_id.int_val;
+        }
+        
+        int result;
+        uint64_t op_start = now_ns();
+        bool applied = apply_operation(db, &op, &result);
+        stats[op.kind].ns += now_ns() - op_start;
+        stats[op.kind].count += 1;
+        stats[op.kind].failed += applied ? 0 : 1;
+        
+        if(op.kind == Op_create_cart)
+        {
+            ioopm_hash_table_insert(carts, int_elem(op.cart_id), int_elem(result));
+        }
+    }
+    uint64_t total_ns = now_ns() - start;
+    
+    print_stats(stats, total_ns, script->no_ops);
+    ioopm_hash_table_destroy(&carts);
+}
+
+/*=================================================================
+ *  Converting and generating
+ *=================================================================*/
+
+static bool compile_script(char *text_path, char *binary_path)
+{
+    script_t script;
+    if(!load_script(text_path, &script))
+    {
+        free_script(&script);
+        return false;
+    }
+    
+    FILE *file = fopen(binary_path, "wb");
+    if(file == NULL)
+    {
+        fprintf(stderr, "could not write %s\n", binary_path);
+        free_script(&script);
+        return false;
+    }
+    
+    fwrite(Script_magic, 1, Magic_size, file);
+    for(size_t i = 0; i < script.no_ops; ++i)
+    {
+        char buf[max_encoded_size(&script.ops[i])];
+        fwrite(buf, 1, encode_operation(&script.ops[i], buf), file);
+    }
+    bool written = !ferror(file);
+    fclose(file);
+    free_script(&script);
+    return written;
+}
+
+// A catalog of no_ops / 20 merch stocked on one shelf each, then a mix of cart traffic over it
+static void generate_script(int no_ops, unsigned int seed)
+{
+    int no_merch = no_ops / 20 > 10 ? no_ops / 20 : 10;
+    int *open_carts = calloc(no_ops + 1, sizeof(int));
+    int *last_added = calloc(no_ops + 1, sizeof(int));     //The merch last added to each open cart
+    int no_open = 0;
+    int next_cart = 1;
+    
+    printf("# %d merch, %d operations, seed %u\n", no_merch, no_ops, seed);
+    for(int i = 0; i < no_merch; ++i)
+    {
+        printf("add_merch merch%d %d generated merch number %d\n", i, 1 + rand_r(&seed) % 500, i);
+        printf("replenish merch%d %c%d %d\n", i, 'A' + i % 26, i / 26, 1 + rand_r(&seed) % 50);
+    }
+    
+    for(int i = 0; i < no_ops; ++i)
+    {
+        int merch = rand_r(&seed) % no_merch;
+        int roll = rand_r(&seed) % 100;
+        int cart = no_open > 0 ? rand_r(&seed) % no_open : -1;
+        if(roll < 12 || cart < 0)
+        {
+            printf("create_cart %d\n", next_cart);
+            last_added[no_open] = -1;
+            open_carts[no_open++] = next_cart++;
+        }
+        else if(roll < 45)
+        {
+            printf("add_to_cart %d merch%d %d\n", open_carts[cart], merch, 1 + rand_r(&seed) % 3);
+            last_added[cart] = merch;
+        }
+        else if(roll < 52 && last_added[cart] >= 0)
+        {
+            printf("remove_from_cart %d merch%d 1\n", open_carts[cart], last_added[cart]);
+        }
+        else if(roll < 62)
+        {
+            printf("calculate_cost %d\n", open_carts[cart]);
+        }
+        else if(roll < 72)
+        {
+            printf("available_stock merch%d\n", merch);
+        }
+        else if(roll < 82)
+        {
+            printf("replenish merch%d %c%d %d\n", merch, 'A' + merch % 26, merch / 26, 1 + rand_r(&seed) % 20);
+        }
+        else if(roll < 86)
+        {
+            printf("edit_merch merch%d merch%d %d generated merch number %d\n", merch, merch, 1 + rand_r(&seed) % 500, merch);
+        }
+        else
+        {
+            printf("%s %d\n", roll < 96 ? "checkout" : "remove_cart", open_carts[cart]);
+            --no_open;
+            open_carts[cart] = open_carts[no_open];
+            last_added[cart] = last_added[no_open];
+        }
+    }
+    free(open_carts);
+    free(last_added);
+}
+
+static void print_usage()
+{
+    fprintf(stderr, "usage: driver [-s store_dir] [-t trace_file] script\n"
+                    "       driver -c script binary_script\n"
+                    "       driver -g no_ops [seed]\n"
+                    "operations:\n");
+    for(op_kind_t kind = Op_add_merch; kind < No_op_kinds; ++kind)
+    {
+        fprintf(stderr, "  %s\n", operation_usage(kind));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc == 4 && strcmp(argv[1], "-c") == 0)
+    {
+        return compile_script(argv[2], argv[3]) ? 0 : 1;
+    }
+    if((argc == 3 || argc == 4) && strcmp(argv[1], "-g") == 0)
+    {
+        generate_script(atoi(argv[2]), argc == 4 ? atoi(argv[3]) : 42);
+        return 0;
+    }
+    
+    char *store_dir = NULL;
+    char *trace_path = NULL;
+    int arg = 1;
+    for(; arg + 2 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+        if(strcmp(argv[arg], "-s") == 0)
+        {
+            store_dir = argv[arg + 1];
+        }
+        else if(strcmp(argv[arg], "-t") == 0)
+        {
+            trace_path = argv[arg + 1];
+        }
+        else
+        {
+            break;
+        }
+    }
+    if(arg != argc - 1)
+    {
+        print_usage();
+        return 1;
+    }
+    
+    script_t script;
+    if(!load_script(argv[argc - 1], &script))
+    {
+        free_script(&script);
+        return 1;
+    }
+    
+    db_t *db = store_dir ? bl_open_store(store_dir) : create_webstore();
+    if(db == NULL)
+    {
+        fprintf(stderr, "could not open %s\n", store_dir);
+        free_script(&script);
+        return 1;
+    }
+    
+    ioopm_trace_enable(trace_path != NULL);
+    run_script(db, &script);
+    ioopm_trace_enable(false);
+    bl_log_stats_t log_stats;
+    if(bl_log_stats(db, &log_stats))
+    {
+        printf("log: %lu records, %lu bytes, %lu syncs, %.1f us per commit\n", log_stats.no_records, log_stats.no_bytes,
+               log_stats.no_syncs, log_stats.no_commits ? log_stats.commit_ns / 1e3 / log_stats.no_commits : 0.0);
+    }
+    bl_profile_dump(db, stdout, false);
+    if(trace_path)
+    {
+        FILE *trace = fopen(trace_path, "w");
+        if(trace == NULL)
+        {
+            fprintf(stderr, "could not write %s\n", trace_path);
+        }
+        else
+        {
+            printf("trace: %zu spans written to %s\n", ioopm_trace_export(trace), trace_path);
+            fclose(trace);
+        }
+    }
+    
+    destroy_webstore(db);
+    free_script(&script);
+    return 0;
+}
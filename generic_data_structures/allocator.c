@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "allocator.h"
+
+struct allocator
+{
+    const ioopm_allocator_vtable_t *vtable;
+    void *state;
+    ioopm_allocator_stats_t stats;
+};
+
+static void *heap_alloc(void *state, size_t size)
+{
+    return calloc(1, size);
+}
+
+static void heap_free(void *state, void *ptr, size_t size)
+{
+    free(ptr);
+}
+
+const ioopm_allocator_vtable_t ioopm_heap_vtable = { .alloc = heap_alloc, .free = heap_free };
+
+ioopm_allocator_t *ioopm_allocator_create(const ioopm_allocator_vtable_t *vtable, void *state)
+{
+    ioopm_allocator_t *allocator = calloc(1, sizeof(ioopm_allocator_t));
+    allocator->vtable = vtable;
+    allocator->state = state;
+    return allocator;
+}
+
+void ioopm_allocator_destroy(ioopm_allocator_t **allocator)
+{
+    free(*allocator);
+    *allocator = NULL;
+}
+
+void *ioopm_allocator_alloc(ioopm_allocator_t *allocator, size_t size)
+{
+    if(allocator == NULL)
+    {
+        return calloc(1, size);
+    }
+    
+    ioopm_allocator_stats_t *stats = &allocator->stats;
+    stats->no_allocs += 1;
+    stats->bytes += size;
+    if(stats->bytes > stats->peak_bytes)
+    {
+        stats->peak_bytes = stats->bytes;
+    }
+    return allocator->vtable->alloc(allocator->state, size);
+}
+
+void ioopm_allocator_free(ioopm_allocator_t *allocator, void *ptr, size_t size)
+{
+    if(allocator == NULL)
+    {
+        free(ptr);
+        return;
+    }
+    
+    allocator->stats.no_frees += 1;
+    allocator->stats.bytes -= size;
+    if(allocator->vtable->free)
+    {
+        allocator->vtable->free(allocator->state, ptr, size);
+    }
+}
+
+void ioopm_allocator_release(ioopm_allocator_t *allocator, size_t size)
+{
+    allocator->stats.bytes -= size;
+}
+
+bool ioopm_allocator_frees(ioopm_allocator_t *allocator)
+{
+    return allocator == NULL || allocator->vtable->free != NULL;
+}
+
+ioopm_allocator_stats_t ioopm_allocator_stats(ioopm_allocator_t *allocator)
+{
+    return allocator->stats;
+}
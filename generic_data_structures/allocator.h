@@ -0,0 +1,77 @@
+#pragma once
+#include "common.h"
+
+/**
+ * @file allocator.h
+ * @brief Pluggable memory allocator for the data structures, with counters.
+ *
+ * An allocator is a vtable of alloc and free functions and the state they
+ * work on. It counts the calls made through it and the bytes it has handed
+ * out, so the memory of a structure created with its own allocator can be
+ * told apart from the rest. Data structures created without an allocator
+ * use calloc and free, and are not counted.
+ *
+ * Memory that is given back all at once, as when an arena frame is popped,
+ * is counted as handed out until then, also after the structures in it are
+ * destroyed. Its owner reports it with ioopm_allocator_release.
+ *
+ * An allocator is not thread safe, it must not be used by two threads at once.
+ */
+
+typedef struct allocator ioopm_allocator_t;
+typedef struct allocator_vtable ioopm_allocator_vtable_t;
+typedef struct allocator_stats ioopm_allocator_stats_t;
+
+struct allocator_vtable
+{
+    void *(*alloc)(void *state, size_t size);           // returns size zeroed bytes, like calloc
+    void (*free)(void *state, void *ptr, size_t size);  // NULL if memory is only given back all at once, as in an arena
+};
+
+struct allocator_stats
+{
+    size_t bytes;           // handed out and not yet freed or released
+    size_t peak_bytes;      // the most bytes handed out at once
+    size_t no_allocs;
+    size_t no_frees;
+};
+
+/// @brief Allocates from the heap with calloc and free
+extern const ioopm_allocator_vtable_t ioopm_heap_vtable;
+
+/// @brief Create a new allocator
+/// @param vtable the functions memory is allocated and freed with
+/// @param state passed to the functions of vtable (may be NULL)
+/// @return an allocator with all counters at zero
+ioopm_allocator_t *ioopm_allocator_create(const ioopm_allocator_vtable_t *vtable, void *state);
+
+/// @brief Delete an allocator and set its pointer to NULL. Memory handed out by it is not freed
+/// @param allocator double ref pointer to the allocator to be deleted
+void ioopm_allocator_destroy(ioopm_allocator_t **allocator);
+
+/// @brief Allocate size zeroed bytes
+/// @param allocator the allocator to use, or NULL for calloc
+/// @param size the number of bytes needed
+/// @return a pointer to the bytes
+void *ioopm_allocator_alloc(ioopm_allocator_t *allocator, size_t size);
+
+/// @brief Give back memory handed out by ioopm_allocator_alloc
+/// @param allocator the allocator that handed it out, or NULL for free
+/// @param ptr the memory to give back
+/// @param size the size it was allocated with
+void ioopm_allocator_free(ioopm_allocator_t *allocator, void *ptr, size_t size);
+
+/// @brief Record that memory handed out was given back all at once, not through ioopm_allocator_free
+/// @param allocator the allocator that handed it out
+/// @param size the number of bytes given back
+void ioopm_allocator_release(ioopm_allocator_t *allocator, size_t size);
+
+/// @brief Test whether memory handed out by an allocator must be given back one allocation at a time
+/// @param allocator the allocator operated upon (may be NULL)
+/// @return false if freeing does nothing, so a structure need not walk its memory to free it
+bool ioopm_allocator_frees(ioopm_allocator_t *allocator);
+
+/// @brief Lookup the counters of an allocator
+/// @param allocator the allocator operated upon
+/// @return the counters
+ioopm_allocator_stats_t ioopm_allocator_stats(ioopm_allocator_t *allocator);
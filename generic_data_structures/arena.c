@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include <stddef.h>
+#include "arena.h"
+
+#define Default_block_size (1 << 20)
+#define Alignment alignof(max_align_t)
+
+typedef struct block block_t;
+typedef struct frame frame_t;
+
+struct block
+{
+    block_t *prev;      // the block that was filled before this one (possibly NULL)
+    size_t size;        // usable bytes in data
+    size_t used;
+    alignas(max_align_t) char data[];
+};
+
+// Where the arena stood when a frame was pushed. It is allocated in the arena
+// itself, right after that point, so popping the frame also frees it.
+struct frame
+{
+    frame_t *prev;
+    block_t *block;     // the current block when the frame was pushed (possibly NULL)
+    size_t block_used;
+    block_t *large;
+    size_t used;
+    size_t allocator_bytes;     // bytes the allocator of the arena had handed out
+};
+
+struct arena
+{
+    block_t *current;
+    block_t *large;     // blocks of single large allocations, newest first
+    block_t *spare;     // blocks given back by popped frames, kept for reuse
+    frame_t *frame;     // the innermost frame (possibly NULL)
+    ioopm_allocator_t *allocator;   // created by the first ioopm_arena_allocator (possibly NULL)
+    size_t block_size;
+    size_t used;
+};
+
+static block_t *block_create(size_t size, block_t *prev)
+{
+    block_t *block = malloc(sizeof(block_t) + size);
+    block->prev = prev;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+ioopm_arena_t *ioopm_arena_create(size_t block_size)
+{
+    ioopm_arena_t *arena = calloc(1, sizeof(ioopm_arena_t));
+    arena->block_size = block_size > 0 ? block_size : Default_block_size;
+    return arena;
+}
+
+static void free_blocks(block_t *block, block_t *until)
+{
+    while(block != until)
+    {
+        block_t *prev = block->prev;
+        free(block);
+        block = prev;
+    }
+}
+
+void ioopm_arena_destroy(ioopm_arena_t **arena)
+{
+    free_blocks((*arena)->current, NULL);
+    free_blocks((*arena)->large, NULL);
+    free_blocks((*arena)->spare, NULL);
+    if((*arena)->allocator)
+    {
+        ioopm_allocator_destroy(&(*arena)->allocator);
+    }
+    free(*arena);
+    *arena = NULL;
+}
+
+static void *arena_alloc(ioopm_arena_t *arena, size_t size, size_t alignment)
+{
+    block_t *block = arena->current;
+    size_t offset = block ? (block->used + alignment - 1) & ~(alignment - 1) : 0;
+    
+    if(block == NULL || offset + size > block->size)
+    {
+        if(size > arena->block_size / 4)
+        {
+            // Large allocations get a block of their own, kept aside,
+            // so the space left in the current block is not wasted
+            block_t *own = block_create(size, arena->large);
+            arena->large = own;
+            own->used = size;
+            arena->used += size;
+            return own->data;
+        }
+        if(arena->spare)
+        {
+            block_t *spare = arena->spare;
+            arena->spare = spare->prev;
+            spare->prev = block;
+            spare->used = 0;
+            block = spare;
+        }
+        else
+        {
+            block = block_create(arena->block_size, block);
+        }
+        arena->current = block;
+        offset = 0;
+    }
+    
+    arena->used += offset + size - block->used;
+    block->used = offset + size;
+    return block->data + offset;
+}
+
+void *ioopm_arena_alloc(ioopm_arena_t *arena, size_t size)
+{
+    return arena_alloc(arena, size, Alignment);
+}
+
+char *ioopm_arena_strndup(ioopm_arena_t *arena, char *str, size_t length)
+{
+    char *copy = arena_alloc(arena, length + 1, 1);    // strings need no alignment
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void ioopm_arena_push_frame(ioopm_arena_t *arena)
+{
+    frame_t saved =
+    {
+        .prev       = arena->frame,
+        .block      = arena->current,
+        .block_used = arena->current ? arena->current->used : 0,
+        .large      = arena->large,
+        .used       = arena->used,
+        .allocator_bytes = arena->allocator ? ioopm_allocator_stats(arena->allocator).bytes : 0,
+    };
+    frame_t *frame = ioopm_arena_alloc(arena, sizeof(frame_t));
+    *frame = saved;
+    arena->frame = frame;
+}
+
+void ioopm_arena_pop_frame(ioopm_arena_t *arena)
+{
+    frame_t frame = *arena->frame;  // copied, the frame itself is freed below
+    
+    free_blocks(arena->large, frame.large);
+    arena->large = frame.large;
+    while(arena->current != frame.block)
+    {
+        block_t *block = arena->current;
+        arena->current = block->prev;
+        block->prev = arena->spare;
+        arena->spare = block;
+    }
+    if(frame.block)
+    {
+        frame.block->used = frame.block_used;
+    }
+    arena->used = frame.used;
+    arena->frame = frame.prev;
+    if(arena->allocator)
+    {
+        ioopm_allocator_release(arena->allocator, ioopm_allocator_stats(arena->allocator).bytes - frame.allocator_bytes);
+    }
+}
+
+static void *arena_vtable_alloc(void *arena, size_t size)
+{
+    return memset(ioopm_arena_alloc(arena, size), 0, size);
+}
+
+static const ioopm_allocator_vtable_t arena_vtable = { .alloc = arena_vtable_alloc, .free = NULL };
+
+ioopm_allocator_t *ioopm_arena_allocator(ioopm_arena_t *arena)
+{
+    if(arena->allocator == NULL)
+    {
+        arena->allocator = ioopm_allocator_create(&arena_vtable, arena);
+    }
+    return arena->allocator;
+}
+
+size_t ioopm_arena_used(ioopm_arena_t *arena)
+{
+    return arena->used;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "common.h"
+#include "allocator.h"
+
+/**
+ * @file arena.h
+ * @brief Bump-pointer allocator that frees everything it handed out at once.
+ *
+ * Memory is taken from large blocks, so an allocation is a pointer bump and
+ * there is no per-allocation header or free. Nothing is freed until the
+ * arena is destroyed, or until the frame it was allocated in is popped.
+ *
+ * A frame brackets the temporaries of one operation: everything allocated
+ * after ioopm_arena_push_frame is freed by the matching ioopm_arena_pop_frame,
+ * and the blocks are kept for the next frame. Frames nest.
+ */
+
+typedef struct arena ioopm_arena_t;
+
+/// @brief Create a new arena
+/// @param block_size the size of the blocks memory is taken from, or 0 for a default size
+/// @return an empty arena
+ioopm_arena_t *ioopm_arena_create(size_t block_size);
+
+/// @brief Delete an arena, free all memory handed out by it and set its pointer to NULL
+/// @param arena double ref pointer to the arena to be deleted
+void ioopm_arena_destroy(ioopm_arena_t **arena);
+
+/// @brief Allocate size bytes, aligned for any type, in amortized O(1) time
+/// @param arena the arena operated upon
+/// @param size the number of bytes needed
+/// @return a pointer to size uninitialized bytes, valid until the arena is destroyed
+void *ioopm_arena_alloc(ioopm_arena_t *arena, size_t size);
+
+/// @brief Copy the first length chars of str into the arena as a null terminated string
+/// @param arena the arena operated upon
+/// @param str the string to copy, which need not be null terminated
+/// @param length the number of chars to copy
+/// @return the copy
+char *ioopm_arena_strndup(ioopm_arena_t *arena, char *str, size_t length);
+
+/// @brief Start a frame, to be ended by ioopm_arena_pop_frame
+/// @param arena the arena operated upon
+void ioopm_arena_push_frame(ioopm_arena_t *arena);
+
+/// @brief End the innermost frame and free everything allocated since it was pushed,
+///        in O(1) time unless the frame filled more than one block
+/// @param arena the arena operated upon, with at least one frame pushed
+void ioopm_arena_pop_frame(ioopm_arena_t *arena);
+
+/// @brief Get an allocator that allocates in the arena, for data structures whose memory
+///        should go with the arena frame they were created in. Freeing through it does nothing,
+///        popping the frame takes what was allocated in it off the counters of the allocator
+/// @param arena the arena operated upon
+/// @return the allocator, which lives as long as the arena
+ioopm_allocator_t *ioopm_arena_allocator(ioopm_arena_t *arena);
+
+/// @brief Lookup the number of bytes handed out by the arena in O(1) time
+/// @param arena the arena operated upon
+/// @return the number of bytes handed out, including alignment padding
+size_t ioopm_arena_used(ioopm_arena_t *arena);
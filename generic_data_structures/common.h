@@ -39,4 +39,5 @@ struct list
     link_t *first;
     link_t *last;
     ioopm_eq_function eq_function;                                  
+    struct allocator *allocator;    // allocates the list and its links, NULL for calloc and free
 };
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <errno.h>
 #include "hash_table.h"
+#include "trace.h"
 
 #define Default_no_buckets 17
 #define Default_load_factor 14.0        
@@ -25,22 +26,24 @@ struct hash_table
     ioopm_eq_function key_eq_function;
     ioopm_eq_function value_eq_function;
     ioopm_hash_function hash_function;
+    ioopm_allocator_t *allocator;   // allocates the table, its buckets and entries (possibly NULL)
     size_t size;
     size_t no_buckets;
     float load_factor;
 };
 
 static entry_t *entry_create(ioopm_hash_table_t *ht, elem_t key, elem_t value, entry_t *next);
-static void entry_destroy(entry_t **entry_to_destroy);
-static void entries_destroy_all_iterativ(entry_t **e);
+static void entry_destroy(ioopm_hash_table_t *ht, entry_t **entry_to_destroy);
+static void entries_destroy_all_iterativ(ioopm_hash_table_t *ht, entry_t **e);
 static bool key_equiv(ioopm_hash_table_t *ht, elem_t key, elem_t value_ignored, void *arg);
 static bool val_equiv(ioopm_hash_table_t *ht, elem_t key_ignored, elem_t value, void *arg);
 static ioopm_hash_table_t *hash_table_create_custom(ioopm_eq_function key_eq, 
                                                     ioopm_eq_function val_eq, 
                                                     ioopm_hash_function hash_function,
                                                     size_t buckets,
-                                                    float load);
-                                                    
+                                                    float load,
+                                                    ioopm_allocator_t *allocator);
+
 static bool key_equiv(ioopm_hash_table_t *ht, elem_t key, elem_t value_ignored, void *arg)
 {
   elem_t other_key = *(elem_t *) arg;
@@ -58,20 +61,30 @@ ioopm_hash_table_t *ioopm_hash_table_create(ioopm_eq_function key_eq,
                                             ioopm_eq_function val_eq, 
                                             ioopm_hash_function hash_function)
 {
-    ioopm_hash_table_t *result = hash_table_create_custom(key_eq, val_eq, hash_function, Default_no_buckets, Default_load_factor);
+    ioopm_hash_table_t *result = hash_table_create_custom(key_eq, val_eq, hash_function, Default_no_buckets, Default_load_factor, NULL);
     return result;
 }
 
+ioopm_hash_table_t *ioopm_hash_table_create_with_allocator(ioopm_eq_function key_eq, 
+                                                           ioopm_eq_function val_eq, 
+                                                           ioopm_hash_function hash_function,
+                                                           ioopm_allocator_t *allocator)
+{
+    return hash_table_create_custom(key_eq, val_eq, hash_function, Default_no_buckets, Default_load_factor, allocator);
+}
+
 static ioopm_hash_table_t *hash_table_create_custom(ioopm_eq_function key_eq, 
                                                     ioopm_eq_function val_eq, 
                                                     ioopm_hash_function hash_function,
                                                     size_t buckets,
-                                                    float load)
+                                                    float load,
+                                                    ioopm_allocator_t *allocator)
 {
     /// Allocate space for a ioopm_hash_table_t = 17 pointers to
     /// entry_t's, which will be set to NULL
-    ioopm_hash_table_t *result = calloc(1, sizeof(ioopm_hash_table_t));
-    result->buckets = calloc(buckets, sizeof(entry_t));
+    ioopm_hash_table_t *result = ioopm_allocator_alloc(allocator, sizeof(ioopm_hash_table_t));
+    result->allocator = allocator;
+    result->buckets = ioopm_allocator_alloc(allocator, buckets * sizeof(entry_t));
     for(int i = 0; i < (int) buckets; ++i)
     {
         result->buckets[i].next = NULL;
@@ -86,9 +99,13 @@ static ioopm_hash_table_t *hash_table_create_custom(ioopm_eq_function key_eq,
 
 void ioopm_hash_table_destroy(ioopm_hash_table_t **ht)
 {
-    ioopm_hash_table_clear(*ht);
-    free((*ht)->buckets);
-    free(*ht);
+    ioopm_allocator_t *allocator = (*ht)->allocator;
+    if(ioopm_allocator_frees(allocator))
+    {
+        ioopm_hash_table_clear(*ht);
+        ioopm_allocator_free(allocator, (*ht)->buckets, (*ht)->no_buckets * sizeof(entry_t));
+        ioopm_allocator_free(allocator, *ht, sizeof(ioopm_hash_table_t));
+    }
     *ht = NULL;
 }
 
@@ -100,57 +117,101 @@ static bool ht_load_level(ioopm_hash_table_t *ht)
     return current_load > (ht->load_factor);  //Om det aktuella "loaden" är större än vad som tillåts, returneras sant.
 }
 
-static void hash_table_grow(ioopm_hash_table_t *ht)
-{
-    //printf("Growing, no of bucket=%d\n", (int) ht->no_buckets);
-    size_t primes[] = {17, 31, 67, 127, 257, 509, 1021, 2053, 4099, 8191, 16381, 32009, 65269};
-    int primes_length = sizeof(primes) / sizeof(size_t); 
-    size_t new_size;
+static const size_t primes[] = {17, 31, 67, 127, 257, 509, 1021, 2053, 4099, 8191, 16381, 32009, 65269,
+                                 131071, 262139, 524287, 1048573, 2097143, 4194301, 8388593, 16777213};
+static const int primes_length = sizeof(primes) / sizeof(size_t);
 
-    ioopm_list_t *keys = ioopm_hash_table_keys(ht);
-    ioopm_list_t *values = ioopm_hash_table_values(ht);
+static entry_t *find_previous_entry_for_key(ioopm_hash_table_t *ht, entry_t *entry, elem_t key);
+
+/// Move every entry into a new array of no_buckets buckets. The entries themselves
+/// are relinked, not copied, so nothing but the bucket array is allocated.
+static void hash_table_rehash(ioopm_hash_table_t *ht, size_t no_buckets)
+{
+    entry_t *old_buckets = ht->buckets;
+    size_t old_no_buckets = ht->no_buckets;
     
-    ioopm_list_iterator_t *key_iter = ioopm_list_iterator(keys);
-    ioopm_list_iterator_t *value_iter = ioopm_list_iterator(values);
+    ht->buckets = ioopm_allocator_alloc(ht->allocator, no_buckets * sizeof(entry_t));
+    ht->no_buckets = no_buckets;
     
-    for (int i = 0; i < primes_length - 1; ++i)
+    for(size_t i = 0; i < old_no_buckets; ++i)
     {
-        if (ht->no_buckets == primes[i])
+        entry_t *current_entry = old_buckets[i].next;
+        while(current_entry)
         {
-            new_size = primes[i+1];
+            entry_t *next_entry = current_entry->next;
+            int bucket = ht->hash_function(current_entry->key) % no_buckets;
+            entry_t *prev = find_previous_entry_for_key(ht, &ht->buckets[bucket], current_entry->key);
+            current_entry->next = prev->next;
+            prev->next = current_entry;
+            current_entry = next_entry;
         }
     }
-    
-    ioopm_hash_table_clear(ht);
-    ht->buckets = realloc(ht->buckets, new_size*sizeof(entry_t));
-    for(int i = 0; i < new_size; ++i)
+    ioopm_allocator_free(ht->allocator, old_buckets, old_no_buckets * sizeof(entry_t));
+}
+
+static void hash_table_grow(ioopm_hash_table_t *ht)
+{
+    uint64_t trace_start = ioopm_trace_begin();
+    //printf("Growing, no of bucket=%d\n", (int) ht->no_buckets);
+    for (int i = 0; i < primes_length; ++i)
     {
-        ht->buckets[i].next = NULL;
+        if (primes[i] > ht->no_buckets)
+        {
+            hash_table_rehash(ht, primes[i]);
+            break;
+        }
     }
-    ht->no_buckets = new_size;
-    
-    elem_t current_key, current_value;
-    ioopm_iterator_current(key_iter, &current_key);
-    ioopm_iterator_current(value_iter, &current_value);
-    
-    bool iter_has_value = ioopm_iterator_current(key_iter, &current_key) && ioopm_iterator_current(value_iter, &current_value);
-    while(iter_has_value)
-    {    
-        ioopm_hash_table_insert(ht, current_key, current_value);
-        iter_has_value = (ioopm_iterator_next(key_iter, &current_key) && ioopm_iterator_next(value_iter, &current_value));
+    // Already at the largest size, the chains are allowed to grow longer
+    ioopm_trace_end("hash_table_grow", trace_start, (int) ht->no_buckets);
+}
+
+void ioopm_hash_table_reserve(ioopm_hash_table_t *ht, size_t no_entries)
+{
+    for (int i = 0; i < primes_length; ++i)
+    {
+        if (primes[i] >= no_entries || i == primes_length - 1)  // short chains, the table is expected to be this big
+        {
+            if (primes[i] > ht->no_buckets)
+            {
+                hash_table_rehash(ht, primes[i]);
+            }
+            return;
+        }
     }
-    
-    ioopm_iterator_destroy(&key_iter);
-    ioopm_iterator_destroy(&value_iter);
-    ioopm_linked_list_destroy(keys);
-    ioopm_linked_list_destroy(values);
+}
+
+/// A chain is ordered by hash, so the walk for a key passes entries with a smaller hash, or the same hash and another key
+static inline bool walk_passes(ioopm_hash_table_t *ht, entry_t *entry, int key_hash, elem_t key)
+{
+    int entry_hash = ht->hash_function(entry->key);
+    return entry_hash < key_hash || (entry_hash == key_hash && !ht->key_eq_function(entry->key, key));
+}
+
+/// The chain walk of find_previous_entry_for_key as a span, with the number of entries passed
+static entry_t *find_previous_entry_traced(ioopm_hash_table_t *ht, entry_t *entry, elem_t key)
+{
+    uint64_t trace_start = ioopm_trace_clock();
+    int key_hash = ht->hash_function(key);
+    int no_passed = 0;
+    while (entry->next != NULL && walk_passes(ht, entry->next, key_hash, key))
+    {
+        entry = entry->next;
+        ++no_passed;
+    }
+    ioopm_trace_record("find_previous_entry_for_key", trace_start, no_passed);
+    return entry;
 }
 
 static entry_t *find_previous_entry_for_key(ioopm_hash_table_t *ht, entry_t *entry, elem_t key)
 {
+    if (__builtin_expect(atomic_load_explicit(&ioopm_trace_enabled, memory_order_relaxed), 0))
+    {
+        return find_previous_entry_traced(ht, entry, key);   // Kept apart so the untraced walk counts nothing
+    }
+    int key_hash = ht->hash_function(key);
     while (entry->next != NULL)
     {
-        if (ht->hash_function(entry->next->key) >= ht->hash_function(key))
+        if (!walk_passes(ht, entry->next, key_hash, key))
         {
             return entry;
         }
@@ -164,7 +225,7 @@ static entry_t *find_previous_entry_for_key(ioopm_hash_table_t *ht, entry_t *ent
 
 static entry_t *entry_create(ioopm_hash_table_t *ht, elem_t key, elem_t value, entry_t *next)
 {
-    entry_t *new_entry = calloc(1, sizeof(entry_t));
+    entry_t *new_entry = ioopm_allocator_alloc(ht->allocator, sizeof(entry_t));
     new_entry->key = key;
     new_entry->value = value;
     new_entry->next = next;     
@@ -198,9 +259,9 @@ bool ioopm_hash_table_insert(ioopm_hash_table_t *ht, elem_t key, elem_t value)
     else
     {
         tmp->next = entry_create(ht, key, value, current_entry);
+        ht->size += 1;
     }
     
-    ht->size += 1;
     return true;
 }
 
@@ -258,7 +319,7 @@ bool ioopm_hash_table_remove_w_key(ioopm_hash_table_t *ht, elem_t key, elem_t *r
             *key_res = current_entry->key;
         }
         *result = current_entry->value;
-        entry_destroy(&current_entry);
+        entry_destroy(ht, &current_entry);
         ht->size -= 1;
         return true;
     }
@@ -272,13 +333,13 @@ bool ioopm_hash_table_remove(ioopm_hash_table_t *ht, elem_t key, elem_t *result)
     return ioopm_hash_table_remove_w_key(ht, key, result, NULL);
 }
 
-static void entry_destroy(entry_t **entry_to_destroy)
+static void entry_destroy(ioopm_hash_table_t *ht, entry_t **entry_to_destroy)
 {
-    free(*entry_to_destroy);
+    ioopm_allocator_free(ht->allocator, *entry_to_destroy, sizeof(entry_t));
     *entry_to_destroy = NULL;
 }
 
-static void entries_destroy_all_iterativ(entry_t **e)
+static void entries_destroy_all_iterativ(ioopm_hash_table_t *ht, entry_t **e)
 {
     entry_t *current_entry = *e;
     entry_t *next_entry;
@@ -286,7 +347,7 @@ static void entries_destroy_all_iterativ(entry_t **e)
     while (current_entry)
     {
         next_entry = current_entry->next;
-        entry_destroy(&current_entry);
+        entry_destroy(ht, &current_entry);
         current_entry = next_entry;
     }
     *e = NULL;
@@ -308,7 +369,7 @@ void ioopm_hash_table_clear(ioopm_hash_table_t *ht)
     {
         if (ht->buckets[i].next)
         {
-            entries_destroy_all_iterativ(&(ht->buckets[i].next));
+            entries_destroy_all_iterativ(ht, &(ht->buckets[i].next));
         }
     }   
     ht->size = 0;
@@ -317,7 +378,17 @@ void ioopm_hash_table_clear(ioopm_hash_table_t *ht)
 
 ioopm_list_t *ioopm_hash_table_keys(ioopm_hash_table_t *ht)
 {
-    ioopm_list_t *list_of_keys = ioopm_linked_list_create(ht->key_eq_function);
+    return ioopm_hash_table_keys_in(ht, NULL);
+}
+
+ioopm_list_t *ioopm_hash_table_values(ioopm_hash_table_t *ht)
+{
+    return ioopm_hash_table_values_in(ht, NULL);
+}
+
+ioopm_list_t *ioopm_hash_table_keys_in(ioopm_hash_table_t *ht, ioopm_arena_t *arena)
+{
+    ioopm_list_t *list_of_keys = ioopm_linked_list_create_with_allocator(ht->key_eq_function, arena ? ioopm_arena_allocator(arena) : NULL);
     
     for(int i = 0; i < ht->no_buckets; ++i)
     {
@@ -332,9 +403,9 @@ ioopm_list_t *ioopm_hash_table_keys(ioopm_hash_table_t *ht)
     return list_of_keys;
 }
 
-ioopm_list_t *ioopm_hash_table_values(ioopm_hash_table_t *ht)
+ioopm_list_t *ioopm_hash_table_values_in(ioopm_hash_table_t *ht, ioopm_arena_t *arena)
 {
-    ioopm_list_t *list_of_values = ioopm_linked_list_create(ht->value_eq_function);
+    ioopm_list_t *list_of_values = ioopm_linked_list_create_with_allocator(ht->value_eq_function, arena ? ioopm_arena_allocator(arena) : NULL);
     
     for(int i = 0; i < ht->no_buckets; ++i)
     {
@@ -365,7 +436,7 @@ bool ioopm_hash_table_all(ioopm_hash_table_t *ht, ioopm_predicate pred, void *ar
     ioopm_list_t *keys = ioopm_hash_table_keys(ht);
     ioopm_list_t *values = ioopm_hash_table_values(ht);
     bool result = true;
-
+    
     for (int i = 0; i < size; ++i)
     {
         if(!pred(ht, ioopm_linked_list_get(keys, i), ioopm_linked_list_get(values, i), arg))
@@ -413,14 +484,20 @@ bool ioopm_hash_table_any(ioopm_hash_table_t *ht, ioopm_predicate pred, void *ar
 
 void ioopm_hash_table_apply_to_all(ioopm_hash_table_t *ht, ioopm_apply_function apply_fun, void *arg)
 { 
-    size_t size = ioopm_hash_table_size(ht);
     ioopm_list_t *keys = ioopm_hash_table_keys(ht);
     ioopm_list_t *values = ioopm_hash_table_values(ht);
+    ioopm_list_iterator_t *key_iter = ioopm_list_iterator(keys);        // walked in step, not indexed, so the whole walk is O(n)
+    ioopm_list_iterator_t *value_iter = ioopm_list_iterator(values);
+    elem_t key, value;
     
-    for (int i = 0; i < size; ++i)
+    bool has_next = ioopm_iterator_current(key_iter, &key) && ioopm_iterator_current(value_iter, &value);
+    while (has_next)
     {
-        apply_fun(ht, ioopm_linked_list_get(keys, i), ioopm_linked_list_get(values, i), arg); 
+        apply_fun(ht, key, value, arg);
+        has_next = ioopm_iterator_next(key_iter, &key) && ioopm_iterator_next(value_iter, &value);
     }
+    ioopm_iterator_destroy(&key_iter);
+    ioopm_iterator_destroy(&value_iter);
     ioopm_linked_list_destroy(keys);
     ioopm_linked_list_destroy(values);
 }
\ No newline at end of file
@@ -16,7 +16,7 @@
  *
  * @see http://wrigstad.com/ioopm19/assignments/assignment1.html
  */
- 
+
 typedef struct hash_table ioopm_hash_table_t;
 typedef bool(*ioopm_predicate)(ioopm_hash_table_t *ht, elem_t key, elem_t value, void *extra);
 typedef void(*ioopm_apply_function)(ioopm_hash_table_t *ht, elem_t key, elem_t value, void *extra);
@@ -32,6 +32,17 @@ ioopm_hash_table_t *ioopm_hash_table_create(ioopm_eq_function key_eq,
                                             ioopm_eq_function val_eq, 
                                             ioopm_hash_function hash_function);
 
+/// @brief Create a new hash table whose entries are allocated by an allocator, see ioopm_hash_table_create
+/// @param key_eq pointer to function for comparing keys
+/// @param val_eq pointer to function for comparing values
+/// @param hash_function pointer to hashing function, which returns a positive integer 
+/// @param allocator the allocator of the table, or NULL for calloc and free
+/// @return A new empty hash table
+ioopm_hash_table_t *ioopm_hash_table_create_with_allocator(ioopm_eq_function key_eq, 
+                                                           ioopm_eq_function val_eq, 
+                                                           ioopm_hash_function hash_function,
+                                                           ioopm_allocator_t *allocator);
+
 /// @brief Delete a hash table, free its memory and set its pointer to NULL
 /// @param ht double ref pointer to a hash table to be deleted
 void ioopm_hash_table_destroy(ioopm_hash_table_t **ht);
@@ -67,6 +78,12 @@ bool ioopm_hash_table_remove(ioopm_hash_table_t *ht, elem_t key, elem_t *result)
 /// @return true is removal was successful, else false
 bool ioopm_hash_table_remove_w_key(ioopm_hash_table_t *ht, elem_t key, elem_t *result, elem_t *key_res);
 
+/// @brief make room for no_entries entries up front, with about one entry per bucket,
+/// so that inserting them does not grow the table step by step
+/// @param ht hash table operated upon
+/// @param no_entries the number of entries the table is expected to hold
+void ioopm_hash_table_reserve(ioopm_hash_table_t *ht, size_t no_entries);
+
 /// @brief returns the number of key => value entries in the hash table
 /// @param h hash table operated upon
 /// @return the number of key => value entries in the hash table
@@ -91,6 +108,18 @@ ioopm_list_t *ioopm_hash_table_keys(ioopm_hash_table_t *ht);
 /// @return an ioopm_list_t, (a linked list), with the values for a hash table h
 ioopm_list_t *ioopm_hash_table_values(ioopm_hash_table_t *ht);
 
+/// @brief return the keys for all entries in a hash map, in a list allocated in an arena (see ioopm_linked_list_create_in)
+/// @param h hash table operated upon
+/// @param arena the arena to allocate the list in
+/// @return an ioopm_list_t, (a linked list), with the keys for a hash table h
+ioopm_list_t *ioopm_hash_table_keys_in(ioopm_hash_table_t *ht, ioopm_arena_t *arena);
+
+/// @brief return the values for all entries in a hash map, in a list allocated in an arena (see ioopm_linked_list_create_in)
+/// @param h hash table operated upon
+/// @param arena the arena to allocate the list in
+/// @return an ioopm_list_t, (a linked list), with the values for a hash table h
+ioopm_list_t *ioopm_hash_table_values_in(ioopm_hash_table_t *ht, ioopm_arena_t *arena);
+
 /// @brief check if a hash table has an entry with a given key
 /// @param h hash table operated upon
 /// @param key the key sought
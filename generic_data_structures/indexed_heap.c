@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "indexed_heap.h"
+
+#define Default_capacity 16
+#define No_handle -1
+
+typedef struct node node_t;
+
+struct node
+{
+    int key;
+    int handle;
+    elem_t value;
+};
+
+struct indexed_heap
+{
+    node_t *nodes;          // nodes[0] is the smallest, the children of nodes[i] are nodes[2i + 1] and nodes[2i + 2]
+    size_t size;
+    size_t capacity;
+    int *positions;         // handle => index in nodes, or the next free handle if the handle is free
+    int no_handles;
+    int free_handle;        // first free handle, or No_handle
+};
+
+ioopm_indexed_heap_t *ioopm_indexed_heap_create()
+{
+    ioopm_indexed_heap_t *heap = calloc(1, sizeof(ioopm_indexed_heap_t));
+    heap->capacity = Default_capacity;
+    heap->nodes = calloc(heap->capacity, sizeof(node_t));
+    heap->positions = calloc(heap->capacity, sizeof(int));
+    heap->free_handle = No_handle;
+    return heap;
+}
+
+void ioopm_indexed_heap_destroy(ioopm_indexed_heap_t **heap)
+{
+    free((*heap)->nodes);
+    free((*heap)->positions);
+    free(*heap);
+    *heap = NULL;
+}
+
+static void place(ioopm_indexed_heap_t *heap, size_t index, node_t node)
+{
+    heap->nodes[index] = node;
+    heap->positions[node.handle] = (int) index;
+}
+
+// Moves the node at index up or down until its parent is no larger and its children no smaller
+static void restore(ioopm_indexed_heap_t *heap, size_t index)
+{
+    node_t node = heap->nodes[index];
+    while(index > 0 && heap->nodes[(index - 1) / 2].key > node.key)
+    {
+        place(heap, index, heap->nodes[(index - 1) / 2]);
+        index = (index - 1) / 2;
+    }
+    while(2 * index + 1 < heap->size)
+    {
+        size_t child = 2 * index + 1;
+        if(child + 1 < heap->size && heap->nodes[child + 1].key < heap->nodes[child].key)
+        {
+            ++child;
+        }
+        if(heap->nodes[child].key >= node.key)
+        {
+            break;
+        }
+        place(heap, index, heap->nodes[child]);
+        index = child;
+    }
+    place(heap, index, node);
+}
+
+int ioopm_indexed_heap_insert(ioopm_indexed_heap_t *heap, int key, elem_t value)
+{
+    if(heap->size == heap->capacity)
+    {
+        heap->capacity *= 2;
+        heap->nodes = realloc(heap->nodes, heap->capacity * sizeof(node_t));
+        heap->positions = realloc(heap->positions, heap->capacity * sizeof(int));
+    }
+    
+    int handle = heap->free_handle;
+    if(handle == No_handle)
+    {
+        handle = heap->no_handles++;        // there are never more handles than values, so it fits
+    }
+    else
+    {
+        heap->free_handle = heap->positions[handle];
+    }
+    
+    place(heap, heap->size++, (node_t) { .key = key, .handle = handle, .value = value });
+    restore(heap, heap->size - 1);
+    return handle;
+}
+
+void ioopm_indexed_heap_update(ioopm_indexed_heap_t *heap, int handle, int key)
+{
+    size_t index = heap->positions[handle];
+    heap->nodes[index].key = key;
+    restore(heap, index);
+}
+
+elem_t ioopm_indexed_heap_remove(ioopm_indexed_heap_t *heap, int handle)
+{
+    size_t index = heap->positions[handle];
+    elem_t value = heap->nodes[index].value;
+    
+    node_t last = heap->nodes[--heap->size];
+    if(index < heap->size)
+    {
+        place(heap, index, last);
+        restore(heap, index);
+    }
+    heap->positions[handle] = heap->free_handle;
+    heap->free_handle = handle;
+    return value;
+}
+
+size_t ioopm_indexed_heap_smallest(ioopm_indexed_heap_t *heap, int below, elem_t *values, int *keys, size_t max_values)
+{
+    return ioopm_indexed_heap_smallest_in(heap, below, values, keys, max_values, NULL);
+}
+
+// Best-first walk of the heap: a node is only looked at once its parent has been found, and
+// the candidates are kept in a small heap of their own
+size_t ioopm_indexed_heap_smallest_in(ioopm_indexed_heap_t *heap, int below, elem_t *values, int *keys, size_t max_values, ioopm_arena_t *arena)
+{
+    size_t size = (2 * max_values + 1) * sizeof(size_t);
+    size_t *candidates = arena ? ioopm_arena_alloc(arena, size) : malloc(size);    // indexes in heap->nodes, ordered by key
+    size_t no_candidates = 0;
+    size_t no_found = 0;
+    
+    if(heap->size > 0 && max_values > 0)
+    {
+        candidates[no_candidates++] = 0;
+    }
+    while(no_candidates > 0 && no_found < max_values)
+    {
+        size_t smallest = candidates[0];
+        if(heap->nodes[smallest].key >= below)
+        {
+            break;
+        }
+        values[no_found] = heap->nodes[smallest].value;
+        keys[no_found++] = heap->nodes[smallest].key;
+        
+        // Replace the smallest candidate by its children, each pushed into the candidate heap
+        size_t children[2] = { 2 * smallest + 1, 2 * smallest + 2 };
+        candidates[0] = candidates[--no_candidates];
+        for(size_t i = 0; i < no_candidates; )           // sift the moved candidate down
+        {
+            size_t child = 2 * i + 1;
+            if(child >= no_candidates)
+            {
+                break;
+            }
+            if(child + 1 < no_candidates && heap->nodes[candidates[child + 1]].key < heap->nodes[candidates[child]].key)
+            {
+                ++child;
+            }
+            if(heap->nodes[candidates[child]].key >= heap->nodes[candidates[i]].key)
+            {
+                break;
+            }
+            size_t swap = candidates[i];
+            candidates[i] = candidates[child];
+            candidates[child] = swap;
+            i = child;
+        }
+        for(int c = 0; c < 2; ++c)
+        {
+            if(children[c] >= heap->size)
+            {
+                continue;
+            }
+            size_t i = no_candidates++;             // sift the child up
+            candidates[i] = children[c];
+            while(i > 0 && heap->nodes[candidates[(i - 1) / 2]].key > heap->nodes[candidates[i]].key)
+            {
+                size_t swap = candidates[i];
+                candidates[i] = candidates[(i - 1) / 2];
+                candidates[(i - 1) / 2] = swap;
+                i = (i - 1) / 2;
+            }
+        }
+    }
+    
+    if(arena == NULL)
+    {
+        free(candidates);
+    }
+    return no_found;
+}
+
+size_t ioopm_indexed_heap_size(ioopm_indexed_heap_t *heap)
+{
+    return heap->size;
+}
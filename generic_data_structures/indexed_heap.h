@@ -0,0 +1,67 @@
+#pragma once
+#include "common.h"
+#include "arena.h"
+
+/**
+ * @file indexed_heap.h
+ * @brief Binary min-heap of values with int keys, whose keys can be changed in place.
+ *
+ * Inserting a value gives a handle for it, which stays valid until the value is
+ * removed however the value moves in the heap. The key of any value can then be
+ * changed, and the value removed, in O(log n) time.
+ */
+
+typedef struct indexed_heap ioopm_indexed_heap_t;
+
+/// @brief Create a new, empty heap
+/// @return an empty heap
+ioopm_indexed_heap_t *ioopm_indexed_heap_create();
+
+/// @brief Delete a heap, free its memory (but not the memory of the values) and set its pointer to NULL
+/// @param heap double ref pointer to the heap to be deleted
+void ioopm_indexed_heap_destroy(ioopm_indexed_heap_t **heap);
+
+/// @brief Insert a value in O(log n) time
+/// @param heap the heap operated upon
+/// @param key the key of the value, smaller keys come first
+/// @param value the value to insert
+/// @return the handle of the value
+int ioopm_indexed_heap_insert(ioopm_indexed_heap_t *heap, int key, elem_t value);
+
+/// @brief Change the key of a value in O(log n) time
+/// @param heap the heap operated upon
+/// @param handle the handle of the value, as returned by ioopm_indexed_heap_insert
+/// @param key the new key
+void ioopm_indexed_heap_update(ioopm_indexed_heap_t *heap, int handle, int key);
+
+/// @brief Remove a value in O(log n) time. Its handle may be given to a later insert
+/// @param heap the heap operated upon
+/// @param handle the handle of the value, as returned by ioopm_indexed_heap_insert
+/// @return the value
+elem_t ioopm_indexed_heap_remove(ioopm_indexed_heap_t *heap, int handle);
+
+/// @brief Find the values with the smallest keys, smallest first, without changing the heap,
+/// in O(k log k) time for k values found
+/// @param heap the heap operated upon
+/// @param below only values with keys less than this are found
+/// @param values set to the values found
+/// @param keys set to their keys
+/// @param max_values the most values to find
+/// @return the number of values found
+size_t ioopm_indexed_heap_smallest(ioopm_indexed_heap_t *heap, int below, elem_t *values, int *keys, size_t max_values);
+
+/// @brief Find the values with the smallest keys as ioopm_indexed_heap_smallest does, with the
+/// candidates looked at allocated in an arena instead of on the heap
+/// @param heap the heap operated upon
+/// @param below only values with keys less than this are found
+/// @param values set to the values found
+/// @param keys set to their keys
+/// @param max_values the most values to find
+/// @param arena the arena to allocate in, or NULL to use malloc
+/// @return the number of values found
+size_t ioopm_indexed_heap_smallest_in(ioopm_indexed_heap_t *heap, int below, elem_t *values, int *keys, size_t max_values, ioopm_arena_t *arena);
+
+/// @brief Lookup the number of values in O(1) time
+/// @param heap the heap operated upon
+/// @return the number of values
+size_t ioopm_indexed_heap_size(ioopm_indexed_heap_t *heap);
@@ -9,13 +9,15 @@ struct iter
 {
     link_t **current;
     ioopm_list_t *list;
+    ioopm_allocator_t *allocator;   // the allocator of list, which may be gone when the iterator is destroyed
 };
 
 ioopm_list_iterator_t *ioopm_list_iterator(ioopm_list_t *list)
 {
-    ioopm_list_iterator_t *new_iterator = calloc(1, sizeof(ioopm_list_iterator_t));
+    ioopm_list_iterator_t *new_iterator = ioopm_allocator_alloc(list->allocator, sizeof(ioopm_list_iterator_t));
     new_iterator->current = &list->first;
     new_iterator->list = list;
+    new_iterator->allocator = list->allocator;
     return new_iterator;
 }
 
@@ -56,6 +58,6 @@ bool ioopm_iterator_current(ioopm_list_iterator_t *iter, elem_t *result)
 
 void ioopm_iterator_destroy(ioopm_list_iterator_t **iter)
 {
-    free(*iter);
+    ioopm_allocator_free((*iter)->allocator, *iter, sizeof(ioopm_list_iterator_t));
     *iter = NULL;
 }
@@ -3,24 +3,40 @@
 #include <errno.h>
 #include "linked_list.h"
 
-static link_t *link_create(elem_t value, link_t *next);
+static link_t *link_create(ioopm_list_t *list, elem_t value, link_t *next);
+static void link_destroy(ioopm_list_t *list, link_t *link);
 
 ioopm_list_t *ioopm_linked_list_create(ioopm_eq_function eq)       
 {
-    ioopm_list_t *linked_list = calloc(1, sizeof(ioopm_list_t));
+    return ioopm_linked_list_create_with_allocator(eq, NULL);
+}
+
+ioopm_list_t *ioopm_linked_list_create_with_allocator(ioopm_eq_function eq, ioopm_allocator_t *allocator)
+{
+    ioopm_list_t *linked_list = ioopm_allocator_alloc(allocator, sizeof(ioopm_list_t));
     linked_list->eq_function = eq;                                           
+    linked_list->allocator = allocator;
     return linked_list;
 }
 
+ioopm_list_t *ioopm_linked_list_create_in(ioopm_arena_t *arena, ioopm_eq_function eq)
+{
+    return ioopm_linked_list_create_with_allocator(eq, ioopm_arena_allocator(arena));
+}
+
 void ioopm_linked_list_destroy(ioopm_list_t *list)
 {
+    if(!ioopm_allocator_frees(list->allocator))
+    {
+        return; // freed all at once by the allocator, as with an arena frame
+    }
     ioopm_linked_list_clear(list);
-    free(list);
+    ioopm_allocator_free(list->allocator, list, sizeof(ioopm_list_t));
 }
 
 void ioopm_linked_list_append(ioopm_list_t *list, elem_t value)
 {
-    link_t *new_link = link_create(value, NULL);
+    link_t *new_link = link_create(list, value, NULL);
     
     if (ioopm_linked_list_is_empty(list))
     {
@@ -37,7 +53,7 @@ void ioopm_linked_list_append(ioopm_list_t *list, elem_t value)
 
 void ioopm_linked_list_prepend(ioopm_list_t *list, elem_t value)
 {
-    link_t *new_link = link_create(value, NULL);
+    link_t *new_link = link_create(list, value, NULL);
     
     if (ioopm_linked_list_is_empty(list))
     {
@@ -64,6 +80,11 @@ bool ioopm_linked_list_is_empty(ioopm_list_t *list)
 
 void ioopm_linked_list_clear(ioopm_list_t *list)
 {
+    if(!ioopm_allocator_frees(list->allocator))
+    {
+        *list = (ioopm_list_t) { .eq_function = list->eq_function, .allocator = list->allocator };
+        return;
+    }
     size_t list_size = ioopm_linked_list_size(list);
     elem_t res_ignored;
     
@@ -88,7 +109,7 @@ bool ioopm_linked_list_remove(ioopm_list_t *list, int index, elem_t *value)
     {
         list->first = cursor->next;
         *value = cursor->value;
-        free(cursor);
+        link_destroy(list, cursor);
         
         list->size -= 1;
         return true;    
@@ -104,7 +125,7 @@ bool ioopm_linked_list_remove(ioopm_list_t *list, int index, elem_t *value)
         cursor->next = NULL;
         cursor = tmp;
         *value = cursor->value;
-        free(cursor);
+        link_destroy(list, cursor);
         
         list->size -= 1;
         return true;
@@ -118,9 +139,9 @@ bool ioopm_linked_list_remove(ioopm_list_t *list, int index, elem_t *value)
         link_t *tmp = cursor->next;         
         cursor->next = cursor->next->next;  //Pekaren innan det man vill ta bort byts till den det man vill ta bort på.
         cursor = tmp;
-    
+        
         *value = cursor->value;
-        free(cursor);
+        link_destroy(list, cursor);
         
         list->size -=1;
         return true;
@@ -156,9 +177,9 @@ bool ioopm_linked_list_insert(ioopm_list_t *list, int index, elem_t value)
             cursor = cursor->next;          //Stannar innan linken där man vill lägga till något
         }
         
-        link_t *new_link = link_create(value, cursor->next);
+        link_t *new_link = link_create(list, value, cursor->next);
         cursor->next = new_link; 
-    
+        
         list->size += 1;
         return true;
     }
@@ -172,7 +193,7 @@ elem_t ioopm_linked_list_get(ioopm_list_t *list, int index)
         cursor = cursor->next;
     }
     return cursor->value;
-    
+
 }
 
 bool ioopm_linked_list_contains(ioopm_list_t *list, elem_t value)
@@ -233,10 +254,15 @@ void ioopm_linked_apply_to_all (ioopm_list_t *list, ioopm_apply_char_function fu
 //
 // ** PRIVATE FUNCTIONS **
 //
-link_t *link_create(elem_t value, link_t *next)
+link_t *link_create(ioopm_list_t *list, elem_t value, link_t *next)
 {
-    link_t *new_link = calloc(1, sizeof(link_t));
+    link_t *new_link = ioopm_allocator_alloc(list->allocator, sizeof(link_t));
     new_link->value = value;
     new_link->next = next;
     return new_link;
 }
+
+void link_destroy(ioopm_list_t *list, link_t *link)
+{
+    ioopm_allocator_free(list->allocator, link, sizeof(link_t));
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include "common.h"
+#include "arena.h"
+#include "allocator.h"
 
 typedef struct list ioopm_list_t; 
 typedef struct iter ioopm_list_iterator_t;
@@ -11,6 +13,20 @@ typedef void(*ioopm_apply_char_function)(elem_t *value, void *extra);
 /// @return an empty linked list
 ioopm_list_t *ioopm_linked_list_create(ioopm_eq_function eq);
 
+/// @brief Creates a new empty list whose links, and iterators, are allocated by an allocator
+/// @param function for comparing values
+/// @param allocator the allocator of the list, or NULL for calloc and free
+/// @return an empty linked list
+ioopm_list_t *ioopm_linked_list_create_with_allocator(ioopm_eq_function eq, ioopm_allocator_t *allocator);
+
+/// @brief Creates a new empty list whose links, and iterators, are allocated in an arena.
+/// Nothing of it is freed before the arena frame it was created in is popped,
+/// and destroying or clearing it is O(1)
+/// @param arena the arena to allocate in
+/// @param function for comparing values
+/// @return an empty linked list
+ioopm_list_t *ioopm_linked_list_create_in(ioopm_arena_t *arena, ioopm_eq_function eq);
+
 /// @brief Tear down the linked list (including all links)
 /// and return all its memory (but not the memory of the elements)
 /// @param list the list to be destroyed
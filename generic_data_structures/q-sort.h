@@ -1,2 +0,0 @@
-#pragma once
-void sort_keys(char *keys[], size_t no_keys);
\ No newline at end of file
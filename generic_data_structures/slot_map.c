@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "slot_map.h"
+
+#define Default_capacity 16
+#define Index_bits 21                       // up to 2M - 1 slots
+#define Generation_bits 10                  // a slot holds 1024 values before it is retired
+#define Max_slots ((1 << Index_bits) - 1)   // ids hold index + 1, so the last index would not fit
+#define Max_generation ((1 << Generation_bits) - 1)
+#define No_free_slot -1
+#define Retired_slot -2                     // next_free of a slot that is never reused
+
+typedef struct slot slot_t;
+
+struct slot
+{
+    elem_t value;
+    int generation;
+    int next_free;      // index of the next free slot, only meaningful when the slot is free
+    bool live;
+};
+
+struct slot_map
+{
+    slot_t *slots;
+    size_t capacity;
+    size_t used;        // number of slots that have ever held a value
+    size_t size;        // number of live values
+    int free_head;
+};
+
+static int make_id(int index, int generation)
+{
+    return (generation << Index_bits) | (index + 1);
+}
+
+static int id_index(int id)
+{
+    return (id & ((1 << Index_bits) - 1)) - 1;
+}
+
+static int id_generation(int id)
+{
+    return (id >> Index_bits) & ((1 << Generation_bits) - 1);
+}
+
+ioopm_slot_map_t *ioopm_slot_map_create()
+{
+    ioopm_slot_map_t *sm = calloc(1, sizeof(ioopm_slot_map_t));
+    sm->slots = calloc(Default_capacity, sizeof(slot_t));
+    sm->capacity = Default_capacity;
+    sm->free_head = No_free_slot;
+    return sm;
+}
+
+void ioopm_slot_map_destroy(ioopm_slot_map_t **sm)
+{
+    free((*sm)->slots);
+    free(*sm);
+    *sm = NULL;
+}
+
+static slot_t *find_live_slot(ioopm_slot_map_t *sm, int id)
+{
+    int index = id_index(id);
+    if(id <= 0 || index < 0 || index >= (int) sm->used)
+    {
+        return NULL;
+    }
+    
+    slot_t *slot = &sm->slots[index];
+    return (slot->live && slot->generation == id_generation(id)) ? slot : NULL;
+}
+
+int ioopm_slot_map_insert(ioopm_slot_map_t *sm, elem_t value)
+{
+    int index;
+    if(sm->free_head != No_free_slot)
+    {
+        index = sm->free_head;
+        sm->free_head = sm->slots[index].next_free;
+    }
+    else
+    {
+        if(sm->used == Max_slots)
+        {
+            return 0;   // every slot is live or retired, there is no id left to give out
+        }
+        if(sm->used == sm->capacity)
+        {
+            sm->capacity *= 2;
+            sm->slots = realloc(sm->slots, sm->capacity * sizeof(slot_t));
+        }
+        index = sm->used++;
+        sm->slots[index].generation = 0;
+    }
+    
+    slot_t *slot = &sm->slots[index];
+    slot->value = value;
+    slot->live = true;
+    sm->size += 1;
+    return make_id(index, slot->generation);
+}
+
+bool ioopm_slot_map_lookup(ioopm_slot_map_t *sm, int id, elem_t *result)
+{
+    slot_t *slot = find_live_slot(sm, id);
+    if(slot == NULL)
+    {
+        return false;
+    }
+    
+    *result = slot->value;
+    return true;
+}
+
+bool ioopm_slot_map_remove(ioopm_slot_map_t *sm, int id, elem_t *result)
+{
+    slot_t *slot = find_live_slot(sm, id);
+    if(slot == NULL)
+    {
+        return false;
+    }
+    
+    *result = slot->value;
+    slot->live = false;
+    sm->size -= 1;
+    if(slot->generation == Max_generation)
+    {
+        // A new generation would wrap around to ids that were already given out, and
+        // stale copies of those would resolve again, so the slot is not used any more
+        slot->next_free = Retired_slot;
+        return true;
+    }
+    slot->generation += 1;   // old ids for this slot stop resolving
+    slot->next_free = sm->free_head;
+    sm->free_head = id_index(id);
+    return true;
+}
+
+size_t ioopm_slot_map_size(ioopm_slot_map_t *sm)
+{
+    return sm->size;
+}
+
+void ioopm_slot_map_apply_to_all(ioopm_slot_map_t *sm, ioopm_slot_apply_function fun, void *extra)
+{
+    for(size_t i = 0; i < sm->used; ++i)
+    {
+        slot_t *slot = &sm->slots[i];
+        if(slot->live)
+        {
+            fun(make_id(i, slot->generation), slot->value, extra);
+        }
+    }
+}
+
+size_t ioopm_slot_map_no_slots(ioopm_slot_map_t *sm)
+{
+    return sm->used;
+}
+
+bool ioopm_slot_map_get_slot(ioopm_slot_map_t *sm, size_t index, int *generation, int *next_free, elem_t *value)
+{
+    slot_t *slot = &sm->slots[index];
+    *generation = slot->generation;
+    *next_free = slot->next_free;
+    *value = slot->value;
+    return slot->live;
+}
+
+int ioopm_slot_map_free_head(ioopm_slot_map_t *sm)
+{
+    return sm->free_head;
+}
+
+int ioopm_slot_map_set_slot(ioopm_slot_map_t *sm, size_t index, int generation, int next_free, bool live, elem_t value)
+{
+    if(index >= Max_slots || generation < 0 || generation > Max_generation)
+    {
+        return 0;   // no slot map could have saved this slot
+    }
+    while(index >= sm->capacity)
+    {
+        sm->capacity *= 2;
+        sm->slots = realloc(sm->slots, sm->capacity * sizeof(slot_t));
+    }
+    
+    slot_t *slot = &sm->slots[index];
+    slot->generation = generation;
+    slot->next_free = next_free;
+    slot->live = live;
+    slot->value = value;
+    sm->used = index + 1 > sm->used ? index + 1 : sm->used;
+    sm->size += live ? 1 : 0;
+    return make_id(index, generation);
+}
+
+void ioopm_slot_map_set_free_head(ioopm_slot_map_t *sm, int free_head)
+{
+    sm->free_head = free_head;
+}
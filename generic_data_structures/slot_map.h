@@ -0,0 +1,87 @@
+#pragma once
+#include "common.h"
+
+/**
+ * @file slot_map.h
+ * @brief Dense array of values addressed by generational ids.
+ *
+ * An id packs the index of a slot and the generation of that slot. Removing
+ * a value bumps the generation of its slot and puts the slot on a free list,
+ * so the slot is reused by a later insert while the old id stops resolving.
+ * A slot whose generation is at its maximum is retired when its value is
+ * removed, rather than wrapping around to the generation of ids already
+ * given out, so an id never resolves to a value inserted after it was
+ * removed. Ids are always positive, so they can be used as hash table keys.
+ */
+
+typedef struct slot_map ioopm_slot_map_t;
+typedef void(*ioopm_slot_apply_function)(int id, elem_t value, void *extra);
+
+/// @brief Create a new, empty slot map
+/// @return an empty slot map
+ioopm_slot_map_t *ioopm_slot_map_create();
+
+/// @brief Delete a slot map, free its memory (but not the memory of the values) and set its pointer to NULL
+/// @param sm double ref pointer to the slot map to be deleted
+void ioopm_slot_map_destroy(ioopm_slot_map_t **sm);
+
+/// @brief Insert a value in amortized O(1) time, reusing a free slot if there is one
+/// @param sm the slot map operated upon
+/// @param value the value to insert
+/// @return the id of the value, or 0 if all ids are used up by live values and retired slots
+int ioopm_slot_map_insert(ioopm_slot_map_t *sm, elem_t value);
+
+/// @brief Lookup the value for an id in O(1) time
+/// @param sm the slot map operated upon
+/// @param id the id sought
+/// @param result pointer to an elem_t for storing the value
+/// @return true if id refers to a value in the slot map, false if it never did or the value has been removed
+bool ioopm_slot_map_lookup(ioopm_slot_map_t *sm, int id, elem_t *result);
+
+/// @brief Remove the value for an id in O(1) time
+/// @param sm the slot map operated upon
+/// @param id the id of the value to remove
+/// @param result pointer to an elem_t for storing the removed value
+/// @return true if a value was removed, else false
+bool ioopm_slot_map_remove(ioopm_slot_map_t *sm, int id, elem_t *result);
+
+/// @brief Lookup the number of values in the slot map in O(1) time
+/// @param sm the slot map operated upon
+/// @return the number of values in the slot map
+size_t ioopm_slot_map_size(ioopm_slot_map_t *sm);
+
+/// @brief Apply a function to all values in the slot map, in slot order.
+/// The function may remove the value it is applied to.
+/// @param sm the slot map operated upon
+/// @param fun the function to be applied
+/// @param extra an additional argument (may be NULL) that will be passed to all calls of fun
+void ioopm_slot_map_apply_to_all(ioopm_slot_map_t *sm, ioopm_slot_apply_function fun, void *extra);
+
+/// @brief Lookup the number of slots that have ever held a value, which is the range of
+/// valid indexes for ioopm_slot_map_get_slot
+/// @param sm the slot map operated upon
+/// @return the number of slots in use or on the free list
+size_t ioopm_slot_map_no_slots(ioopm_slot_map_t *sm);
+
+/// @brief Read the raw state of a slot, so that the slot map can be saved and later restored exactly
+/// @param sm the slot map operated upon
+/// @param index the index of the slot, in [0, ioopm_slot_map_no_slots)
+/// @param generation set to the generation of the slot
+/// @param next_free set to the index of the next free slot, if the slot is free, or -2 if the slot is retired
+/// @param value set to the value in the slot, if the slot is live
+/// @return true if the slot holds a value, false if it is free
+bool ioopm_slot_map_get_slot(ioopm_slot_map_t *sm, size_t index, int *generation, int *next_free, elem_t *value);
+
+/// @brief Lookup the index of the first free slot
+/// @param sm the slot map operated upon
+/// @return the index of the slot the next insert will use, or -1 if a new slot will be used
+int ioopm_slot_map_free_head(ioopm_slot_map_t *sm);
+
+/// @brief Restore the raw state of a slot read with ioopm_slot_map_get_slot.
+/// Slots must be restored in index order, starting from an empty slot map.
+/// @return the id of the value in the slot, if live is true, or 0 if index or generation are out of
+/// range for a slot map, and nothing is restored
+int ioopm_slot_map_set_slot(ioopm_slot_map_t *sm, size_t index, int generation, int next_free, bool live, elem_t value);
+
+/// @brief Restore the first free slot read with ioopm_slot_map_free_head
+void ioopm_slot_map_set_free_head(ioopm_slot_map_t *sm, int free_head);
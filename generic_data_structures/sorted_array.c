@@ -0,0 +1,381 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sorted_array.h"
+
+#define Block_capacity 512          // values per block, a full block is split in two
+#define Block_fill (Block_capacity * 3 / 4)     // values per block when blocks are rebuilt, so inserts find room
+#define Default_no_blocks 4
+#define Default_no_inserted 16
+
+typedef struct block block_t;
+
+struct block
+{
+    size_t size;
+    elem_t values[Block_capacity];
+};
+
+struct sorted_array
+{
+    block_t **blocks;           // the values in order, every block holds at least one
+    size_t *starts;             // starts[b] is the index of the first value of blocks[b]
+    size_t no_blocks;
+    size_t blocks_capacity;
+    size_t no_sorted;           // values in the blocks
+    elem_t *inserted;           // values inserted since the array was last read, in no order
+    size_t no_inserted;
+    size_t inserted_capacity;
+    size_t last_block;          // block of the last value read, so reading in order finds the block in O(1)
+    ioopm_cmp_function cmp;
+};
+
+ioopm_sorted_array_t *ioopm_sorted_array_create(ioopm_cmp_function cmp)
+{
+    ioopm_sorted_array_t *sa = calloc(1, sizeof(ioopm_sorted_array_t));
+    sa->blocks_capacity = Default_no_blocks;
+    sa->blocks = calloc(sa->blocks_capacity, sizeof(block_t *));
+    sa->starts = calloc(sa->blocks_capacity, sizeof(size_t));
+    sa->inserted_capacity = Default_no_inserted;
+    sa->inserted = calloc(sa->inserted_capacity, sizeof(elem_t));
+    sa->cmp = cmp;
+    return sa;
+}
+
+void ioopm_sorted_array_destroy(ioopm_sorted_array_t **sa)
+{
+    for(size_t b = 0; b < (*sa)->no_blocks; ++b)
+    {
+        free((*sa)->blocks[b]);
+    }
+    free((*sa)->blocks);
+    free((*sa)->starts);
+    free((*sa)->inserted);
+    free(*sa);
+    *sa = NULL;
+}
+
+void ioopm_sorted_array_insert(ioopm_sorted_array_t *sa, elem_t value)
+{
+    if(sa->no_inserted == sa->inserted_capacity)
+    {
+        sa->inserted_capacity *= 2;
+        sa->inserted = realloc(sa->inserted, sa->inserted_capacity * sizeof(elem_t));
+    }
+    sa->inserted[sa->no_inserted++] = value;
+}
+
+/*=================================================================
+ *  Blocks
+ *=================================================================*/
+
+// Index of the first value in block not before key, or the size of the block if there is none
+static size_t block_lower_bound(ioopm_sorted_array_t *sa, block_t *block, elem_t key)
+{
+    size_t low = 0, high = block->size;
+    while(low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if(sa->cmp(block->values[middle], key) < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// The first block whose last value is not before key, or no_blocks if there is none
+static size_t find_block(ioopm_sorted_array_t *sa, elem_t key)
+{
+    size_t low = 0, high = sa->no_blocks;
+    while(low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        block_t *block = sa->blocks[middle];
+        if(sa->cmp(block->values[block->size - 1], key) < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// The block that holds the value at index, which is less than no_sorted
+static size_t block_of_index(ioopm_sorted_array_t *sa, size_t index)
+{
+    size_t hint = sa->last_block;
+    for(size_t b = hint; b < sa->no_blocks && b <= hint + 1; ++b)
+    {
+        if(sa->starts[b] <= index && index < sa->starts[b] + sa->blocks[b]->size)
+        {
+            return b;
+        }
+    }
+
+    size_t low = 0, high = sa->no_blocks - 1;   // the last block whose start is not after index
+    while(low < high)
+    {
+        size_t middle = high - (high - low) / 2;
+        if(sa->starts[middle] <= index)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+    return low;
+}
+
+// Makes room for a new block at index b of blocks, the caller sets it and its start
+static void open_block_slot(ioopm_sorted_array_t *sa, size_t b)
+{
+    if(sa->no_blocks == sa->blocks_capacity)
+    {
+        sa->blocks_capacity *= 2;
+        sa->blocks = realloc(sa->blocks, sa->blocks_capacity * sizeof(block_t *));
+        sa->starts = realloc(sa->starts, sa->blocks_capacity * sizeof(size_t));
+    }
+    memmove(sa->blocks + b + 1, sa->blocks + b, (sa->no_blocks - b) * sizeof(block_t *));
+    memmove(sa->starts + b + 1, sa->starts + b, (sa->no_blocks - b) * sizeof(size_t));
+    sa->no_blocks += 1;
+}
+
+static void close_block_slot(ioopm_sorted_array_t *sa, size_t b)
+{
+    free(sa->blocks[b]);
+    memmove(sa->blocks + b, sa->blocks + b + 1, (sa->no_blocks - b - 1) * sizeof(block_t *));
+    memmove(sa->starts + b, sa->starts + b + 1, (sa->no_blocks - b - 1) * sizeof(size_t));
+    sa->no_blocks -= 1;
+    sa->last_block = 0;
+}
+
+static void shift_starts(ioopm_sorted_array_t *sa, size_t from_block, long by)
+{
+    for(size_t b = from_block; b < sa->no_blocks; ++b)
+    {
+        sa->starts[b] += by;
+    }
+}
+
+// Splits a full block in two halves, the second half becoming block b + 1
+static void split_block(ioopm_sorted_array_t *sa, size_t b)
+{
+    block_t *block = sa->blocks[b];
+    block_t *second = malloc(sizeof(block_t));
+    size_t half = block->size / 2;
+    second->size = block->size - half;
+    memcpy(second->values, block->values + half, second->size * sizeof(elem_t));
+    block->size = half;
+
+    open_block_slot(sa, b + 1);
+    sa->blocks[b + 1] = second;
+    sa->starts[b + 1] = sa->starts[b] + half;
+}
+
+// Puts a value in its place in the blocks, in O(log n + Block_capacity + no_blocks) time
+static void insert_in_order(ioopm_sorted_array_t *sa, elem_t value)
+{
+    if(sa->no_blocks == 0)
+    {
+        open_block_slot(sa, 0);
+        sa->blocks[0] = malloc(sizeof(block_t));
+        sa->blocks[0]->size = 0;
+        sa->starts[0] = 0;
+    }
+
+    size_t b = find_block(sa, value);
+    b = b < sa->no_blocks ? b : sa->no_blocks - 1;     // after every value, so at the end of the last block
+    if(sa->blocks[b]->size == Block_capacity)
+    {
+        split_block(sa, b);
+        block_t *first = sa->blocks[b];
+        b += sa->cmp(first->values[first->size - 1], value) < 0 ? 1 : 0;
+    }
+
+    block_t *block = sa->blocks[b];
+    size_t index = block_lower_bound(sa, block, value);
+    memmove(block->values + index + 1, block->values + index, (block->size - index) * sizeof(elem_t));
+    block->values[index] = value;
+    block->size += 1;
+    shift_starts(sa, b + 1, 1);
+    sa->no_sorted += 1;
+}
+
+// Takes the value at index of block b out of the blocks, merging the block into a neighbour
+// once both fit in half a block, so blocks stay at least a quarter full on average
+static void remove_at(ioopm_sorted_array_t *sa, size_t b, size_t index)
+{
+    block_t *block = sa->blocks[b];
+    memmove(block->values + index, block->values + index + 1, (block->size - index - 1) * sizeof(elem_t));
+    block->size -= 1;
+    shift_starts(sa, b + 1, -1);
+    sa->no_sorted -= 1;
+
+    if(block->size == 0)
+    {
+        close_block_slot(sa, b);
+        return;
+    }
+    size_t first = b > 0 && sa->blocks[b - 1]->size + block->size <= Block_capacity / 2 ? b - 1 : b;
+    if(first + 1 < sa->no_blocks && sa->blocks[first]->size + sa->blocks[first + 1]->size <= Block_capacity / 2)
+    {
+        block_t *into = sa->blocks[first];
+        block_t *from = sa->blocks[first + 1];
+        memcpy(into->values + into->size, from->values, from->size * sizeof(elem_t));
+        into->size += from->size;
+        close_block_slot(sa, first + 1);
+    }
+}
+
+/*=================================================================
+ *  Sorting inserted values
+ *=================================================================*/
+
+// Sorts values[0, size) with scratch as room for the merges, leaving them in values
+static void merge_sort(elem_t *values, elem_t *scratch, size_t size, ioopm_cmp_function cmp)
+{
+    if(size < 2)
+    {
+        return;
+    }
+    size_t half = size / 2;
+    merge_sort(values, scratch, half, cmp);
+    merge_sort(values + half, scratch, size - half, cmp);
+
+    memcpy(scratch, values, half * sizeof(elem_t));
+    size_t i = 0, j = half, k = 0;
+    while(i < half && j < size)
+    {
+        values[k++] = cmp(values[j], scratch[i]) < 0 ? values[j++] : scratch[i++];
+    }
+    memcpy(values + k, scratch + i, (half - i) * sizeof(elem_t));   // what is left of values[j, size) is already in place
+}
+
+// Merges the values in the blocks with the sorted inserted values into new blocks, Block_fill to a block
+static void rebuild_blocks(ioopm_sorted_array_t *sa, elem_t *inserted, size_t no_inserted)
+{
+    size_t size = sa->no_sorted + no_inserted;
+    elem_t *merged = malloc(size * sizeof(elem_t));
+    size_t k = 0, j = 0;
+    for(size_t b = 0; b < sa->no_blocks; ++b)
+    {
+        block_t *block = sa->blocks[b];
+        for(size_t i = 0; i < block->size; ++i)
+        {
+            while(j < no_inserted && sa->cmp(inserted[j], block->values[i]) < 0)
+            {
+                merged[k++] = inserted[j++];
+            }
+            merged[k++] = block->values[i];
+        }
+        free(block);
+    }
+    memcpy(merged + k, inserted + j, (no_inserted - j) * sizeof(elem_t));
+
+    sa->no_blocks = 0;
+    for(size_t start = 0; start < size; start += Block_fill)
+    {
+        block_t *block = malloc(sizeof(block_t));
+        block->size = size - start < Block_fill ? size - start : Block_fill;
+        memcpy(block->values, merged + start, block->size * sizeof(elem_t));
+        open_block_slot(sa, sa->no_blocks);
+        sa->blocks[sa->no_blocks - 1] = block;
+        sa->starts[sa->no_blocks - 1] = start;
+    }
+    sa->no_sorted = size;
+    sa->last_block = 0;
+    free(merged);
+}
+
+// Puts the inserted values in order. A few are put in their places one by one, many (a bulk
+// load) are sorted and merged with the rest in O(n + m log m) for m inserted values. Putting a
+// value in place moves about Block_capacity + no_blocks values, each move a few times cheaper
+// than a comparison of the merge
+static void sort_inserted(ioopm_sorted_array_t *sa)
+{
+    size_t no_inserted = sa->no_inserted;
+    if(no_inserted == 0)
+    {
+        return;
+    }
+    sa->no_inserted = 0;
+
+    if(no_inserted * (Block_capacity + sa->no_blocks) <= sa->no_sorted * 4)
+    {
+        for(size_t i = 0; i < no_inserted; ++i)
+        {
+            insert_in_order(sa, sa->inserted[i]);
+        }
+        return;
+    }
+
+    elem_t *scratch = malloc((no_inserted / 2 + 1) * sizeof(elem_t));
+    merge_sort(sa->inserted, scratch, no_inserted, sa->cmp);
+    rebuild_blocks(sa, sa->inserted, no_inserted);
+    free(scratch);
+}
+
+/*=================================================================
+ *  Reading and removing
+ *=================================================================*/
+
+bool ioopm_sorted_array_remove(ioopm_sorted_array_t *sa, elem_t value)
+{
+    if(sa->no_inserted > Block_capacity)
+    {
+        sort_inserted(sa);  // cheaper than scanning them on every remove
+    }
+    size_t b = find_block(sa, value);
+    if(b < sa->no_blocks)
+    {
+        size_t index = block_lower_bound(sa, sa->blocks[b], value);
+        if(sa->cmp(sa->blocks[b]->values[index], value) == 0)
+        {
+            remove_at(sa, b, index);
+            return true;
+        }
+    }
+
+    size_t index;
+    for(index = 0; index < sa->no_inserted && sa->cmp(sa->inserted[index], value) != 0; ++index);
+    if(index == sa->no_inserted)
+    {
+        return false; // neither in order nor inserted since the array was last read
+    }
+    sa->inserted[index] = sa->inserted[--sa->no_inserted];    // the inserted values are in no order to keep
+    return true;
+}
+
+size_t ioopm_sorted_array_lower_bound(ioopm_sorted_array_t *sa, elem_t key)
+{
+    sort_inserted(sa);
+    size_t b = find_block(sa, key);
+    if(b == sa->no_blocks)
+    {
+        return sa->no_sorted;
+    }
+    return sa->starts[b] + block_lower_bound(sa, sa->blocks[b], key);
+}
+
+elem_t ioopm_sorted_array_get(ioopm_sorted_array_t *sa, size_t index)
+{
+    sort_inserted(sa);
+    size_t b = block_of_index(sa, index);
+    sa->last_block = b;
+    return sa->blocks[b]->values[index - sa->starts[b]];
+}
+
+size_t ioopm_sorted_array_size(ioopm_sorted_array_t *sa)
+{
+    return sa->no_sorted + sa->no_inserted;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "common.h"
+
+/**
+ * @file sorted_array.h
+ * @brief Array of values kept in order, searched by binary search.
+ *
+ * The values are kept in a list of ordered blocks of at most 512 values, a
+ * B+-tree of two levels. A value is put in or taken out of its block by binary
+ * search and a shift of that block only, so keeping the array in order as values
+ * come and go costs O(log n + 512 + n / 512), not a shift of the whole array.
+ *
+ * Inserted values are held apart until the array is next read. Then a few are
+ * put in their blocks one by one, and many (a bulk load) are sorted once and
+ * merged into new blocks. Values that compare equal are treated as the same value.
+ */
+
+typedef struct sorted_array ioopm_sorted_array_t;
+
+/// @brief Compares two values
+/// @return a negative number if a goes before b, 0 if they are equal and a positive number if a goes after b
+typedef int(*ioopm_cmp_function)(elem_t a, elem_t b);
+
+/// @brief Create a new, empty sorted array
+/// @param cmp the order of the values
+/// @return an empty sorted array
+ioopm_sorted_array_t *ioopm_sorted_array_create(ioopm_cmp_function cmp);
+
+/// @brief Delete a sorted array, free its memory (but not the memory of the values) and set its pointer to NULL
+/// @param sa double ref pointer to the sorted array to be deleted
+void ioopm_sorted_array_destroy(ioopm_sorted_array_t **sa);
+
+/// @brief Insert a value in amortized O(1) time. It is put in order when the array is next read
+/// @param sa the sorted array operated upon
+/// @param value the value to insert
+void ioopm_sorted_array_insert(ioopm_sorted_array_t *sa, elem_t value);
+
+/// @brief Remove a value in O(log n) time plus the shift of its block. Values inserted since the
+/// array was last read are scanned if there are at most 512 of them, else first put in order
+/// @param sa the sorted array operated upon
+/// @param value the value to remove
+/// @return true if the value was in the array, else false
+bool ioopm_sorted_array_remove(ioopm_sorted_array_t *sa, elem_t value);
+
+/// @brief Find where a key goes in O(log n) time, once inserted values are in order
+/// @param sa the sorted array operated upon
+/// @param key the key sought, compared to the values with the cmp function of the array
+/// @return the index of the first value not before key, or the size of the array if there is none
+size_t ioopm_sorted_array_lower_bound(ioopm_sorted_array_t *sa, elem_t key);
+
+/// @brief Get the value at an index in O(log n) time, or O(1) when reading in order, once inserted values are in order
+/// @param sa the sorted array operated upon
+/// @param index the index of the value, less than the size of the array
+/// @return the value
+elem_t ioopm_sorted_array_get(ioopm_sorted_array_t *sa, size_t index);
+
+/// @brief Lookup the number of values in O(1) time
+/// @param sa the sorted array operated upon
+/// @return the number of values
+size_t ioopm_sorted_array_size(ioopm_sorted_array_t *sa);
@@ -0,0 +1,77 @@
+#include <stdatomic.h>
+#include "spsc_queue.h"
+
+#define Cache_line_size 64
+
+struct spsc_queue
+{
+    elem_t *values;
+    size_t mask;                                            // capacity - 1
+    _Alignas(Cache_line_size) atomic_size_t head;           // next value to pop, moved by the consumer
+    size_t cached_tail;                                     // consumer's last view of tail
+    _Alignas(Cache_line_size) atomic_size_t tail;           // next slot to push to, moved by the producer
+    size_t cached_head;                                     // producer's last view of head
+};
+
+ioopm_spsc_queue_t *ioopm_spsc_queue_create(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    
+    ioopm_spsc_queue_t *queue = aligned_alloc(Cache_line_size, sizeof(ioopm_spsc_queue_t));
+    memset(queue, 0, sizeof(ioopm_spsc_queue_t));
+    queue->values = calloc(size, sizeof(elem_t));
+    queue->mask = size - 1;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    return queue;
+}
+
+void ioopm_spsc_queue_destroy(ioopm_spsc_queue_t **queue)
+{
+    free((*queue)->values);
+    free(*queue);
+    *queue = NULL;
+}
+
+bool ioopm_spsc_queue_push(ioopm_spsc_queue_t *queue, elem_t value)
+{
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    if (tail - queue->cached_head > queue->mask)
+    {
+        queue->cached_head = atomic_load_explicit(&queue->head, memory_order_acquire);
+        if (tail - queue->cached_head > queue->mask)
+        {
+            return false; // full
+        }
+    }
+    
+    queue->values[tail & queue->mask] = value;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);   // publishes the value
+    return true;
+}
+
+bool ioopm_spsc_queue_pop(ioopm_spsc_queue_t *queue, elem_t *result)
+{
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    if (head == queue->cached_tail)
+    {
+        queue->cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        if (head == queue->cached_tail)
+        {
+            return false; // empty
+        }
+    }
+    
+    *result = queue->values[head & queue->mask];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);   // hands the slot back
+    return true;
+}
+
+bool ioopm_spsc_queue_is_empty(ioopm_spsc_queue_t *queue)
+{
+    return atomic_load(&queue->head) == atomic_load(&queue->tail);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "common.h"
+
+/**
+ * @file spsc_queue.h
+ * @brief Bounded lock-free queue between one producer thread and one consumer thread.
+ *
+ * The values live in a ring whose size is a power of two. Only the producer moves
+ * the tail and only the consumer moves the head, so pushing and popping take no
+ * locks and never wait for the other thread. The head and the tail are kept on
+ * separate cache lines, so the two threads do not slow each other down.
+ */
+
+typedef struct spsc_queue ioopm_spsc_queue_t;
+
+/// @brief Create a new, empty queue
+/// @param capacity the most values the queue can hold, rounded up to a power of two
+/// @return an empty queue
+ioopm_spsc_queue_t *ioopm_spsc_queue_create(size_t capacity);
+
+/// @brief Delete a queue, free its memory (but not the memory of the values) and set its pointer to NULL
+/// @param queue double ref pointer to the queue to be deleted
+void ioopm_spsc_queue_destroy(ioopm_spsc_queue_t **queue);
+
+/// @brief Add a value at the back of the queue. Only called by the producer thread
+/// @param queue the queue operated upon
+/// @param value the value to add
+/// @return true if the value was added, false if the queue is full
+bool ioopm_spsc_queue_push(ioopm_spsc_queue_t *queue, elem_t value);
+
+/// @brief Take the value at the front of the queue. Only called by the consumer thread
+/// @param queue the queue operated upon
+/// @param result pointer to an elem_t for storing the value
+/// @return true if a value was taken, false if the queue is empty
+bool ioopm_spsc_queue_pop(ioopm_spsc_queue_t *queue, elem_t *result);
+
+/// @brief Check if the queue is empty. May be called by either thread
+/// @param queue the queue operated upon
+/// @return true if the queue held no values when it was checked
+bool ioopm_spsc_queue_is_empty(ioopm_spsc_queue_t *queue);
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include "string_pool.h"
+
+#define Default_no_buckets 64
+
+typedef struct interned interned_t;
+
+struct interned
+{
+    interned_t *next;       // next string in the same bucket (possibly NULL)
+    int hash;               // always positive, so it can be used as a hash table hash
+    int refs;               // number of references handed out
+    char str[];
+};
+
+struct string_pool
+{
+    interned_t **buckets;
+    size_t no_buckets;
+    size_t size;
+};
+
+static int string_hash(char *str)
+{
+    unsigned long result = 0;
+    for(; *str != '\0'; ++str)
+    {
+        result = result * 31 + *str;
+    }
+    result = result % INT_MAX;
+    return result == 0 ? 1 : (int) result;
+}
+
+static interned_t *interned_header(char *str)
+{
+    return (interned_t *) (str - offsetof(interned_t, str));
+}
+
+ioopm_string_pool_t *ioopm_string_pool_create()
+{
+    ioopm_string_pool_t *pool = calloc(1, sizeof(ioopm_string_pool_t));
+    pool->buckets = calloc(Default_no_buckets, sizeof(interned_t *));
+    pool->no_buckets = Default_no_buckets;
+    return pool;
+}
+
+void ioopm_string_pool_destroy(ioopm_string_pool_t **pool)
+{
+    for(size_t i = 0; i < (*pool)->no_buckets; ++i)
+    {
+        interned_t *current = (*pool)->buckets[i];
+        while(current)
+        {
+            interned_t *next = current->next;
+            free(current);
+            current = next;
+        }
+    }
+    free((*pool)->buckets);
+    free(*pool);
+    *pool = NULL;
+}
+
+static void string_pool_grow(ioopm_string_pool_t *pool)
+{
+    size_t new_size = pool->no_buckets * 2;
+    interned_t **new_buckets = calloc(new_size, sizeof(interned_t *));
+    
+    for(size_t i = 0; i < pool->no_buckets; ++i)
+    {
+        interned_t *current = pool->buckets[i];
+        while(current)
+        {
+            interned_t *next = current->next;
+            size_t bucket = current->hash % new_size;
+            current->next = new_buckets[bucket];
+            new_buckets[bucket] = current;
+            current = next;
+        }
+    }
+    
+    free(pool->buckets);
+    pool->buckets = new_buckets;
+    pool->no_buckets = new_size;
+}
+
+static interned_t *find_interned(ioopm_string_pool_t *pool, char *str, int hash)
+{
+    interned_t *current = pool->buckets[hash % pool->no_buckets];
+    while(current)
+    {
+        if(current->hash == hash && strcmp(current->str, str) == 0)
+        {
+            return current;
+        }
+        current = current->next;
+    }
+    return NULL;
+}
+
+char *ioopm_string_pool_intern(ioopm_string_pool_t *pool, char *str)
+{
+    return ioopm_string_pool_intern_hashed(pool, str, string_hash(str));
+}
+
+char *ioopm_string_pool_intern_hashed(ioopm_string_pool_t *pool, char *str, int hash)
+{
+    interned_t *found = find_interned(pool, str, hash);
+    
+    if(found == NULL)
+    {
+        if(pool->size >= pool->no_buckets)
+        {
+            string_pool_grow(pool);
+        }
+        
+        size_t length = strlen(str);
+        found = malloc(sizeof(interned_t) + length + 1);
+        memcpy(found->str, str, length + 1);
+        found->hash = hash;
+        found->refs = 0;
+        
+        size_t bucket = hash % pool->no_buckets;
+        found->next = pool->buckets[bucket];
+        pool->buckets[bucket] = found;
+        pool->size += 1;
+    }
+    
+    found->refs += 1;
+    return found->str;
+}
+
+char *ioopm_string_pool_retain(char *interned)
+{
+    interned_header(interned)->refs += 1;
+    return interned;
+}
+
+char *ioopm_string_pool_lookup(ioopm_string_pool_t *pool, char *str)
+{
+    interned_t *found = find_interned(pool, str, string_hash(str));
+    return found ? found->str : NULL;
+}
+
+void ioopm_string_pool_release(ioopm_string_pool_t *pool, char *interned)
+{
+    interned_t *entry = interned_header(interned);
+    entry->refs -= 1;
+    if(entry->refs > 0)
+    {
+        return;
+    }
+    
+    interned_t **cursor = &pool->buckets[entry->hash % pool->no_buckets];
+    while(*cursor != entry)
+    {
+        cursor = &(*cursor)->next;
+    }
+    *cursor = entry->next;
+    pool->size -= 1;
+    free(entry);
+}
+
+size_t ioopm_string_pool_size(ioopm_string_pool_t *pool)
+{
+    return pool->size;
+}
+
+bool ioopm_interned_eq(elem_t a, elem_t b)
+{
+    return a.str_val == b.str_val;
+}
+
+int ioopm_interned_hash(elem_t key)
+{
+    return interned_header(key.str_val)->hash;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "common.h"
+
+/**
+ * @file string_pool.h
+ * @brief Interning pool that keeps one canonical copy of every string.
+ *
+ * Strings handed out by the pool can be compared with == and carry their
+ * hash, so hash tables keyed by them never have to look at the characters.
+ * Every ioopm_string_pool_intern must be matched by a ioopm_string_pool_release.
+ */
+
+typedef struct string_pool ioopm_string_pool_t;
+
+/// @brief Create a new, empty string pool
+/// @return an empty string pool
+ioopm_string_pool_t *ioopm_string_pool_create();
+
+/// @brief Delete a string pool, free all strings still in it and set its pointer to NULL
+/// @param pool double ref pointer to the pool to be deleted
+void ioopm_string_pool_destroy(ioopm_string_pool_t **pool);
+
+/// @brief Get the canonical copy of str, copying it into the pool if it is not there yet.
+/// Each call takes a new reference to the canonical string.
+/// @param pool the pool operated upon
+/// @param str the string to intern, which is not kept by the pool
+/// @return the canonical copy of str
+char *ioopm_string_pool_intern(ioopm_string_pool_t *pool, char *str);
+
+/// @brief Like ioopm_string_pool_intern, for a string whose hash is already known
+/// @param pool the pool operated upon
+/// @param str the string to intern, which is not kept by the pool
+/// @param hash the hash of str, as returned by ioopm_interned_hash for an earlier canonical copy
+/// @return the canonical copy of str
+char *ioopm_string_pool_intern_hashed(ioopm_string_pool_t *pool, char *str, int hash);
+
+/// @brief Take another reference to a string that is already canonical, in O(1) time
+/// @param interned a string returned by ioopm_string_pool_intern
+/// @return interned
+char *ioopm_string_pool_retain(char *interned);
+
+/// @brief Find the canonical copy of str without taking a reference
+/// @param pool the pool operated upon
+/// @param str the string sought
+/// @return the canonical copy of str, or NULL if str is not in the pool
+char *ioopm_string_pool_lookup(ioopm_string_pool_t *pool, char *str);
+
+/// @brief Drop a reference to a canonical string, freeing it when no references are left
+/// @param pool the pool operated upon
+/// @param interned a string returned by ioopm_string_pool_intern
+void ioopm_string_pool_release(ioopm_string_pool_t *pool, char *interned);
+
+/// @brief Lookup the number of distinct strings in the pool in O(1) time
+/// @param pool the pool operated upon
+/// @return the number of distinct strings in the pool
+size_t ioopm_string_pool_size(ioopm_string_pool_t *pool);
+
+/// @brief Key equality for hash tables keyed by canonical strings, a pointer comparison
+bool ioopm_interned_eq(elem_t a, elem_t b);
+
+/// @brief Hash function for hash tables keyed by canonical strings, returns the stored hash
+int ioopm_interned_hash(elem_t key);
@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timer_wheel.h"
+
+#define Default_capacity 16
+#define Level_bits  6
+#define No_slots    (1 << Level_bits)
+#define No_levels   4
+#define Reach       ((uint64_t) 1 << (Level_bits * No_levels))     // Timers further away than this wait in the last slot
+#define Due_list    (No_levels * No_slots)                          // List of the timers that have expired
+#define No_lists    (Due_list + 1)
+#define None        -1
+
+typedef struct timer wheel_timer_t;
+
+struct timer
+{
+    uint64_t deadline;
+    elem_t value;
+    int list;           // The list the timer is in, level * No_slots + slot or Due_list, None if the timer is free
+    int prev;
+    int next;           // Next timer in the list, or the next free timer if the timer is free
+};
+
+struct timer_wheel
+{
+    uint64_t now;
+    wheel_timer_t *timers;
+    int no_timers;
+    int capacity;
+    int free_timer;     // first free timer, or None
+    int heads[No_lists];
+    size_t level_sizes[No_levels];
+    size_t size;
+};
+
+ioopm_timer_wheel_t *ioopm_timer_wheel_create(uint64_t now)
+{
+    ioopm_timer_wheel_t *wheel = calloc(1, sizeof(ioopm_timer_wheel_t));
+    wheel->now = now;
+    wheel->capacity = Default_capacity;
+    wheel->timers = calloc(wheel->capacity, sizeof(wheel_timer_t));
+    wheel->free_timer = None;
+    for(int i = 0; i < No_lists; ++i)
+    {
+        wheel->heads[i] = None;
+    }
+    return wheel;
+}
+
+void ioopm_timer_wheel_destroy(ioopm_timer_wheel_t **wheel)
+{
+    free((*wheel)->timers);
+    free(*wheel);
+    *wheel = NULL;
+}
+
+static void push(ioopm_timer_wheel_t *wheel, int list, int handle)
+{
+    wheel_timer_t *timer = &wheel->timers[handle];
+    timer->list = list;
+    timer->prev = None;
+    timer->next = wheel->heads[list];
+    if(timer->next != None)
+    {
+        wheel->timers[timer->next].prev = handle;
+    }
+    wheel->heads[list] = handle;
+    if(list != Due_list)
+    {
+        wheel->level_sizes[list / No_slots] += 1;
+    }
+}
+
+static void unlink_timer(ioopm_timer_wheel_t *wheel, int handle)
+{
+    wheel_timer_t *timer = &wheel->timers[handle];
+    if(timer->prev != None)
+    {
+        wheel->timers[timer->prev].next = timer->next;
+    }
+    else
+    {
+        wheel->heads[timer->list] = timer->next;
+    }
+    if(timer->next != None)
+    {
+        wheel->timers[timer->next].prev = timer->prev;
+    }
+    if(timer->list != Due_list)
+    {
+        wheel->level_sizes[timer->list / No_slots] -= 1;
+    }
+}
+
+// Puts a timer in the slot its deadline falls in, on the lowest level that reaches that far
+static void place(ioopm_timer_wheel_t *wheel, int handle)
+{
+    uint64_t deadline = wheel->timers[handle].deadline;
+    if(deadline <= wheel->now)
+    {
+        push(wheel, Due_list, handle);
+        return;
+    }
+    if(deadline - wheel->now >= Reach)
+    {
+        deadline = wheel->now + Reach - 1;  // Placed again once the wheel gets there
+    }
+
+    int level = 0;
+    while((deadline - wheel->now) >> (Level_bits * (level + 1)) != 0)
+    {
+        ++level;
+    }
+    int slot = (deadline >> (Level_bits * level)) & (No_slots - 1);
+    push(wheel, level * No_slots + slot, handle);
+}
+
+int ioopm_timer_wheel_schedule(ioopm_timer_wheel_t *wheel, uint64_t deadline, elem_t value)
+{
+    int handle = wheel->free_timer;
+    if(handle != None)
+    {
+        wheel->free_timer = wheel->timers[handle].next;
+    }
+    else
+    {
+        if(wheel->no_timers == wheel->capacity)
+        {
+            wheel->capacity *= 2;
+            wheel->timers = realloc(wheel->timers, wheel->capacity * sizeof(wheel_timer_t));
+        }
+        handle = wheel->no_timers++;
+    }
+
+    wheel->timers[handle].deadline = deadline;
+    wheel->timers[handle].value = value;
+    place(wheel, handle);
+    wheel->size += 1;
+    return handle;
+}
+
+static void free_timer(ioopm_timer_wheel_t *wheel, int handle)
+{
+    wheel->timers[handle].list = None;
+    wheel->timers[handle].next = wheel->free_timer;
+    wheel->free_timer = handle;
+    wheel->size -= 1;
+}
+
+elem_t ioopm_timer_wheel_cancel(ioopm_timer_wheel_t *wheel, int handle)
+{
+    elem_t value = wheel->timers[handle].value;
+    unlink_timer(wheel, handle);
+    free_timer(wheel, handle);
+    return value;
+}
+
+// Empties a slot and places its timers again, now that the wheel has moved on
+static void cascade(ioopm_timer_wheel_t *wheel, int level, int slot)
+{
+    int list = level * No_slots + slot;
+    int handle = wheel->heads[list];
+    wheel->heads[list] = None;
+    while(handle != None)
+    {
+        int next = wheel->timers[handle].next;
+        wheel->level_sizes[level] -= 1;
+        place(wheel, handle);
+        handle = next;
+    }
+}
+
+// Moves the wheel one tick forward
+static void tick(ioopm_timer_wheel_t *wheel)
+{
+    wheel->now += 1;
+    for(int level = 1; level < No_levels; ++level)
+    {
+        if((wheel->now & ((1 << (Level_bits * level)) - 1)) != 0)
+        {
+            break; // The slot of this level and those above did not change
+        }
+        cascade(wheel, level, (wheel->now >> (Level_bits * level)) & (No_slots - 1));
+    }
+    cascade(wheel, 0, wheel->now & (No_slots - 1));    // Its deadline is now, so every timer goes to Due_list
+}
+
+static void advance_to(ioopm_timer_wheel_t *wheel, uint64_t now)
+{
+    while(wheel->now < now)
+    {
+        int level = 0;
+        while(level < No_levels && wheel->level_sizes[level] == 0)
+        {
+            ++level;
+        }
+        if(level == No_levels)
+        {
+            wheel->now = now;   // Nothing is scheduled, no tick in between matters
+            return;
+        }
+        if(level > 0)
+        {
+            // The levels below are empty, so nothing happens before the next slot of this level
+            uint64_t next_slot = ((wheel->now >> (Level_bits * level)) + 1) << (Level_bits * level);
+            if(next_slot > now)
+            {
+                wheel->now = now;
+                return;
+            }
+            wheel->now = next_slot - 1;
+        }
+        tick(wheel);
+    }
+}
+
+size_t ioopm_timer_wheel_advance(ioopm_timer_wheel_t *wheel, uint64_t now, elem_t *expired, size_t max_expired)
+{
+    advance_to(wheel, now);
+
+    size_t no_expired = 0;
+    while(no_expired < max_expired && wheel->heads[Due_list] != None)
+    {
+        int handle = wheel->heads[Due_list];
+        expired[no_expired++] = ioopm_timer_wheel_cancel(wheel, handle);
+    }
+    return no_expired;
+}
+
+size_t ioopm_timer_wheel_size(ioopm_timer_wheel_t *wheel)
+{
+    return wheel->size;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "common.h"
+#include <stdint.h>
+
+/**
+ * @file timer_wheel.h
+ * @brief Hierarchical timer wheel of values with deadlines in ticks.
+ *
+ * The wheel has 4 levels of 64 slots. Level 0 holds the timers due in the
+ * next 64 ticks, one slot per tick, level 1 those due in the next 64 * 64
+ * ticks, one slot per 64 ticks, and so on. Each time the wheel enters a new
+ * slot of a level its timers are spread over the levels below, so a timer is
+ * moved at most 4 times before it expires. Scheduling and cancelling take
+ * O(1) time, and advancing takes O(1) amortized time per tick and timer, but
+ * stretches of ticks with nothing due are skipped. Timers further away than
+ * the wheel reaches wait in its last slot and are placed again when it is
+ * entered.
+ */
+
+typedef struct timer_wheel ioopm_timer_wheel_t;
+
+/// @brief Create a new, empty timer wheel
+/// @param now the current tick
+/// @return an empty timer wheel
+ioopm_timer_wheel_t *ioopm_timer_wheel_create(uint64_t now);
+
+/// @brief Delete a timer wheel, free its memory (but not the memory of the values) and set its pointer to NULL
+/// @param wheel double ref pointer to the timer wheel to be deleted
+void ioopm_timer_wheel_destroy(ioopm_timer_wheel_t **wheel);
+
+/// @brief Schedule a value to expire at a deadline in O(1) time
+/// @param wheel the timer wheel operated upon
+/// @param deadline the tick the value expires at, a deadline that has passed expires at the next advance
+/// @param value the value to expire
+/// @return the handle of the timer, valid until the value is handed out by ioopm_timer_wheel_advance or cancelled
+int ioopm_timer_wheel_schedule(ioopm_timer_wheel_t *wheel, uint64_t deadline, elem_t value);
+
+/// @brief Cancel a timer in O(1) time. Its handle may be given to a later schedule
+/// @param wheel the timer wheel operated upon
+/// @param handle the handle of the timer, as returned by ioopm_timer_wheel_schedule
+/// @return the value of the timer
+elem_t ioopm_timer_wheel_cancel(ioopm_timer_wheel_t *wheel, int handle);
+
+/// @brief Move the wheel forward to a tick and hand out the values that have expired, at most
+/// max_expired at a time. Values that do not fit are kept for the next call, which may use the same now
+/// @param wheel the timer wheel operated upon
+/// @param now the current tick, ticks before the wheel's current tick are ignored
+/// @param expired set to the values that have expired, in no particular order
+/// @param max_expired the most values to hand out
+/// @return the number of values handed out, max_expired if there may be more
+size_t ioopm_timer_wheel_advance(ioopm_timer_wheel_t *wheel, uint64_t now, elem_t *expired, size_t max_expired);
+
+/// @brief Lookup the number of timers in O(1) time, expired ones not yet handed out included
+/// @param wheel the timer wheel operated upon
+/// @return the number of timers
+size_t ioopm_timer_wheel_size(ioopm_timer_wheel_t *wheel);
@@ -0,0 +1,170 @@
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "trace.h"
+
+#define Ring_size (1 << 16)    // Spans kept per thread, a power of two
+
+typedef struct span span_t;
+typedef struct ring ring_t;
+
+struct span
+{
+    const char *name;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    int detail;
+    int tid;
+};
+
+struct ring
+{
+    span_t spans[Ring_size];
+    atomic_size_t written;      // spans ever written to the ring, the next one goes in spans[written % Ring_size]
+    atomic_bool in_use;         // a live thread writes to the ring
+    ring_t *next;               // next ring in rings
+};
+
+atomic_bool ioopm_trace_enabled = false;
+
+static _Atomic(ring_t *) rings = NULL;     // every ring, new ones are pushed at the front and none are removed
+static _Thread_local ring_t *own_ring = NULL;
+static _Thread_local int own_tid;
+static pthread_key_t ring_key;             // hands the ring back when its thread exits
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+void ioopm_trace_enable(bool enabled)
+{
+    atomic_store(&ioopm_trace_enabled, enabled);
+}
+
+uint64_t ioopm_trace_clock()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*=================================================================
+ *  Rings
+ *=================================================================*/
+
+static void release_ring(void *ring)
+{
+    atomic_store(&((ring_t *) ring)->in_use, false);
+}
+
+static void create_ring_key()
+{
+    pthread_key_create(&ring_key, release_ring);
+}
+
+// Takes a ring a thread that has exited left behind, or adds a new one
+static ring_t *claim_ring()
+{
+    pthread_once(&ring_key_once, create_ring_key);
+    ring_t *ring;
+    for(ring = atomic_load(&rings); ring != NULL; ring = ring->next)
+    {
+        bool free = false;
+        if(atomic_compare_exchange_strong(&ring->in_use, &free, true))
+        {
+            break;
+        }
+    }
+    if(ring == NULL)
+    {
+        ring = calloc(1, sizeof(ring_t));
+        atomic_init(&ring->written, 0);
+        atomic_init(&ring->in_use, true);
+        ring->next = atomic_load(&rings);
+        while(!atomic_compare_exchange_weak(&rings, &ring->next, ring))
+        {
+        }
+    }
+    pthread_setspecific(ring_key, ring);
+    own_tid = (int) syscall(SYS_gettid);
+    return ring;
+}
+
+void ioopm_trace_record(const char *name, uint64_t start_ns, int detail)
+{
+    uint64_t end_ns = ioopm_trace_clock();
+    if(own_ring == NULL)
+    {
+        own_ring = claim_ring();
+    }
+
+    // Only this thread writes to the ring, so the slot is filled first and published after
+    size_t written = atomic_load_explicit(&own_ring->written, memory_order_relaxed);
+    span_t *span = &own_ring->spans[written & (Ring_size - 1)];
+    span->name = name;
+    span->start_ns = start_ns;
+    span->duration_ns = end_ns - start_ns;
+    span->detail = detail;
+    span->tid = own_tid;
+    atomic_store_explicit(&own_ring->written, written + 1, memory_order_release);
+}
+
+/*=================================================================
+ *  Export
+ *=================================================================*/
+
+// Copies the spans of a ring to copy and returns how many there are. Spans the writer may
+// have overwritten while they were copied, which it counted before it started on them, are dropped
+static size_t copy_ring(ring_t *ring, span_t *copy)
+{
+    size_t end = atomic_load_explicit(&ring->written, memory_order_acquire);
+    size_t start = end > Ring_size ? end - Ring_size : 0;
+    for(size_t i = start; i < end; ++i)
+    {
+        copy[i - start] = ring->spans[i & (Ring_size - 1)];
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+    size_t written = atomic_load_explicit(&ring->written, memory_order_relaxed);
+    size_t first_intact = written >= Ring_size ? written - Ring_size + 1 : 0;
+    if(first_intact <= start)
+    {
+        return end - start;
+    }
+    if(first_intact >= end)
+    {
+        return 0;
+    }
+    memmove(copy, copy + (first_intact - start), (end - first_intact) * sizeof(span_t));
+    return end - first_intact;
+}
+
+size_t ioopm_trace_export(FILE *out)
+{
+    span_t *copy = malloc(Ring_size * sizeof(span_t));
+    int pid = (int) getpid();
+    size_t no_spans = 0;
+
+    fprintf(out, "{\"traceEvents\": [");
+    for(ring_t *ring = atomic_load(&rings); ring != NULL; ring = ring->next)
+    {
+        size_t no_copied = copy_ring(ring, copy);
+        for(size_t i = 0; i < no_copied; ++i)
+        {
+            // Times are in us, complete ("X") events nest by time within a thread
+            fprintf(out, "%s\n{\"name\": \"%s\", \"cat\": \"ioopm\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, "
+                    "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"detail\": %d}}", no_spans > 0 ? "," : "",
+                    copy[i].name, pid, copy[i].tid, copy[i].start_ns / 1e3, copy[i].duration_ns / 1e3, copy[i].detail);
+            no_spans += 1;
+        }
+    }
+    fprintf(out, "\n], \"displayTimeUnit\": \"ns\"}\n");
+    free(copy);
+    return no_spans;
+}
+
+void ioopm_trace_clear()
+{
+    for(ring_t *ring = atomic_load(&rings); ring != NULL; ring = ring->next)
+    {
+        atomic_store(&ring->written, 0);
+    }
+}
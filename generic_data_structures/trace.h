@@ -0,0 +1,71 @@
+#pragma once
+#include "common.h"
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**
+ * @file trace.h
+ * @brief Timed spans of code, exported as Chrome trace events.
+ *
+ * A span records its name, start, duration, thread and one int of detail, e.g.
+ * how many entries a chain walk passed. Each thread writes its spans to a ring
+ * buffer of its own, without locks, and the oldest spans are overwritten once it
+ * is full. The rings are kept after their thread exits and handed to the next
+ * new thread. The export loads in chrome://tracing and Perfetto.
+ *
+ * Tracing starts off. While it is off a span costs one load of
+ * ioopm_trace_enabled and a branch that is always predicted right:
+ *
+ *     uint64_t trace_start = ioopm_trace_begin();
+ *     ...
+ *     ioopm_trace_end("name", trace_start, detail);
+ */
+
+/// Whether spans are recorded, set by ioopm_trace_enable
+extern atomic_bool ioopm_trace_enabled;
+
+/// @brief Turn recording of spans on or off
+/// @param enabled true to record spans
+void ioopm_trace_enable(bool enabled);
+
+/// @brief Read the clock spans are timed with
+/// @return monotonic ns
+uint64_t ioopm_trace_clock();
+
+/// @brief Record a span that ends now in the ring of the calling thread
+/// @param name the name of the span, a string that outlives the export
+/// @param start_ns when the span started, from ioopm_trace_clock
+/// @param detail shown as the argument of the span
+void ioopm_trace_record(const char *name, uint64_t start_ns, int detail);
+
+/// @brief Start a span
+/// @return the start of the span, or 0 if tracing is off
+static inline uint64_t ioopm_trace_begin()
+{
+    if(__builtin_expect(atomic_load_explicit(&ioopm_trace_enabled, memory_order_relaxed), 0))
+    {
+        return ioopm_trace_clock();
+    }
+    return 0;
+}
+
+/// @brief End a span started by ioopm_trace_begin, nothing is recorded if tracing was off at its start
+/// @param name the name of the span, a string that outlives the export
+/// @param start_ns what ioopm_trace_begin returned
+/// @param detail shown as the argument of the span
+static inline void ioopm_trace_end(const char *name, uint64_t start_ns, int detail)
+{
+    if(__builtin_expect(start_ns != 0, 0))
+    {
+        ioopm_trace_record(name, start_ns, detail);
+    }
+}
+
+/// @brief Write the spans in the rings of all threads as Chrome trace event JSON. May be called
+/// while other threads record spans, those they overwrite during the export are left out
+/// @param out the stream to write to
+/// @return the number of spans written
+size_t ioopm_trace_export(FILE *out);
+
+/// @brief Forget all recorded spans. Only called while no thread records spans
+void ioopm_trace_clear();
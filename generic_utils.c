@@ -1,5 +1,11 @@
 #include "headers/generic_utils.h"
 
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#define Default_block_size (64 << 10)
+
 union answer
 {
     int i;
@@ -7,6 +13,19 @@ union answer
     char* s;
 };
 
+//Lines are handed out where they lie in buf, with their '\n' overwritten by '\0'. Only a line
+//that runs past the end of buf is moved, to the start of it, and buf only grows if a line
+//does not fit in it.
+struct line_reader
+{
+    int     fd;
+    char    *buf;
+    size_t  capacity;   //One byte is always kept free, for the '\0' after a last line without '\n'
+    size_t  start;      //Start of the bytes not yet handed out
+    size_t  end;        //End of the bytes read
+    bool    at_eof;
+};
+
 
 bool is_digit(char c)
 {
@@ -31,7 +50,7 @@ bool is_number(char *str)
     {   
         for(int i = 0; i < str_length; i++)
         {   
-            
+        
             if(!(is_digit(str[i])))
             {   
                 return false;
@@ -46,55 +65,181 @@ bool not_empty(char *str)
     return strlen(str) > 0;
 }
 
-void clear_input_buffer()
+bool parse_int(char *str, int *value)
 {
-    int c;
-    do
+    if(str == NULL)
+    {
+        return false;
+    }
+    bool negative = *str == '-';
+    str += negative;
+    if(*str == '\0')
     {
-        c = getchar();
+        return false;
     }
-    while(c != '\n' && c != EOF);
+    
+    unsigned int limit = negative ? (unsigned int) INT_MAX + 1 : INT_MAX;
+    unsigned int magnitude = 0;
+    for(; *str != '\0'; ++str)
+    {
+        unsigned int digit = (unsigned char) *str - '0';
+        if(digit > 9 || magnitude > (limit - digit) / 10)
+        {
+            return false;
+        }
+        magnitude = magnitude * 10 + digit;
+    }
+    *value = negative ? -(int) (magnitude - 1) - 1 : (int) magnitude;    //INT_MIN has no positive int
+    return true;
+}
+
+void clear_input_buffer()
+{
+    size_t length;
+    read_line(stdin_reader(), &length);
 }
 
 int read_string(char *buf, int buf_siz)
 {
-    int i = 0;
-    for(; i < buf_siz-1; ++i)
+    size_t length;
+    char *line = read_line(stdin_reader(), &length);
+    if(line == NULL)
     {
-        int c;
-        c = getchar();
-        buf[i] = c;
+        buf[0] = '\0';
+        return 0;
+    }
+    if(length > (size_t) buf_siz - 1)
+    {
+        length = buf_siz - 1;   //The rest of a line that does not fit is dropped
+    }
+    memcpy(buf, line, length);
+    buf[length] = '\0';
+    return length;
+}
+
+line_reader_t *line_reader_create(int fd, size_t block_size)
+{
+    line_reader_t *reader = calloc(1, sizeof(line_reader_t));
+    reader->fd          = fd;
+    reader->capacity    = (block_size > 0 ? block_size : Default_block_size) + 1;
+    reader->buf         = malloc(reader->capacity);
+    return reader;
+}
+
+void line_reader_destroy(line_reader_t *reader)
+{
+    free(reader->buf);
+    free(reader);
+}
+
+char *read_line(line_reader_t *reader, size_t *length)
+{
+    size_t scanned = reader->start;     //There is no '\n' between start and scanned
+    while(true)
+    {
+        char *line = reader->buf + reader->start;
+        char *newline = memchr(reader->buf + scanned, '\n', reader->end - scanned);
+        if(newline != NULL || (reader->at_eof && reader->start < reader->end))
+        {
+            char *line_end = newline ? newline : reader->buf + reader->end;
+            reader->start = line_end - reader->buf + (newline ? 1 : 0);
+            if(line_end > line && line_end[-1] == '\r')
+            {
+                --line_end;
+            }
+            *line_end = '\0';
+            *length = line_end - line;
+            return line;
+        }
+        if(reader->at_eof)
+        {
+            return NULL;
+        }
+        
+        scanned = reader->end;
+        if(reader->end == reader->capacity - 1)
+        {
+            if(reader->start > 0)
+            {
+                memmove(reader->buf, line, reader->end - reader->start);    //Move the start of the line to the front
+                reader->end -= reader->start;
+                scanned     -= reader->start;
+                reader->start = 0;
+            }
+            else
+            {
+                reader->capacity *= 2;  //The line is longer than the buffer
+                reader->buf = realloc(reader->buf, reader->capacity);
+            }
+        }
         
-        if(buf[i] == '\n' || buf[i] == EOF)
+        ssize_t received = read(reader->fd, reader->buf + reader->end, reader->capacity - 1 - reader->end);
+        if(received > 0)
+        {
+            reader->end += received;
+        }
+        else if(received == 0 || errno != EINTR)
         {
-            buf[i] = '\0';
-            return i;
+            reader->at_eof = true;
         }
     }
-    clear_input_buffer();
-    buf[i] = '\0';
-    return i;
+}
+
+line_reader_t *stdin_reader()
+{
+    static line_reader_t *reader = NULL;
+    if(reader == NULL)
+    {
+        reader = line_reader_create(STDIN_FILENO, 0);
+    }
+    return reader;
+}
+
+//Asks question until a non-empty line is given, which is valid until the next question
+static char *ask_line(char *question, size_t *length)
+{
+    char *line;
+    do
+    {
+        printf("%s\n", question);
+        fflush(stdout);     //Reading with read() does not flush stdout the way stdio does
+        line = read_line(stdin_reader(), length);
+        if(line == NULL)
+        {
+            exit(EXIT_SUCCESS); //No answer will ever come
+        }
+    }while(*length == 0);
+    
+    return line;
 }
 
 answer_t ask_question(char *question, check_func check, convert_func convert)
 {
-    int res = 0;
-    int buf_siz = 255;
-    char buf[buf_siz];
+    size_t length;
+    char *answer;
     
     do
     {
-        printf("%s\n", question);
-        res = read_string(buf, buf_siz);
-        
-    }while(res == 0 || !(check(buf))); //Denna körs tills att res inte är lika med noll, alltså inte en tom sträng och eller om den givna strängen inte är vad som förväntas.
+        answer = ask_line(question, &length);
+    
+    }while(!(check(answer))); //Denna körs tills att den givna strängen är vad som förväntas.
     
-    return convert(buf);
+    return convert(answer);
 }
 
 int ask_question_int(char *question)
 {
-    return ask_question(question, is_number, (convert_func) atoi).i;
+    size_t length;
+    char *line;
+    int answer;
+    
+    do
+    {
+        line = ask_line(question, &length);
+    
+    }while(!parse_int(line, &answer));
+    
+    return answer;
 }
 
 char *ask_question_string(char *question)
@@ -102,6 +247,13 @@ char *ask_question_string(char *question)
     return ask_question(question, not_empty, (convert_func) strdup).s;
 }
 
+char *ask_question_string_in(ioopm_arena_t *arena, char *question)
+{
+    size_t length;
+    char *answer = ask_line(question, &length);
+    return ioopm_arena_strndup(arena, answer, length);
+}
+
 
 char *trim(char *str)
 {
@@ -110,7 +262,7 @@ char *trim(char *str)
     
     while(isspace(*start))  ++start;        //Flyttar på start tills det inte längre finns "skräp"
     while(isspace(*end))      --end;        //-----------------------||---------------------------
-
+    
     char *cursor = str;                     //Cursor pekar på str nu, som kan ha krympt
     for(; start <= end; ++start, ++cursor)  //När start ligger på samma adress som end, slutar for. låt start och cursor hoppa ett steg vid varje iteration
     {
@@ -120,3 +272,22 @@ char *trim(char *str)
     
     return str;                             //Str som nu är ändrat skickas tillbaka
 }
+
+char *read_file(char *path, size_t *length)
+{
+    FILE *file = fopen(path, "rb");
+    if(file == NULL)
+    {
+        return NULL;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    *length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    
+    char *buf = malloc(*length + 1);
+    *length = fread(buf, 1, *length, file);
+    buf[*length] = '\0';
+    fclose(file);
+    return buf;
+}
@@ -6,28 +6,206 @@ typedef struct webstore_db db_t;
 
 db_t *create_webstore();
 
+void destroy_webstore(db_t *webstore);
+
+///@brief adds a new merch to the store. The name is copied into the store, the description is taken over by it
 bool bl_add_merchandise(db_t *db, char *merch_name, char *merch_desc, int price);
 
 void bl_list_merchandise(db_t *db);
 
+///@brief finds the merch whose names start with prefix, in alphabetical order, in O(log n + max_names) time
+///@param names set to the names found. They belong to the store and stay valid until the merch is removed or renamed
+///@param max_names the most names to find
+///@returns the number of names found
+size_t bl_find_merch_by_prefix(db_t *db, char *prefix, char **names, size_t max_names);
+
+///@brief finds the merch priced from min_price to max_price, cheapest first and by name among equal prices,
+///in O(log n + max_names) time
+///@param skip the number of merch in the range to skip, to page through a long range
+///@param names set to the names found. They belong to the store and stay valid until the merch is removed or renamed
+///@param max_names the most names to find
+///@returns the number of names found
+size_t bl_find_merch_by_price(db_t *db, int min_price, int max_price, size_t skip, char **names, size_t max_names);
+
+///@brief finds the merch whose descriptions have all the words of query, e.g. "red shirt". Alternatives
+///are separated by OR: "red shirt OR blue hat". Words are runs of letters and digits, matched regardless of case.
+///The first search indexes every description, later ones take time in the length of the lists of their words
+///@param names set to the names found. They belong to the store and stay valid until the merch is removed or renamed
+///@param max_names the most names to find
+///@returns the number of names found
+size_t bl_search_descriptions(db_t *db, char *query, char **names, size_t max_names);
+
 bool bl_remove_merchandise(db_t *db, char *merch_name);
 
-void bl_edit_merchandise();
+///@brief edits a merch. The new name is copied into the store, the new description is taken over by it
+bool bl_edit_merchandise(db_t *db, char *merch_name, char *new_name, char *new_desc, int new_price);
 
 void bl_show_stock();
 
-void bl_replenish();
-
-void bl_create_cart();
-
-void bl_remove_cart();
-
-void bl_add_to_cart();
-
-void bl_remove_from_cart();
-
-void bl_calculate_cost();
-
-void bl_checkout();
-
-void bl_quit();
\ No newline at end of file
+///@brief packs a shelf name of one letter and 1-6 digits (e.g. "A25") into a positive integer id
+///@param shelf_name the name to parse
+///@param shelf_id set to the packed id if shelf_name is valid
+///@returns true if shelf_name is a valid shelf name, else false
+bool parse_shelf_id(char *shelf_name, int *shelf_id);
+
+#define Shelf_name_size 8
+
+///@brief writes the display name of a packed shelf id to buf, which must hold at least Shelf_name_size chars
+void shelf_id_to_name(int shelf_id, char *buf);
+
+bool bl_replenish(db_t *db, char *merch_name, char *shelf_name, int amount);
+
+///@brief creates a new empty cart
+///@returns the id of the new cart, or 0 if the store has run out of cart ids
+int bl_create_cart(db_t *db);
+
+bool bl_remove_cart(db_t *db, int cart_id);
+
+bool bl_add_to_cart(db_t *db, int cart_id, char *merch_name, int amount);
+
+bool bl_remove_from_cart(db_t *db, int cart_id, char *merch_name, int amount);
+
+///@brief makes carts that have not been changed for timeout_ms milliseconds expire, counted from now
+///for the carts there already are. 0 turns expiry off, which is how a store starts. Not for the
+///shards of a sharded store
+void bl_set_cart_timeout(db_t *db, int timeout_ms);
+
+///@brief removes the carts that have expired and puts what they held back in stock. Takes O(1)
+///amortized time per expired cart and millisecond since the last call, the other carts are not looked at
+///@returns the number of carts removed
+size_t bl_expire_carts(db_t *db);
+
+///@brief looks up the cost of a cart in O(1) time
+///@param cost set to the total cost of the cart if it exists
+///@returns true if the cart exists, else false
+bool bl_calculate_cost(db_t *db, int cart_id, int *cost);
+
+///@brief takes everything in a cart from the shelves and removes the cart.
+///Everything in a cart is reserved when it is added, so a checkout of an existing cart always succeeds
+bool bl_checkout(db_t *db, int cart_id);
+
+///@brief checks out many carts at once. Carts that share no merch are checked out in parallel,
+///carts that share a merch are checked out one after the other in the order they are given
+///@param cart_ids the carts to check out
+///@param no_carts the number of ids in cart_ids
+///@param results results[i] is set to whether cart_ids[i] was checked out
+///@param no_workers the number of threads to use, or 0 for one per core
+///@returns the number of carts that were checked out
+size_t bl_checkout_batch(db_t *db, int *cart_ids, size_t no_carts, bool *results, int no_workers);
+
+///@brief looks up in O(1) time how much of a merch is in stock and not already in a cart
+///@param available set to the available amount if the merch exists
+///@returns true if the merch exists, else false
+bool bl_available_stock(db_t *db, char *merch_name, int *available);
+
+///@brief finds the merch with the least stock on the shelves, least first, without looking at the rest.
+///Takes O(k log k) time for k merch found
+///@param below only merch with less stock than this are found
+///@param names set to the names found. They belong to the store and stay valid until the merch is removed or renamed
+///@param stock stock[i] is set to the stock of names[i]
+///@param max_names the most names to find
+///@returns the number of names found
+size_t bl_find_low_stock(db_t *db, int below, char **names, int *stock, size_t max_names);
+
+///@brief sums price * stock over all merch, in one pass over the price and stock of every merch
+///@returns the value of everything on the shelves, carts included
+long long bl_total_stock_value(db_t *db);
+
+///@brief counts the merch with less stock than below, in one pass over the stock of every merch
+///@returns the number of such merch
+size_t bl_count_low_stock(db_t *db, int below);
+
+typedef struct bl_price_stats bl_price_stats_t;
+
+struct bl_price_stats
+{
+    size_t  no_merch;
+    int     min_price;
+    int     max_price;
+    double  avg_price;
+};
+
+///@brief computes the lowest, highest and average price of all merch, in one pass over the prices
+///@returns false if there is no merch, and stats is not set
+bool bl_price_stats(db_t *db, bl_price_stats_t *stats);
+
+void bl_quit();
+
+///@brief adds all merch in a catalog file, one "name,description,price" row per line.
+///Tabs may be used instead of commas. Invalid rows and merch that already exist are skipped
+///@returns the number of merch added, or -1 if the file could not be read or the rows could not be logged
+long bl_import_catalog(db_t *db, char *path);
+
+///@brief stocks shelves from a stock file, one "name,shelf,amount" row per line.
+///Tabs may be used instead of commas. Invalid rows are skipped
+///@returns the number of rows stocked, or -1 if the file could not be read or the rows could not be logged
+long bl_import_stock(db_t *db, char *path);
+
+///@brief writes all merch, shelves and carts to a snapshot file that bl_load_snapshot can map.
+///It is written to path.tmp first and renamed to path once it is on disk, so a failed save leaves path as it was
+///@returns true if the whole snapshot was written and synced to disk
+bool bl_save_snapshot(db_t *db, char *path);
+
+///@brief creates a webstore from a snapshot file written by bl_save_snapshot, in time linear in its carts.
+///The file is mapped and stays mapped until the webstore is destroyed. A merch is built from it when
+///it is first used by name or shelf, and the rest by the first call that reads all merch, as listing,
+///searching or the analytics. Records the file is damaged in are left out when they are built. Cart ids are kept
+///@returns the webstore, or NULL if the file could not be read, is not a snapshot or has damaged carts
+db_t *bl_load_snapshot(char *path);
+
+///@brief opens a store kept on disk in dir, creating it if needed. The latest snapshot is loaded
+///and the log written after it is replayed. From then on every change is logged to dir, and the
+///bl_* calls that change the store only return once their change is on disk. If the log cannot be
+///written they report failure (false, 0 or -1), though the change was made in memory. The log is
+///then failed for good, no later change is reported as made, and the store is to be reopened
+///@returns the store, or NULL if dir could not be read, its log does not match its snapshot, or the
+///torn end a crash left in its log could not be cut off
+db_t *bl_open_store(char *dir);
+
+///@brief starts writing a snapshot of a store opened with bl_open_store in the background.
+///The log up to now is removed once it is done. Stores compact on their own as their log grows
+///@returns false if the store is not kept on disk or a compaction is already running
+bool bl_compact_store(db_t *db);
+
+///@brief makes the bl_* calls on a store opened with bl_open_store return as soon as their change
+///is logged, before it is on disk. Callers that must know a change is durable call bl_commit, which
+///waits for all changes logged before it at once
+void bl_defer_commits(db_t *db, bool defer);
+
+///@brief waits until every change to a store opened with bl_open_store is on disk
+///@returns false if the log has failed, so changes made since the last successful commit may be lost
+bool bl_commit(db_t *db);
+
+typedef struct bl_log_stats bl_log_stats_t;
+
+struct bl_log_stats
+{
+    unsigned long   no_records;         //Changes logged
+    unsigned long   no_bytes;
+    unsigned long   no_syncs;           //Writes to disk, each one of all records logged since the last
+    unsigned long   sync_ns;            //Total time spent writing and syncing
+    unsigned long   no_commits;         //Calls that waited for their changes to reach the disk
+    unsigned long   commit_ns;          //Total time they waited
+    unsigned long   max_commit_ns;
+    unsigned long   no_compactions;
+    bool            failed;             //A write to the log failed, no change since is durable
+    int             error;              //errno of the write or sync that failed
+};
+
+///@brief reads the counters of the log of a store opened with bl_open_store
+///@returns false if the store is not kept on disk
+bool bl_log_stats(db_t *db, bl_log_stats_t *stats);
+
+///@brief reads the counters of the allocator of the merch and shelf tables of db, what their
+///buckets and entries take up now and at most, and how many allocations and frees they made
+///@returns the counters
+ioopm_allocator_stats_t bl_table_memory(db_t *db);
+
+///@brief writes how many times each bl_* call was made on db and the percentiles of how long
+///it took, as a table or as JSON with the whole histogram. Calls are only timed if the store is
+///built with -DBL_PROFILE, without it the timing is compiled out
+///@returns false if the store is built without it, and nothing is written
+bool bl_profile_dump(db_t *db, FILE *out, bool json);
+
+///@brief forgets the calls timed so far
+void bl_profile_reset(db_t *db);
@@ -0,0 +1,244 @@
+#pragma once
+
+// Layout of the store and helpers shared by the modules built on top of it.
+// Only business logic modules include this, the user interface goes through business_logic.h.
+
+#include "business_logic.h"
+#include "operations.h"
+#include <stdatomic.h>
+
+typedef struct wal wal_t;
+typedef struct shelf_registry shelf_registry_t;
+typedef struct desc_index desc_index_t;
+typedef struct merch merch_t;
+typedef struct merch_columns merch_columns_t;
+typedef struct profile profile_t;
+typedef struct snapshot snapshot_t;
+
+//The fields of all merch that scans read, one dense array per field indexed by merch id, so a
+//scan runs straight through memory. The other fields are in the merch_t at records[id]. Ids are
+//0 to size - 1, the last merch is moved into the id of a merch that is removed.
+struct merch_columns
+{
+    int                 *prices;
+    int                 *stocks;        //Sum of the quantities of all shelves of the merch
+    merch_t             **records;
+    int                 size;
+    int                 capacity;
+};
+
+struct webstore_db
+{
+    ioopm_hash_table_t  *merch;         //interned name => merch id
+    ioopm_allocator_t   *tables;        //Allocates merch and storage, and counts their memory for bl_table_memory
+    merch_columns_t     columns;
+    ioopm_hash_table_t  *storage;
+    ioopm_slot_map_t    *carts;         //cart id => cart_t *
+    ioopm_string_pool_t *names;         //Canonical merch names, shared by merch, storage and carts
+    ioopm_sorted_array_t *merch_names;  //The names of all merch in order, for listing and prefix search
+    ioopm_sorted_array_t *merch_by_price;   //All merch by price, then by name
+    ioopm_indexed_heap_t *low_stock;    //All merch by stock, least first
+    desc_index_t        *descs;         //Words of the descriptions, built by the first search (possibly NULL)
+    int                 carts_created;
+    struct cart         *free_carts;    //Removed carts kept for reuse, linked through next_free
+    ioopm_timer_wheel_t *cart_timers;   //Expiry of the carts, if bl_set_cart_timeout turned it on (possibly NULL)
+    int                 cart_timeout_ms;
+    ioopm_arena_t       *texts;         //Descriptions loaded in bulk, freed with the store
+    ioopm_arena_t       *scratch;       //Temporaries of the operation in progress, each in a frame popped when it is done
+    snapshot_t          *snapshot;      //Mapped snapshot the store was loaded from (possibly NULL), merch are built from it as they are used
+    wal_t               *wal;           //Log of the changes, if the store is kept on disk (possibly NULL)
+    shelf_registry_t    *shelves;       //Owners of the shelves, if the store is a shard of a sharded store (possibly NULL)
+    int                 shard_no;
+#ifdef BL_PROFILE
+    profile_t           *profile;       //Latencies of the bl_* calls, see PROFILE_OP
+#endif
+};
+
+struct merch
+{
+    char            *name;          //Interned in db->names
+    char            *desc;
+    bool            owns_desc;      //False if desc lives in db->texts and must not be freed on its own
+    int             doc_id;         //Id of desc in db->descs, 0 if it is not indexed
+    merch_columns_t *columns;       //Price and stock are in these columns, see merch_price and merch_stock
+    int             id;             //Index in columns
+    int             stock_handle;   //Handle in db->low_stock
+    atomic_int      reserved;       //Amount held by carts
+    atomic_int      available;      //stock - reserved, what can still be put in a cart
+    ioopm_hash_table_t *locs;       //shelf id => shelf_t *
+    ioopm_hash_table_t *carts;      //cart id => cart_t *, the carts this merch is in
+};
+
+//The price and the stock of a merch, which are kept in the columns of its store
+#define merch_price(merch)  ((merch)->columns->prices[(merch)->id])
+#define merch_stock(merch)  ((merch)->columns->stocks[(merch)->id])
+
+struct shelf
+{
+    int     shelf_id;       //Packed shelf name, see parse_shelf_id
+    int     quantity;
+};
+
+typedef struct shelf shelf_t;
+
+typedef struct cart cart_t;
+
+struct cart
+{
+    int                 cart_id;
+    int                 total;      //Sum of price * amount over all items, kept up to date by every change
+    ioopm_hash_table_t  *items;     //interned merch name => amount
+    uint64_t            touched;    //Monotonic ms of the last change, only kept while carts expire
+    int                 timer;      //Handle in db->cart_timers, or No_timer
+    cart_t              *next_free;
+};
+
+#define No_timer -1
+
+bool int_key_eq(elem_t k1, elem_t k2);
+
+int int_knr_hash(elem_t key);
+
+int string_knr_hash(elem_t key);
+
+///@brief checks that a shelf id is one parse_shelf_id can return, for ids read from files
+bool valid_shelf_id(int shelf_id);
+
+///@brief creates a merch and gives it the next id in db->columns, insert_merch adds it to the rest of db
+merch_t *create_merch(db_t *db, char *merch_name, char *merch_desc, int merch_price);
+
+merch_t *get_merch(db_t *db, char *merch_name);
+
+///@brief looks up a merch by a name that is already interned in db->names
+merch_t *get_interned_merch(db_t *db, char *name);
+
+///@brief adds a new merch whose name is already interned, taking over that reference
+void insert_merch(db_t *db, merch_t *merch);
+
+///@brief stocks amount of a merch on a shelf, creating the shelf if needed
+///@returns false if the shelf holds another merch
+bool stock_shelf(db_t *db, merch_t *merch, int shelf_id, int amount);
+
+cart_t *get_cart(db_t *db, int cart_id);
+
+///@brief gets an empty cart, reusing a removed one if possible. It is not yet in db->carts and has no id
+cart_t *create_cart(db_t *db);
+
+///@brief sets the timer of a new cart, if carts expire
+void schedule_cart_expiry(db_t *db, cart_t *cart);
+
+///@brief records that a cart was changed, which puts off its expiry
+void touch_cart(db_t *db, cart_t *cart);
+
+///@brief cancels the timer of a cart that is being removed
+void cancel_cart_expiry(db_t *db, cart_t *cart);
+
+///@brief takes a cart out of db->carts and keeps it for reuse, without logging it
+///@param release_reservations false if what the cart holds was taken from the shelves, as in a checkout
+void remove_cart(db_t *db, cart_t *cart, bool release_reservations);
+
+///@brief reserves amount of a merch for a cart
+///@returns false if not that much is available
+bool reserve_stock(merch_t *merch, int amount);
+
+///@brief adds amount of an already reserved merch to a cart
+void put_in_cart(cart_t *cart, merch_t *merch, int amount);
+
+int cart_amount(cart_t *cart, merch_t *merch);
+
+///@brief appends op to the log of the store, if it has one. It is not durable until commit_log
+void log_operation(db_t *db, operation_t *op);
+
+///@brief waits until everything logged so far is on disk, unless commits are deferred
+///@returns false if the log has failed, then the change must not be reported as made
+bool commit_log(db_t *db);
+
+///@brief logs op and waits until it is on disk
+///@returns false if the log has failed, as commit_log
+bool commit_operation(db_t *db, operation_t *op);
+
+///@brief writes out the log and stops logging, before the store is destroyed
+void close_log(db_t *db);
+
+///@brief adds the description of a merch to the description index, if the store has one
+void index_desc(db_t *db, merch_t *merch);
+
+///@brief takes the description of a merch out of the description index, if the store has one.
+///Called before the description is replaced or freed
+void unindex_desc(db_t *db, merch_t *merch);
+
+void destroy_desc_index(db_t *db);
+
+///@brief builds the merch named name from the snapshot the store was loaded from, if it is there and not built yet
+///@returns the merch, or NULL if there is none to build
+merch_t *load_snapshot_name(db_t *db, char *name);
+
+///@brief builds the merch that holds a shelf in the snapshot the store was loaded from, if it is not built yet,
+///so the shelf is not given to another merch
+void load_snapshot_shelf(db_t *db, int shelf_id);
+
+///@brief builds every merch of the snapshot the store was loaded from that is not built yet, before a call that reads all merch
+void load_snapshot_merch(db_t *db);
+
+///@brief unmaps the snapshot the store was loaded from, once no merch points into it
+void close_snapshot(db_t *db);
+
+//The bl_* calls whose latencies are recorded when the store is built with -DBL_PROFILE
+typedef enum profiled_op
+{
+    Prof_add_merchandise,
+    Prof_remove_merchandise,
+    Prof_edit_merchandise,
+    Prof_list_merchandise,
+    Prof_find_merch_by_prefix,
+    Prof_find_merch_by_price,
+    Prof_replenish,
+    Prof_create_cart,
+    Prof_remove_cart,
+    Prof_add_to_cart,
+    Prof_remove_from_cart,
+    Prof_calculate_cost,
+    Prof_checkout,
+    Prof_checkout_batch,
+    Prof_available_stock,
+    Prof_find_low_stock,
+    Prof_search_descriptions,
+    No_profiled_ops
+} profiled_op_t;
+
+#ifdef BL_PROFILE
+
+typedef struct profile_span profile_span_t;
+
+struct profile_span
+{
+    db_t            *db;
+    profiled_op_t   op;
+    uint64_t        start_ns;
+};
+
+uint64_t profile_clock();
+
+///@brief records the time since the span started in the histogram of its operation
+void end_profile_span(profile_span_t *span);
+
+profile_t *create_profile();
+
+void destroy_profile(profile_t *profile);
+
+//Put first in a bl_* function, times the call until it returns, whichever return it takes
+#define PROFILE_OP(db, op) \
+    profile_span_t profile_span __attribute__((cleanup(end_profile_span))) = { db, op, profile_clock() }
+
+#else
+
+#define PROFILE_OP(db, op)
+
+#endif
+
+///@brief claims a shelf for the shard db is, in the registry shared by the shards of a sharded store
+///@returns false if a merch on another shard holds the shelf
+bool claim_shelf(db_t *db, int shelf_id);
+
+///@brief hands back a shelf claimed by claim_shelf once the merch of db no longer holds it
+void release_shelf(db_t *db, int shelf_id);
@@ -1,3 +1,12 @@
 #pragma once
 
-#include "../generic_data_structures/hash_table.h"
\ No newline at end of file
+#include "../generic_data_structures/hash_table.h"
+#include "../generic_data_structures/string_pool.h"
+#include "../generic_data_structures/slot_map.h"
+#include "../generic_data_structures/allocator.h"
+#include "../generic_data_structures/arena.h"
+#include "../generic_data_structures/spsc_queue.h"
+#include "../generic_data_structures/sorted_array.h"
+#include "../generic_data_structures/indexed_heap.h"
+#include "../generic_data_structures/timer_wheel.h"
+#include "../generic_data_structures/trace.h"
\ No newline at end of file
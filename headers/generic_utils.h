@@ -4,9 +4,11 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include "../generic_data_structures/arena.h"
 
 
 typedef union answer answer_t;
+typedef struct line_reader line_reader_t;
 
 typedef bool(*check_func)(char*);
 typedef answer_t(*convert_func)(char*);
@@ -37,6 +39,13 @@ bool is_number(char *str);
 bool not_empty(char *str);
 
 
+///@brief checks if a given string is an integer that fits in an int and parses it, in one pass
+///@param str the string to parse, may be NULL
+///@param value set to the integer if there is one
+///@returns true if str is an integer, else false
+bool parse_int(char *str, int *value);
+
+
 ///-----------------------------------------------------------------------------------------------------------------------------------------------------------------
 ///-------------------------------------------------------------------------Misc------------------------------------------------------------------------------------
 ///-----------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -62,16 +71,50 @@ char *trim(char *str);
 ///@returns the amount of characters in the given string as an integer
 int read_string(char *buf, int buf_siz);
 
+///@brief reads a whole file into memory
+///@param path the file to read
+///@param length set to the number of bytes read
+///@returns the contents with a '\0' added after them, to be freed by the caller, or NULL if the file could not be opened
+char *read_file(char *path, size_t *length);
+
+
+///-----------------------------------------------------------------------------------------------------------------------------------------------------------------
+///-------------------------------------------------------------------------Line-reader-----------------------------------------------------------------------------
+///-----------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+///@brief   creates a reader that reads fd in large blocks and hands out one line at a time
+///@param   fd the file descriptor to read, it is not closed by the reader
+///@param   block_size the number of bytes read at a time, or 0 for a default size
+///@returns the reader
+line_reader_t *line_reader_create(int fd, size_t block_size);
+
+///@brief   destroys a reader, input it has read but not handed out is lost
+///@param   reader the reader to destroy
+void line_reader_destroy(line_reader_t *reader);
+
+///@brief   reads the next line, without copying it out of the reader
+///@param   reader the reader to read from
+///@param   length set to the length of the line, without its '\n' or "\r\n"
+///@returns the line, null terminated and valid until the next call, or NULL at the end of the input
+char *read_line(line_reader_t *reader, size_t *length);
+
+///@brief   the reader of standard input used by read_string and the ask_question functions,
+///         stdin must not be read through stdio once it is used
+///@returns the reader, created on the first call
+line_reader_t *stdin_reader();
+
 
 ///-----------------------------------------------------------------------------------------------------------------------------------------------------------------
 ///-------------------------------------------------------------------------Ask-question----------------------------------------------------------------------------
 ///-----------------------------------------------------------------------------------------------------------------------------------------------------------------
 
 
-///@brief   asks a generic question, gets an input from keyboard, checks if input is as expected with check, converts input
+///@brief   asks a generic question, gets an input from keyboard, checks if input is as expected with check, converts input.
+///         Ends the program if the input ends before an answer is accepted
 ///@param   question that is prompted to user
 ///@param   a function check that returns a bool, to see wether input is as expected
-///@param   a function convert that converts input from user
+///@param   a function convert that converts input from user, the input is only valid until the next question
 ///@returns a union answer_t that will be determined later
 answer_t ask_question(char *question, check_func check, convert_func convert);
 
@@ -83,4 +126,10 @@ int ask_question_int(char *question);
 ///@brief   asks a question untill a non-empty string is inserted by the user
 ///@param   asks a given question
 ///@returns a non-empty string
-char *ask_question_string(char *question);
\ No newline at end of file
+char *ask_question_string(char *question);
+
+///@brief   asks a question untill a non-empty string is inserted by the user
+///@param   arena the arena the answer is copied into
+///@param   asks a given question
+///@returns a non-empty string, freed with the arena
+char *ask_question_string_in(ioopm_arena_t *arena, char *question);
\ No newline at end of file
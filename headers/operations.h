@@ -0,0 +1,69 @@
+#pragma once
+
+// A store operation as a value: what the write-ahead log records and replays and what
+// scripts are made of. Operations have a compact binary encoding that does not depend on
+// the machine that wrote it, and a text form of one line each, see parse_operation.
+// The reads (Op_calculate_cost, Op_available_stock) are never logged.
+
+#include "business_logic.h"
+
+typedef struct operation operation_t;
+
+typedef enum op_kind
+{
+    Op_add_merch = 1,
+    Op_remove_merch,
+    Op_edit_merch,
+    Op_replenish,
+    Op_create_cart,
+    Op_remove_cart,
+    Op_add_to_cart,
+    Op_remove_from_cart,
+    Op_checkout,
+    Op_calculate_cost,
+    Op_available_stock,
+    No_op_kinds
+} op_kind_t;
+
+// Only the fields used by the kind are set, see encode_operation for which
+struct operation
+{
+    op_kind_t   kind;
+    char        *name;          //The merch operated upon
+    char        *new_name;
+    char        *desc;
+    int         price;
+    int         shelf_id;       //Packed, see parse_shelf_id
+    int         cart_id;
+    int         amount;
+};
+
+///@brief the most bytes encode_operation can write for op
+size_t max_encoded_size(operation_t *op);
+
+///@brief encodes op into buf, which must hold at least max_encoded_size(op) bytes
+///@returns the number of bytes written
+size_t encode_operation(operation_t *op, char *buf);
+
+///@brief decodes one operation from the start of buf. The strings of op point into buf
+///@param length the number of bytes in buf
+///@returns the number of bytes read, or 0 if buf does not start with a valid operation
+size_t decode_operation(char *buf, size_t length, operation_t *op);
+
+///@brief parses the text form of an operation, "kind field...", e.g. "add_to_cart 3 apple 2".
+///Fields are separated by spaces or tabs; a description is the rest of the line. The fields
+///of each kind are listed by operation_usage. line is split in place and op points into it
+///@returns false if line is not a valid operation
+bool parse_operation(char *line, operation_t *op);
+
+///@brief the name of a kind in the text form, e.g. "add_to_cart"
+char *operation_name(op_kind_t kind);
+
+///@brief the text form of a kind with its fields, e.g. "add_to_cart CART NAME AMOUNT"
+char *operation_usage(op_kind_t kind);
+
+///@brief applies op to db through the bl_* function of its kind. Descriptions are copied
+///@param result set to the id of the new cart for Op_create_cart, the cost for Op_calculate_cost
+///and the amount for Op_available_stock (may be NULL)
+///@returns what the bl_* function returned
+bool apply_operation(db_t *db, operation_t *op, int *result);
@@ -0,0 +1,37 @@
+#pragma once
+
+// The protocol of the store server. A client sends requests and reads responses on one
+// stream connection. Requests may be pipelined: a client can send many before reading, and
+// responses come back in the order of the requests. Integers are little endian.
+//
+//   request:   | length of the rest (u32) | tag (u32) | operation, see encode_operation |
+//   response:  | tag (u32) | status (u8), 1 if the operation succeeded | result (i32) |
+//
+// The tag is chosen by the client and returned as it is. The result is the id of a new cart,
+// the cost of a cart or the available amount of a merch, see apply_operation, and 0 otherwise.
+
+#include "operations.h"
+#include <stdint.h>
+
+#define Request_header_size     8
+#define Response_size           9
+#define Max_request_size        (1 << 20)
+
+///@brief the most bytes encode_request can write for op
+size_t max_request_size(operation_t *op);
+
+///@brief encodes a request for op into buf, which must hold at least max_request_size(op) bytes
+///@returns the number of bytes written
+size_t encode_request(char *buf, uint32_t tag, operation_t *op);
+
+///@brief decodes the request at the start of buf. The strings of op point into buf
+///@param length the number of bytes in buf
+///@returns the number of bytes read, 0 if buf only holds the start of a request, or -1 if buf
+///does not start with a valid request
+long decode_request(char *buf, size_t length, uint32_t *tag, operation_t *op);
+
+///@brief encodes a response into buf, which must hold Response_size bytes
+void encode_response(char *buf, uint32_t tag, bool succeeded, int result);
+
+///@brief decodes the response at the start of buf, which must hold Response_size bytes
+void decode_response(char *buf, uint32_t *tag, bool *succeeded, int *result);
@@ -0,0 +1,31 @@
+#pragma once
+
+// A store split into shards so that it can use more than one core. The merch is spread over
+// the shards by the hash of its name, each with its shelves, and each shard is a store of its
+// own owned by a worker thread. The calling thread only routes operations: it sends each one
+// to the shards it needs through a lock-free queue per shard and keeps the carts, whose items
+// may come from any shard. Shards are kept in memory only, they are never logged.
+
+#include "operations.h"
+
+typedef struct sharded_db sharded_db_t;
+
+///@brief creates an empty store whose merch is split across shards by the hash of its name.
+///Each shard is a store of its own, owned by a worker thread. Carts may hold merch from any shard
+///@param no_shards the number of shards, at most 64, or 0 for one per core
+sharded_db_t *bl_create_sharded(int no_shards);
+
+void bl_destroy_sharded(sharded_db_t *sdb);
+
+///@brief applies operations to a sharded store as if one after the other, the shards working in parallel.
+///Every operation is sent to the shards it needs, and the call returns once all of them are done.
+///Only the calling thread may use the store
+///@param ops the operations, their strings are only read during the call
+///@param no_ops the number of operations in ops
+///@param succeeded succeeded[i] is set to what apply_operation would return for ops[i]
+///@param results results[i] is set to the result of ops[i], see apply_operation
+///@returns the number of operations that succeeded
+size_t bl_sharded_apply_batch(sharded_db_t *sdb, operation_t *ops, size_t no_ops, bool *succeeded, int *results);
+
+///@brief applies one operation to a sharded store, see bl_sharded_apply_batch
+bool bl_sharded_apply(sharded_db_t *sdb, operation_t *op, int *result);
@@ -0,0 +1,355 @@
+#include "headers/operations.h"
+#include "headers/generic_utils.h"
+
+#include <stdint.h>
+#include <limits.h>
+
+// An operation is encoded as its kind in one byte followed by its fields, in the order of
+// the struct. Integers are zigzag varints, so small values of either sign take one or two
+// bytes. Strings are a varint length followed by the chars and a terminating '\0', so that
+// a decoded operation can point into the buffer it was read from.
+
+#define Max_varint_size 5
+
+/*=================================================================
+ *  Fields
+ *=================================================================*/
+
+static char *put_int(char *buf, int value)
+{
+    uint32_t zigzag = ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+    while(zigzag >= 0x80)
+    {
+        *buf++ = (char) (zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    *buf++ = (char) zigzag;
+    return buf;
+}
+
+static char *put_str(char *buf, char *str)
+{
+    size_t length = strlen(str);
+    buf = put_int(buf, (int) length);
+    memcpy(buf, str, length + 1);
+    return buf + length + 1;
+}
+
+static char *get_int(char *buf, char *end, int *value)
+{
+    uint32_t zigzag = 0;
+    for(int shift = 0; buf < end && shift < 7 * Max_varint_size; shift += 7)
+    {
+        uint8_t byte = *buf++;
+        zigzag |= (uint32_t) (byte & 0x7f) << shift;
+        if(byte < 0x80)
+        {
+            *value = (int) (zigzag >> 1) ^ -(int) (zigzag & 1);
+            return buf;
+        }
+    }
+    return NULL; //Truncated or too long
+}
+
+static char *get_str(char *buf, char *end, char **str)
+{
+    int length;
+    buf = buf ? get_int(buf, end, &length) : NULL;
+    if(buf == NULL || length < 0 || length >= end - buf || buf[length] != '\0')
+    {
+        return NULL;
+    }
+    *str = buf;
+    return buf + length + 1;
+}
+
+/*=================================================================
+ *  Operations
+ *=================================================================*/
+
+static bool has_name(op_kind_t kind)
+{
+    return kind == Op_add_merch || kind == Op_remove_merch || kind == Op_edit_merch || kind == Op_replenish
+        || kind == Op_add_to_cart || kind == Op_remove_from_cart || kind == Op_available_stock;
+}
+
+static bool has_cart(op_kind_t kind)
+{
+    return kind == Op_create_cart || kind == Op_remove_cart || kind == Op_add_to_cart
+        || kind == Op_remove_from_cart || kind == Op_checkout || kind == Op_calculate_cost;
+}
+
+static bool has_amount(op_kind_t kind)
+{
+    return kind == Op_replenish || kind == Op_add_to_cart || kind == Op_remove_from_cart;
+}
+
+size_t max_encoded_size(operation_t *op)
+{
+    size_t size = 1 + 5 * Max_varint_size;
+    size += op->name ? strlen(op->name) + 1 : 0;
+    size += op->new_name ? strlen(op->new_name) + 1 : 0;
+    size += op->desc ? strlen(op->desc) + 1 : 0;
+    return size;
+}
+
+size_t encode_operation(operation_t *op, char *buf)
+{
+    char *start = buf;
+    *buf++ = (char) op->kind;
+    
+    if(has_name(op->kind))
+    {
+        buf = put_str(buf, op->name);
+    }
+    if(op->kind == Op_edit_merch)
+    {
+        buf = put_str(buf, op->new_name);
+    }
+    if(op->kind == Op_add_merch || op->kind == Op_edit_merch)
+    {
+        buf = put_str(buf, op->desc);
+        buf = put_int(buf, op->price);
+    }
+    if(op->kind == Op_replenish)
+    {
+        buf = put_int(buf, op->shelf_id);
+    }
+    if(has_cart(op->kind))
+    {
+        buf = put_int(buf, op->cart_id);
+    }
+    if(has_amount(op->kind))
+    {
+        buf = put_int(buf, op->amount);
+    }
+    return buf - start;
+}
+
+size_t decode_operation(char *buf, size_t length, operation_t *op)
+{
+    char *end = buf + length;
+    memset(op, 0, sizeof(operation_t));
+    if(length == 0 || buf[0] < Op_add_merch || buf[0] >= No_op_kinds)
+    {
+        return 0;
+    }
+    op->kind = buf[0];
+    char *next = buf + 1;
+    
+    if(has_name(op->kind))
+    {
+        next = get_str(next, end, &op->name);
+    }
+    if(op->kind == Op_edit_merch)
+    {
+        next = get_str(next, end, &op->new_name);
+    }
+    if(op->kind == Op_add_merch || op->kind == Op_edit_merch)
+    {
+        next = get_str(next, end, &op->desc);
+        next = next ? get_int(next, end, &op->price) : NULL;
+    }
+    if(op->kind == Op_replenish)
+    {
+        next = next ? get_int(next, end, &op->shelf_id) : NULL;
+    }
+    if(has_cart(op->kind))
+    {
+        next = next ? get_int(next, end, &op->cart_id) : NULL;
+    }
+    if(has_amount(op->kind))
+    {
+        next = next ? get_int(next, end, &op->amount) : NULL;
+    }
+    return next ? next - buf : 0;
+}
+
+bool apply_operation(db_t *db, operation_t *op, int *result)
+{
+    char shelf_name[Shelf_name_size];
+    char *desc;
+    int ignored_result;
+    result = result ? result : &ignored_result;
+    
+    switch(op->kind)
+    {
+        case Op_add_merch:
+            desc = strdup(op->desc);
+            if(bl_add_merchandise(db, op->name, desc, op->price))
+            {
+                return true;
+            }
+            free(desc); //Only taken over by the store if the merch was added
+            return false;
+        case Op_remove_merch:
+            return bl_remove_merchandise(db, op->name);
+        case Op_edit_merch:
+            desc = strdup(op->desc);
+            if(bl_edit_merchandise(db, op->name, op->new_name, desc, op->price))
+            {
+                return true;
+            }
+            free(desc);
+            return false;
+        case Op_replenish:
+            shelf_id_to_name(op->shelf_id, shelf_name);
+            return bl_replenish(db, op->name, shelf_name, op->amount);
+        case Op_create_cart:
+            *result = bl_create_cart(db);
+            return *result != 0;
+        case Op_remove_cart:
+            return bl_remove_cart(db, op->cart_id);
+        case Op_add_to_cart:
+            return bl_add_to_cart(db, op->cart_id, op->name, op->amount);
+        case Op_remove_from_cart:
+            return bl_remove_from_cart(db, op->cart_id, op->name, op->amount);
+        case Op_checkout:
+            return bl_checkout(db, op->cart_id);
+        case Op_calculate_cost:
+            return bl_calculate_cost(db, op->cart_id, result);
+        case Op_available_stock:
+            return bl_available_stock(db, op->name, result);
+        default:
+            return false;
+    }
+}
+
+/*=================================================================
+ *  Text form
+ *=================================================================*/
+
+// Indexed by kind. In the usages, CART is a number, SHELF a shelf name such as "A25" and
+// DESC the rest of the line
+static char *usages[No_op_kinds] =
+{
+    [Op_add_merch]          = "add_merch NAME PRICE DESC",
+    [Op_remove_merch]       = "remove_merch NAME",
+    [Op_edit_merch]         = "edit_merch NAME NEW_NAME PRICE DESC",
+    [Op_replenish]          = "replenish NAME SHELF AMOUNT",
+    [Op_create_cart]        = "create_cart CART",
+    [Op_remove_cart]        = "remove_cart CART",
+    [Op_add_to_cart]        = "add_to_cart CART NAME AMOUNT",
+    [Op_remove_from_cart]   = "remove_from_cart CART NAME AMOUNT",
+    [Op_checkout]           = "checkout CART",
+    [Op_calculate_cost]     = "calculate_cost CART",
+    [Op_available_stock]    = "available_stock NAME",
+};
+
+static char *names[No_op_kinds] =
+{
+    [Op_add_merch]          = "add_merch",
+    [Op_remove_merch]       = "remove_merch",
+    [Op_edit_merch]         = "edit_merch",
+    [Op_replenish]          = "replenish",
+    [Op_create_cart]        = "create_cart",
+    [Op_remove_cart]        = "remove_cart",
+    [Op_add_to_cart]        = "add_to_cart",
+    [Op_remove_from_cart]   = "remove_from_cart",
+    [Op_checkout]           = "checkout",
+    [Op_calculate_cost]     = "calculate_cost",
+    [Op_available_stock]    = "available_stock",
+};
+
+char *operation_usage(op_kind_t kind)
+{
+    return kind > 0 && kind < No_op_kinds ? usages[kind] : NULL;
+}
+
+char *operation_name(op_kind_t kind)
+{
+    return kind > 0 && kind < No_op_kinds ? names[kind] : NULL;
+}
+
+static bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+//Cuts the next field off *line, NULL if there is none
+static char *next_field(char **line)
+{
+    char *field = *line;
+    while(is_blank(*field))
+    {
+        ++field;
+    }
+    if(*field == '\0')
+    {
+        return NULL;
+    }
+    
+    char *end = field;
+    while(*end != '\0' && !is_blank(*end))
+    {
+        ++end;
+    }
+    *line = *end == '\0' ? end : end + 1;
+    *end = '\0';
+    return field;
+}
+
+//The rest of the line without surrounding blanks, which may be empty
+static char *rest_of_line(char **line)
+{
+    char *rest = *line;
+    while(is_blank(*rest))
+    {
+        ++rest;
+    }
+    char *end = rest + strlen(rest);
+    while(end > rest && is_blank(end[-1]))
+    {
+        *--end = '\0';
+    }
+    *line = end;
+    return rest;
+}
+
+bool parse_operation(char *line, operation_t *op)
+{
+    memset(op, 0, sizeof(operation_t));
+    char *kind_name = next_field(&line);
+    for(op_kind_t kind = Op_add_merch; kind_name != NULL && kind < No_op_kinds; ++kind)
+    {
+        if(strcmp(kind_name, operation_name(kind)) == 0)
+        {
+            op->kind = kind;
+        }
+    }
+    if(op->kind == 0)
+    {
+        return false;
+    }
+    
+    bool valid = true;
+    if(has_cart(op->kind))
+    {
+        valid = parse_int(next_field(&line), &op->cart_id);
+    }
+    if(has_name(op->kind))
+    {
+        op->name = next_field(&line);
+        valid = valid && op->name != NULL;
+    }
+    if(op->kind == Op_edit_merch)
+    {
+        op->new_name = next_field(&line);
+        valid = valid && op->new_name != NULL;
+    }
+    if(op->kind == Op_add_merch || op->kind == Op_edit_merch)
+    {
+        valid = valid && parse_int(next_field(&line), &op->price);
+        op->desc = rest_of_line(&line);
+    }
+    if(op->kind == Op_replenish)
+    {
+        char *shelf = next_field(&line);
+        valid = valid && shelf != NULL && parse_shelf_id(shelf, &op->shelf_id);
+    }
+    if(has_amount(op->kind))
+    {
+        valid = valid && parse_int(next_field(&line), &op->amount);
+    }
+    return valid && next_field(&line) == NULL;  //Nothing may follow the last field
+}
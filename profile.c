@@ -0,0 +1,222 @@
+#include "headers/business_logic_internal.h"
+
+#include <time.h>
+
+// Latencies of the bl_* calls, for bl_profile_dump. Only built with -DBL_PROFILE, without it
+// PROFILE_OP expands to nothing and the calls are not timed at all.
+//
+// Each operation has a histogram of its latencies in ns, with buckets in the manner of an HDR
+// histogram: latencies below Sub_buckets have a bucket each, and every power of two above that
+// is split into Sub_buckets buckets. A bucket is then at most 1 / Sub_buckets of its latencies
+// wide, about 3%, whatever their size, and recording a latency is a few shifts and an add.
+
+#ifdef BL_PROFILE
+
+#define Sub_bits    5
+#define Sub_buckets (1 << Sub_bits)
+#define Max_bits    36      //Latencies of 2^36 ns (about a minute) and more share the last bucket
+#define No_buckets  ((Max_bits - Sub_bits + 1) * Sub_buckets)
+
+typedef struct histogram histogram_t;
+
+struct histogram
+{
+    uint64_t    counts[No_buckets];
+    uint64_t    no_calls;
+    uint64_t    total_ns;
+    uint64_t    min_ns;
+    uint64_t    max_ns;
+};
+
+struct profile
+{
+    histogram_t ops[No_profiled_ops];
+};
+
+static char *op_names[No_profiled_ops] =
+{
+    [Prof_add_merchandise]      = "add_merchandise",
+    [Prof_remove_merchandise]   = "remove_merchandise",
+    [Prof_edit_merchandise]     = "edit_merchandise",
+    [Prof_list_merchandise]     = "list_merchandise",
+    [Prof_find_merch_by_prefix] = "find_merch_by_prefix",
+    [Prof_find_merch_by_price]  = "find_merch_by_price",
+    [Prof_replenish]            = "replenish",
+    [Prof_create_cart]          = "create_cart",
+    [Prof_remove_cart]          = "remove_cart",
+    [Prof_add_to_cart]          = "add_to_cart",
+    [Prof_remove_from_cart]     = "remove_from_cart",
+    [Prof_calculate_cost]       = "calculate_cost",
+    [Prof_checkout]             = "checkout",
+    [Prof_checkout_batch]       = "checkout_batch",
+    [Prof_available_stock]      = "available_stock",
+    [Prof_find_low_stock]       = "find_low_stock",
+    [Prof_search_descriptions]  = "search_descriptions",
+};
+
+/*=================================================================
+ *  Recording
+ *=================================================================*/
+
+uint64_t profile_clock()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int bucket_of(uint64_t ns)
+{
+    if(ns < Sub_buckets)
+    {
+        return (int) ns;
+    }
+    int top_bit = 63 - __builtin_clzll(ns);
+    if(top_bit >= Max_bits)
+    {
+        return No_buckets - 1;
+    }
+    int shift = top_bit - Sub_bits;    //The Sub_bits bits below the top bit pick the bucket within its power of two
+    return (shift + 1) * Sub_buckets + (int) (ns >> shift) - Sub_buckets;
+}
+
+//The largest latency that goes in a bucket
+static uint64_t bucket_limit(int bucket)
+{
+    if(bucket < Sub_buckets)
+    {
+        return bucket;
+    }
+    int shift = bucket / Sub_buckets - 1;
+    uint64_t first = (uint64_t) (Sub_buckets + bucket % Sub_buckets) << shift;
+    return first + ((uint64_t) 1 << shift) - 1;
+}
+
+void end_profile_span(profile_span_t *span)
+{
+    uint64_t ns = profile_clock() - span->start_ns;
+    histogram_t *histogram = &span->db->profile->ops[span->op];
+    histogram->counts[bucket_of(ns)] += 1;
+    histogram->no_calls += 1;
+    histogram->total_ns += ns;
+    if(histogram->no_calls == 1 || ns < histogram->min_ns)
+    {
+        histogram->min_ns = ns;
+    }
+    if(ns > histogram->max_ns)
+    {
+        histogram->max_ns = ns;
+    }
+}
+
+profile_t *create_profile()
+{
+    return calloc(1, sizeof(profile_t));
+}
+
+void destroy_profile(profile_t *profile)
+{
+    free(profile);
+}
+
+void bl_profile_reset(db_t *db)
+{
+    memset(db->profile, 0, sizeof(profile_t));
+}
+
+/*=================================================================
+ *  Dumping
+ *=================================================================*/
+
+//The latency that a fraction of the calls took at most, to within the width of its bucket
+static uint64_t percentile(histogram_t *histogram, double fraction)
+{
+    uint64_t rank = (uint64_t) (fraction * histogram->no_calls + 0.5);
+    rank = rank > 0 ? rank : 1;
+    uint64_t seen = 0;
+    for(int bucket = 0; bucket < No_buckets; ++bucket)
+    {
+        seen += histogram->counts[bucket];
+        if(seen >= rank)
+        {
+            uint64_t limit = bucket_limit(bucket);
+            return limit < histogram->max_ns ? limit : histogram->max_ns;
+        }
+    }
+    return histogram->max_ns;
+}
+
+static void dump_text(profile_t *profile, FILE *out)
+{
+    fprintf(out, "%-22s %10s %10s %10s %10s %10s %10s %12s\n", "operation", "calls", "mean ns", "p50", "p90", "p99",
+            "p99.9", "max");
+    for(int op = 0; op < No_profiled_ops; ++op)
+    {
+        histogram_t *histogram = &profile->ops[op];
+        if(histogram->no_calls == 0)
+        {
+            continue;
+        }
+        fprintf(out, "%-22s %10lu %10lu %10lu %10lu %10lu %10lu %12lu\n", op_names[op], histogram->no_calls,
+                histogram->total_ns / histogram->no_calls, percentile(histogram, 0.5), percentile(histogram, 0.9),
+                percentile(histogram, 0.99), percentile(histogram, 0.999), histogram->max_ns);
+    }
+}
+
+static void dump_json(profile_t *profile, FILE *out)
+{
+    bool first_op = true;
+    fprintf(out, "{\"unit\": \"ns\", \"operations\": {");
+    for(int op = 0; op < No_profiled_ops; ++op)
+    {
+        histogram_t *histogram = &profile->ops[op];
+        if(histogram->no_calls == 0)
+        {
+            continue;
+        }
+        fprintf(out, "%s\n  \"%s\": {\"calls\": %lu, \"total\": %lu, \"min\": %lu, \"mean\": %lu, \"p50\": %lu, "
+                "\"p90\": %lu, \"p99\": %lu, \"p99.9\": %lu, \"max\": %lu,\n    \"buckets\": [", first_op ? "" : ",",
+                op_names[op], histogram->no_calls, histogram->total_ns, histogram->min_ns,
+                histogram->total_ns / histogram->no_calls, percentile(histogram, 0.5), percentile(histogram, 0.9),
+                percentile(histogram, 0.99), percentile(histogram, 0.999), histogram->max_ns);
+        
+        bool first_bucket = true;
+        for(int bucket = 0; bucket < No_buckets; ++bucket)
+        {
+            if(histogram->counts[bucket] > 0)     //[largest latency of the bucket, calls in it]
+            {
+                fprintf(out, "%s[%lu, %lu]", first_bucket ? "" : ", ", bucket_limit(bucket), histogram->counts[bucket]);
+                first_bucket = false;
+            }
+        }
+        fprintf(out, "]}");
+        first_op = false;
+    }
+    fprintf(out, "\n}}\n");
+}
+
+bool bl_profile_dump(db_t *db, FILE *out, bool json)
+{
+    if(json)
+    {
+        dump_json(db->profile, out);
+    }
+    else
+    {
+        dump_text(db->profile, out);
+    }
+    return true;
+}
+
+#else
+
+bool bl_profile_dump(db_t *db, FILE *out, bool json)
+{
+    return false; //Nothing is recorded
+}
+
+void bl_profile_reset(db_t *db)
+{
+}
+
+#endif
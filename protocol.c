@@ -0,0 +1,71 @@
+#include "headers/protocol.h"
+
+static void put_u32(char *buf, uint32_t value)
+{
+    for(int i = 0; i < 4; ++i)
+    {
+        buf[i] = (char) (value >> (8 * i));
+    }
+}
+
+static uint32_t get_u32(char *buf)
+{
+    uint32_t value = 0;
+    for(int i = 0; i < 4; ++i)
+    {
+        value |= (uint32_t) (uint8_t) buf[i] << (8 * i);
+    }
+    return value;
+}
+
+size_t max_request_size(operation_t *op)
+{
+    return Request_header_size + max_encoded_size(op);
+}
+
+size_t encode_request(char *buf, uint32_t tag, operation_t *op)
+{
+    size_t length = encode_operation(op, buf + Request_header_size);
+    put_u32(buf, length + 4);
+    put_u32(buf + 4, tag);
+    return Request_header_size + length;
+}
+
+long decode_request(char *buf, size_t length, uint32_t *tag, operation_t *op)
+{
+    if(length < 4)
+    {
+        return 0;
+    }
+    uint32_t rest = get_u32(buf);
+    if(rest < 4 || rest > Max_request_size)
+    {
+        return -1;
+    }
+    if(length < 4 + rest)
+    {
+        return 0;
+    }
+    
+    *tag = get_u32(buf + 4);
+    size_t op_length = rest - 4;
+    if(decode_operation(buf + Request_header_size, op_length, op) != op_length)
+    {
+        return -1; //Not an operation, or one followed by something else
+    }
+    return 4 + rest;
+}
+
+void encode_response(char *buf, uint32_t tag, bool succeeded, int result)
+{
+    put_u32(buf, tag);
+    buf[4] = succeeded ? 1 : 0;
+    put_u32(buf + 5, (uint32_t) result);
+}
+
+void decode_response(char *buf, uint32_t *tag, bool *succeeded, int *result)
+{
+    *tag = get_u32(buf);
+    *succeeded = buf[4] == 1;
+    *result = (int) get_u32(buf + 5);
+}
@@ -1,13 +0,0 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-static int cmpstringp(const void *p1, const void *p2)
-{
-    return strcmp(* (char * const *) p1, * (char * const *) p2);
-}
-
-void sort_keys(char *keys[], size_t no_keys)
-{
-    qsort(keys, no_keys, sizeof(char *), cmpstringp);
-}
\ No newline at end of file
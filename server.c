@@ -0,0 +1,416 @@
+#include "headers/business_logic.h"
+#include "headers/protocol.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// Serves a store over a Unix domain socket or loopback TCP, see protocol.h for the protocol.
+// One thread runs an epoll loop over all connections, so the store is only ever used by it.
+// Each turn of the loop reads everything the ready connections have sent and applies every
+// complete request in it. The responses are buffered and only written at the end of the turn,
+// one write per connection. If the store is kept on disk, commits are deferred and the whole
+// turn is committed with one sync before any response goes out, so a response still means the
+// change is durable. If the commit fails, every response of the turn reports failure.
+//
+// With -e, carts that have not been changed for that many ms expire. The loop then wakes up at
+// least every Expiry_period ms to remove them, and their removal is committed with the next turn.
+//
+// Usage: server [-s store_dir] [-u socket_path | -t port] [-e cart_timeout_ms]
+// Stops on SIGINT or SIGTERM and prints how many requests it served. Built with -DBL_PROFILE
+// (make server_profile), it writes the latencies of the bl_* calls as JSON to stderr on SIGUSR1
+// and as a table when it stops, see bl_profile_dump.
+
+#define Default_socket_path "webstore.sock"
+#define Max_events          64
+#define Read_size           (64 << 10)
+#define Expiry_period       100     //Most ms an expired cart is kept while the server is idle
+
+typedef struct connection connection_t;
+typedef struct server server_t;
+
+struct connection
+{
+    int             fd;
+    char            *in;            //Received and not yet applied, the last request may be incomplete
+    size_t          in_used;
+    size_t          in_capacity;
+    char            *out;           //Responses not yet written
+    size_t          out_used;
+    size_t          out_sent;
+    size_t          out_committed;  //Responses before this are committed and may be written
+    size_t          out_capacity;
+    bool            waiting_to_write;   //Registered for EPOLLOUT because the socket was full
+    bool            closed;         //The client is gone or broke the protocol, close once the turn is over
+    bool            in_turn;        //On the ready list of the turn in progress
+    connection_t    *next_ready;    //Next connection with responses this turn
+};
+
+struct server
+{
+    db_t            *db;
+    int             listen_fd;
+    int             epoll_fd;
+    int             cart_timeout_ms;    //0 if carts do not expire
+    connection_t    *ready;         //Connections with responses to write at the end of the turn
+    unsigned long   no_requests;
+    unsigned long   no_turns;       //Turns that applied at least one request
+    unsigned long   no_connections;
+};
+
+static volatile sig_atomic_t stopping = 0;
+static volatile sig_atomic_t dumping = 0;
+
+static void stop(int signal_no)
+{
+    stopping = 1;
+}
+
+static void dump(int signal_no)
+{
+    dumping = 1;
+}
+
+static bool set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+/*=================================================================
+ *  Listening
+ *=================================================================*/
+
+static int listen_unix(char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if(strlen(path) >= sizeof(addr.sun_path))
+    {
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);   //Left behind by an earlier server
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        return -1;
+    }
+    return fd;
+}
+
+static int listen_tcp(int port)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int reuse = 1;
+    
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0
+       || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        return -1;
+    }
+    return fd;
+}
+
+static void accept_connections(server_t *server)
+{
+    int fd;
+    while((fd = accept(server->listen_fd, NULL, NULL)) >= 0)
+    {
+        int no_delay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));   //Fails harmlessly on Unix sockets
+        set_nonblocking(fd);
+        
+        connection_t *conn = calloc(1, sizeof(connection_t));
+        conn->fd            = fd;
+        conn->in_capacity   = Read_size;
+        conn->in            = malloc(conn->in_capacity);
+        conn->out_capacity  = Read_size;
+        conn->out           = malloc(conn->out_capacity);
+        
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = conn };
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+        server->no_connections += 1;
+    }
+}
+
+static void close_connection(server_t *server, connection_t *conn)
+{
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    free(conn->in);
+    free(conn->out);
+    free(conn);
+}
+
+/*=================================================================
+ *  Requests
+ *=================================================================*/
+
+static void add_response(connection_t *conn, uint32_t tag, bool succeeded, int result)
+{
+    if(conn->out_used + Response_size > conn->out_capacity)
+    {
+        conn->out_capacity *= 2;
+        conn->out = realloc(conn->out, conn->out_capacity);
+    }
+    encode_response(conn->out + conn->out_used, tag, succeeded, result);
+    conn->out_used += Response_size;
+}
+
+//Applies every complete request in the input of conn, returns false if one is invalid
+static bool apply_requests(server_t *server, connection_t *conn)
+{
+    size_t offset = 0;
+    long used;
+    uint32_t tag;
+    operation_t op;
+    
+    while((used = decode_request(conn->in + offset, conn->in_used - offset, &tag, &op)) > 0)
+    {
+        int result = 0;
+        bool succeeded = apply_operation(server->db, &op, &result);
+        add_response(conn, tag, succeeded, result);
+        server->no_requests += 1;
+        offset += used;
+    }
+    
+    memmove(conn->in, conn->in + offset, conn->in_used - offset);   //Keep the start of an incomplete request
+    conn->in_used -= offset;
+    return used == 0;
+}
+
+static void read_requests(server_t *server, connection_t *conn)
+{
+    while(true)
+    {
+        if(conn->in_used == conn->in_capacity)
+        {
+            conn->in_capacity *= 2;
+            conn->in = realloc(conn->in, conn->in_capacity);
+        }
+        
+        ssize_t received = read(conn->fd, conn->in + conn->in_used, conn->in_capacity - conn->in_used);
+        if(received > 0)
+        {
+            conn->in_used += received;
+            continue;
+        }
+        if(received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        conn->closed = received == 0 || errno != EAGAIN;  //The client hung up, or the connection broke
+        break;
+    }
+    
+    if(!apply_requests(server, conn))
+    {
+        conn->closed = true;
+    }
+    if(!conn->in_turn && (conn->out_used > conn->out_committed || conn->closed))
+    {
+        conn->in_turn = true;
+        conn->next_ready = server->ready;
+        server->ready = conn;
+    }
+}
+
+//Returns false if the connection broke
+static bool write_responses(server_t *server, connection_t *conn)
+{
+    while(conn->out_sent < conn->out_committed)
+    {
+        ssize_t sent = write(conn->fd, conn->out + conn->out_sent, conn->out_committed - conn->out_sent);
+        if(sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(sent < 0 && errno == EAGAIN)
+        {
+            break; //The rest goes out when the socket has room
+        }
+        if(sent < 0)
+        {
+            return false;
+        }
+        conn->out_sent += sent;
+    }
+    
+    bool all_sent = conn->out_sent == conn->out_committed;   //Responses of the turn in progress wait for its commit
+    if(conn->out_sent == conn->out_used)
+    {
+        conn->out_sent = 0;
+        conn->out_used = 0;
+        conn->out_committed = 0;
+    }
+    if(all_sent == conn->waiting_to_write)
+    {
+        conn->waiting_to_write = !all_sent;
+        struct epoll_event event = { .events = EPOLLIN | (all_sent ? 0 : EPOLLOUT), .data.ptr = conn };
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+    }
+    return true;
+}
+
+//Turns the responses of the turn in progress into failures, when its changes may be lost
+static void fail_responses(connection_t *conn)
+{
+    for(size_t offset = conn->out_committed; offset < conn->out_used; offset += Response_size)
+    {
+        uint32_t tag;
+        bool succeeded;
+        int result;
+        decode_response(conn->out + offset, &tag, &succeeded, &result);
+        encode_response(conn->out + offset, tag, false, result);
+    }
+}
+
+//Ends a turn: makes its changes durable, then writes its responses
+static void finish_turn(server_t *server)
+{
+    if(server->ready == NULL)
+    {
+        return;
+    }
+    bool committed = bl_commit(server->db);
+    server->no_turns += 1;
+    
+    while(server->ready != NULL)
+    {
+        connection_t *conn = server->ready;
+        server->ready = conn->next_ready;
+        conn->in_turn = false;
+        if(!committed)
+        {
+            fail_responses(conn);   //Reads of the turn may also have seen the lost changes
+        }
+        conn->out_committed = conn->out_used;
+        if(!write_responses(server, conn) || (conn->closed && !conn->waiting_to_write))
+        {
+            close_connection(server, conn);
+        }
+    }
+}
+
+static void serve(server_t *server)
+{
+    struct epoll_event events[Max_events];
+    int timeout = server->cart_timeout_ms > 0 ? Expiry_period : -1;
+    while(!stopping)
+    {
+        int no_events = epoll_wait(server->epoll_fd, events, Max_events, timeout);
+        for(int i = 0; i < no_events; ++i)
+        {
+            connection_t *conn = events[i].data.ptr;
+            if(conn == NULL)
+            {
+                accept_connections(server);
+            }
+            else if(events[i].events & EPOLLOUT)
+            {
+                if(!write_responses(server, conn) || (conn->closed && !conn->waiting_to_write))
+                {
+                    close_connection(server, conn);
+                }
+            }
+            else
+            {
+                read_requests(server, conn);
+            }
+        }
+        if(server->cart_timeout_ms > 0)
+        {
+            bl_expire_carts(server->db);
+        }
+        finish_turn(server);
+        if(dumping)
+        {
+            dumping = 0;
+            bl_profile_dump(server->db, stderr, true);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    char *store_dir = NULL;
+    char *socket_path = Default_socket_path;
+    int port = 0;
+    int cart_timeout_ms = 0;
+    for(int i = 1; i + 1 < argc; i += 2)
+    {
+        if(strcmp(argv[i], "-s") == 0)
+        {
+            store_dir = argv[i + 1];
+        }
+        else if(strcmp(argv[i], "-u") == 0)
+        {
+            socket_path = argv[i + 1];
+        }
+        else if(strcmp(argv[i], "-t") == 0)
+        {
+            port = atoi(argv[i + 1]);
+        }
+        else if(strcmp(argv[i], "-e") == 0)
+        {
+            cart_timeout_ms = atoi(argv[i + 1]);
+        }
+    }
+    if(argc % 2 == 0)
+    {
+        fprintf(stderr, "usage: server [-s store_dir] [-u socket_path | -t port] [-e cart_timeout_ms]\n");
+        return 1;
+    }
+    
+    server_t server = { 0 };
+    server.listen_fd = port > 0 ? listen_tcp(port) : listen_unix(socket_path);
+    if(server.listen_fd < 0 || !set_nonblocking(server.listen_fd))
+    {
+        perror("could not listen");
+        return 1;
+    }
+    server.db = store_dir ? bl_open_store(store_dir) : create_webstore();
+    if(server.db == NULL)
+    {
+        fprintf(stderr, "could not open %s\n", store_dir);
+        return 1;
+    }
+    bl_defer_commits(server.db, true);
+    bl_set_cart_timeout(server.db, cart_timeout_ms);
+    server.cart_timeout_ms = cart_timeout_ms;
+    
+    server.epoll_fd = epoll_create1(0);
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, server.listen_fd, &event);
+    
+    struct sigaction action = { .sa_handler = stop };     //No SA_RESTART, so epoll_wait is interrupted
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    struct sigaction dump_action = { .sa_handler = dump };
+    sigaction(SIGUSR1, &dump_action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    
+    serve(&server);
+    
+    printf("served %lu requests on %lu connections in %lu turns, %.1f requests per turn\n", server.no_requests,
+           server.no_connections, server.no_turns, server.no_turns ? (double) server.no_requests / server.no_turns : 0.0);
+    bl_profile_dump(server.db, stdout, false);
+    close(server.epoll_fd);
+    close(server.listen_fd);
+    if(port == 0)
+    {
+        unlink(socket_path);
+    }
+    destroy_webstore(server.db);
+    return 0;
+}
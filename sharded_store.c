@@ -0,0 +1,497 @@
+#define _GNU_SOURCE     //For pthread_setaffinity_np
+#include "headers/sharded_store.h"
+#include "headers/business_logic_internal.h"
+#include "headers/generic_utils.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <unistd.h>
+
+// How operations are routed, by kind:
+//  - merch and stock operations go to the shard of the merch. A merch lives on the shard its name
+//    hashes to, unless it was renamed: it then stays where it was and sdb->moved says where that is.
+//  - create_cart is done by the calling thread, which hands out the cart ids. A cart is split in
+//    parts, one on every shard it has merch from, made when its first item there is added. The
+//    calling thread knows which shards a cart has parts on, the shards know the ids of the parts.
+//  - calculate_cost, checkout and remove_cart go to every shard the cart has a part on. Everything
+//    in a cart is reserved when it is added, so no part of a checkout can fail: once the calling
+//    thread has sent the checkout to the shards it is done, and every shard runs its part before
+//    anything sent to it later. That makes a checkout across shards one transaction.
+//  - a rename must know that no shard has the new name, so it waits for the shards to run
+//    everything sent before it and then looks at them itself.
+// Shelves are shared, a shelf holds one merch whatever shard it is on. The shards claim the
+// shelves they stock in a registry they share, see claim_shelf.
+//
+// The shards run the operations sent to each of them in order, but not in step with each other.
+// Only two merch on different shards contending for one shelf can tell: the first to claim it
+// gets it, whatever order the operations were given in.
+
+#define Max_shards          64      //The shards a cart has parts on are kept in 64 bits
+#define Queue_capacity      4096
+#define Spins_before_sleep  2000
+#define Registry_stripes    64
+
+typedef struct shard shard_t;
+typedef struct task task_t;
+typedef struct sharded_cart sharded_cart_t;
+typedef struct registry_stripe registry_stripe_t;
+
+struct task
+{
+    operation_t     op;             //cart_id is the id given by bl_sharded_apply_batch
+    bool            *succeeded;
+    int             *result;
+    atomic_int      cost;           //Sum of the costs of the parts of a cart, for calculate_cost
+};
+
+struct sharded_cart
+{
+    uint64_t        shards;         //Bit i is set if the cart may have a part on shard i
+};
+
+struct registry_stripe
+{
+    pthread_mutex_t     lock;
+    ioopm_hash_table_t  *owners;    //shelf id => shard number
+};
+
+struct shelf_registry
+{
+    registry_stripe_t   stripes[Registry_stripes];
+};
+
+struct shard
+{
+    db_t                *db;
+    sharded_db_t        *sdb;
+    ioopm_spsc_queue_t  *queue;         //Tasks from the calling thread, a NULL task stops the worker
+    ioopm_hash_table_t  *carts;         //cart id => id of the part of the cart in db
+    atomic_bool         sleeping;       //The worker waits on wake, only set and cleared holding lock
+    pthread_mutex_t     lock;
+    pthread_cond_t      wake;
+    pthread_t           thread;
+};
+
+struct sharded_db
+{
+    shard_t             *shards;
+    int                 no_shards;
+    shelf_registry_t    registry;
+    ioopm_hash_table_t  *moved;         //Name of a renamed merch => its shard, if not the one its name hashes to
+    ioopm_slot_map_t    *carts;         //cart id => sharded_cart_t *
+    atomic_long         pending;        //Tasks sent to the shards and not yet run
+};
+
+static bool name_eq(elem_t a, elem_t b)
+{
+    return strcmp(a.str_val, b.str_val) == 0;
+}
+
+static int name_hash(elem_t key)
+{
+    return string_knr_hash(key) + 1;
+}
+
+/*=================================================================
+ *  Shelf registry
+ *=================================================================*/
+
+static registry_stripe_t *get_stripe(db_t *db, int shelf_id)
+{
+    return &db->shelves->stripes[(unsigned int) shelf_id % Registry_stripes];
+}
+
+bool claim_shelf(db_t *db, int shelf_id)
+{
+    registry_stripe_t *stripe = get_stripe(db, shelf_id);
+    elem_t owner;
+    
+    pthread_mutex_lock(&stripe->lock);
+    bool claimed = !ioopm_hash_table_lookup(stripe->owners, int_elem(shelf_id), &owner);
+    if(claimed)
+    {
+        ioopm_hash_table_insert(stripe->owners, int_elem(shelf_id), int_elem(db->shard_no));
+    }
+    pthread_mutex_unlock(&stripe->lock);
+    return claimed || owner.int_val == db->shard_no;
+}
+
+void release_shelf(db_t *db, int shelf_id)
+{
+    registry_stripe_t *stripe = get_stripe(db, shelf_id);
+    elem_t ignored;
+    
+    pthread_mutex_lock(&stripe->lock);
+    ioopm_hash_table_remove(stripe->owners, int_elem(shelf_id), &ignored);
+    pthread_mutex_unlock(&stripe->lock);
+}
+
+/*=================================================================
+ *  Shards
+ *=================================================================*/
+
+static void run_task(shard_t *shard, task_t *task)
+{
+    operation_t op = task->op;
+    elem_t part;
+    int cost;
+    
+    switch(op.kind)
+    {
+        case Op_add_to_cart:
+            if(!ioopm_hash_table_lookup(shard->carts, int_elem(op.cart_id), &part))
+            {
+                part = int_elem(bl_create_cart(shard->db));    //The first item of the cart on this shard
+                if(part.int_val == 0)
+                {
+                    *task->succeeded = false;
+                    break;
+                }
+                ioopm_hash_table_insert(shard->carts, int_elem(op.cart_id), part);
+            }
+            *task->succeeded = bl_add_to_cart(shard->db, part.int_val, op.name, op.amount);
+            break;
+        case Op_remove_from_cart:
+            *task->succeeded = ioopm_hash_table_lookup(shard->carts, int_elem(op.cart_id), &part)
+                               && bl_remove_from_cart(shard->db, part.int_val, op.name, op.amount);
+            break;
+        case Op_calculate_cost:
+            if(ioopm_hash_table_lookup(shard->carts, int_elem(op.cart_id), &part) && bl_calculate_cost(shard->db, part.int_val, &cost))
+            {
+                atomic_fetch_add(&task->cost, cost);
+            }
+            break;
+        case Op_checkout:
+        case Op_remove_cart:
+            if(ioopm_hash_table_remove(shard->carts, int_elem(op.cart_id), &part))
+            {
+                op.cart_id = part.int_val;
+                apply_operation(shard->db, &op, NULL);  //Cannot fail, see the top of the file
+            }
+            break;
+        default:
+            *task->succeeded = apply_operation(shard->db, &op, task->result);
+            break;
+    }
+}
+
+static void *shard_worker(void *arg)
+{
+    shard_t *shard = arg;
+    elem_t task;
+    int idle = 0;
+    
+    while(true)
+    {
+        if(ioopm_spsc_queue_pop(shard->queue, &task))
+        {
+            if(task.ptr_val == NULL)
+            {
+                return NULL;
+            }
+            run_task(shard, task.ptr_val);
+            atomic_fetch_sub_explicit(&shard->sdb->pending, 1, memory_order_release);   //Publishes what the task did
+            idle = 0;
+        }
+        else if(++idle >= Spins_before_sleep)
+        {
+            pthread_mutex_lock(&shard->lock);
+            atomic_store(&shard->sleeping, true);
+            while(atomic_load(&shard->sleeping) && ioopm_spsc_queue_is_empty(shard->queue))
+            {
+                pthread_cond_wait(&shard->wake, &shard->lock);
+            }
+            atomic_store(&shard->sleeping, false);
+            pthread_mutex_unlock(&shard->lock);
+            idle = 0;
+        }
+    }
+}
+
+static void wake_shard(shard_t *shard)
+{
+    pthread_mutex_lock(&shard->lock);
+    atomic_store(&shard->sleeping, false);
+    pthread_cond_signal(&shard->wake);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+static void send_task(shard_t *shard, task_t *task)
+{
+    if(task != NULL)
+    {
+        atomic_fetch_add_explicit(&shard->sdb->pending, 1, memory_order_relaxed);
+    }
+    while(!ioopm_spsc_queue_push(shard->queue, ptr_elem(task)))
+    {
+        wake_shard(shard);
+        sched_yield();  //The queue is full, let the shard catch up
+    }
+    
+    atomic_thread_fence(memory_order_seq_cst);  //The worker checks the queue after it sets sleeping
+    if(atomic_load(&shard->sleeping))
+    {
+        wake_shard(shard);
+    }
+}
+
+static void wait_for_shards(sharded_db_t *sdb)
+{
+    while(atomic_load_explicit(&sdb->pending, memory_order_acquire) > 0)
+    {
+        sched_yield();
+    }
+}
+
+static void start_shard(sharded_db_t *sdb, int shard_no)
+{
+    shard_t *shard = &sdb->shards[shard_no];
+    shard->db           = create_webstore();
+    shard->db->shelves  = &sdb->registry;
+    shard->db->shard_no = shard_no;
+    shard->sdb          = sdb;
+    shard->queue        = ioopm_spsc_queue_create(Queue_capacity);
+    shard->carts        = ioopm_hash_table_create(int_key_eq, false, int_knr_hash);
+    atomic_init(&shard->sleeping, false);
+    pthread_mutex_init(&shard->lock, NULL);
+    pthread_cond_init(&shard->wake, NULL);
+    pthread_create(&shard->thread, NULL, shard_worker, shard);
+    
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(shard_no % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+    pthread_setaffinity_np(shard->thread, sizeof(cpus), &cpus);  //Keeps the shard in the caches of one core
+}
+
+static void stop_shard(shard_t *shard)
+{
+    send_task(shard, NULL);
+    pthread_join(shard->thread, NULL);
+    destroy_webstore(shard->db);
+    ioopm_hash_table_destroy(&shard->carts);
+    ioopm_spsc_queue_destroy(&shard->queue);
+    pthread_mutex_destroy(&shard->lock);
+    pthread_cond_destroy(&shard->wake);
+}
+
+sharded_db_t *bl_create_sharded(int no_shards)
+{
+    if(no_shards < 1)
+    {
+        no_shards = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    
+    sharded_db_t *sdb = calloc(1, sizeof(sharded_db_t));
+    sdb->no_shards  = no_shards < Max_shards ? no_shards : Max_shards;
+    sdb->shards     = calloc(sdb->no_shards, sizeof(shard_t));
+    sdb->moved      = ioopm_hash_table_create(name_eq, false, name_hash);
+    sdb->carts      = ioopm_slot_map_create();
+    atomic_init(&sdb->pending, 0);
+    for(int i = 0; i < Registry_stripes; ++i)
+    {
+        pthread_mutex_init(&sdb->registry.stripes[i].lock, NULL);
+        sdb->registry.stripes[i].owners = ioopm_hash_table_create(int_key_eq, false, int_knr_hash);
+    }
+    
+    for(int i = 0; i < sdb->no_shards; ++i)
+    {
+        start_shard(sdb, i);
+    }
+    return sdb;
+}
+
+static void free_moved_name(ioopm_hash_table_t *ht, elem_t name, elem_t shard_no, void *extra)
+{
+    free(name.str_val);
+}
+
+static void free_cart(int cart_id, elem_t cart, void *extra)
+{
+    free(cart.ptr_val);
+}
+
+void bl_destroy_sharded(sharded_db_t *sdb)
+{
+    for(int i = 0; i < sdb->no_shards; ++i)
+    {
+        stop_shard(&sdb->shards[i]);
+    }
+    for(int i = 0; i < Registry_stripes; ++i)
+    {
+        pthread_mutex_destroy(&sdb->registry.stripes[i].lock);
+        ioopm_hash_table_destroy(&sdb->registry.stripes[i].owners);
+    }
+    
+    ioopm_hash_table_apply_to_all(sdb->moved, free_moved_name, NULL);
+    ioopm_hash_table_destroy(&sdb->moved);
+    ioopm_slot_map_apply_to_all(sdb->carts, free_cart, NULL);
+    ioopm_slot_map_destroy(&sdb->carts);
+    free(sdb->shards);
+    free(sdb);
+}
+
+/*=================================================================
+ *  Routing
+ *=================================================================*/
+
+static int hashed_shard(sharded_db_t *sdb, char *name)
+{
+    return string_knr_hash(str_elem(name)) % sdb->no_shards;
+}
+
+static int merch_shard(sharded_db_t *sdb, char *name)
+{
+    elem_t shard_no;
+    if(ioopm_hash_table_lookup(sdb->moved, str_elem(name), &shard_no))
+    {
+        return shard_no.int_val;
+    }
+    return hashed_shard(sdb, name);
+}
+
+static void forget_move(sharded_db_t *sdb, char *name)
+{
+    elem_t ignored, moved_name;
+    if(ioopm_hash_table_remove_w_key(sdb->moved, str_elem(name), &ignored, &moved_name))
+    {
+        free(moved_name.str_val);
+    }
+}
+
+static bool rename_merch(sharded_db_t *sdb, operation_t *op)
+{
+    wait_for_shards(sdb);   //The shards are idle until the next task is sent, so they may be read here
+    int from = merch_shard(sdb, op->name);
+    int to = merch_shard(sdb, op->new_name);
+    if(to != from && get_merch(sdb->shards[to].db, op->new_name) != NULL)
+    {
+        return false; //Another shard has a merch with the new name
+    }
+    if(!apply_operation(sdb->shards[from].db, op, NULL))
+    {
+        return false;
+    }
+    
+    forget_move(sdb, op->name);
+    forget_move(sdb, op->new_name);
+    if(hashed_shard(sdb, op->new_name) != from)
+    {
+        ioopm_hash_table_insert(sdb->moved, str_elem(strdup(op->new_name)), int_elem(from));
+    }
+    return true;
+}
+
+//Sends a cart operation to every shard the cart has a part on
+static void send_to_cart(sharded_db_t *sdb, task_t *task)
+{
+    elem_t cart;
+    if(!ioopm_slot_map_lookup(sdb->carts, task->op.cart_id, &cart))
+    {
+        return; //No such cart
+    }
+    
+    *task->succeeded = true;
+    uint64_t shards = ((sharded_cart_t *) cart.ptr_val)->shards;
+    for(int i = 0; i < sdb->no_shards; ++i)
+    {
+        if(shards & ((uint64_t) 1 << i))
+        {
+            send_task(&sdb->shards[i], task);
+        }
+    }
+    if(task->op.kind != Op_calculate_cost)
+    {
+        ioopm_slot_map_remove(sdb->carts, task->op.cart_id, &cart);
+        free(cart.ptr_val);
+    }
+}
+
+static void dispatch(sharded_db_t *sdb, task_t *task)
+{
+    operation_t *op = &task->op;
+    elem_t cart;
+    int shard_no;
+    
+    switch(op->kind)
+    {
+        case Op_create_cart:
+            cart = ptr_elem(calloc(1, sizeof(sharded_cart_t)));
+            *task->result = ioopm_slot_map_insert(sdb->carts, cart);
+            *task->succeeded = *task->result != 0;
+            if(!*task->succeeded)
+            {
+                free(cart.ptr_val);
+            }
+            return;
+        case Op_calculate_cost:
+        case Op_checkout:
+        case Op_remove_cart:
+            send_to_cart(sdb, task);
+            return;
+        case Op_add_to_cart:
+        case Op_remove_from_cart:
+            if(!ioopm_slot_map_lookup(sdb->carts, op->cart_id, &cart))
+            {
+                return; //No such cart
+            }
+            shard_no = merch_shard(sdb, op->name);
+            if(op->kind == Op_add_to_cart)
+            {
+                ((sharded_cart_t *) cart.ptr_val)->shards |= (uint64_t) 1 << shard_no;
+            }
+            send_task(&sdb->shards[shard_no], task);
+            return;
+        case Op_edit_merch:
+            if(strcmp(op->name, op->new_name) != 0)
+            {
+                *task->succeeded = rename_merch(sdb, op);
+                return;
+            }
+            break;
+        case Op_remove_merch:
+            shard_no = merch_shard(sdb, op->name);
+            forget_move(sdb, op->name); //Once it is run no shard has the name, whether it succeeds or not
+            send_task(&sdb->shards[shard_no], task);
+            return;
+        default:
+            break;
+    }
+    send_task(&sdb->shards[merch_shard(sdb, op->name)], task);
+}
+
+size_t bl_sharded_apply_batch(sharded_db_t *sdb, operation_t *ops, size_t no_ops, bool *succeeded, int *results)
+{
+    task_t *tasks = calloc(no_ops, sizeof(task_t));
+    for(size_t i = 0; i < no_ops; ++i)
+    {
+        tasks[i].op         = ops[i];
+        tasks[i].succeeded  = &succeeded[i];
+        tasks[i].result     = &results[i];
+        succeeded[i]        = false;
+        results[i]          = 0;
+        atomic_init(&tasks[i].cost, 0);
+        dispatch(sdb, &tasks[i]);
+    }
+    wait_for_shards(sdb);
+    
+    size_t no_succeeded = 0;
+    for(size_t i = 0; i < no_ops; ++i)
+    {
+        if(ops[i].kind == Op_calculate_cost && succeeded[i])
+        {
+            results[i] = atomic_load(&tasks[i].cost);
+        }
+        no_succeeded += succeeded[i] ? 1 : 0;
+    }
+    free(tasks);
+    return no_succeeded;
+}
+
+bool bl_sharded_apply(sharded_db_t *sdb, operation_t *op, int *result)
+{
+    bool succeeded;
+    int ignored_result;
+    bl_sharded_apply_batch(sdb, op, 1, &succeeded, result ? result : &ignored_result);
+    return succeeded;
+}
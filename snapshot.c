@@ -0,0 +1,705 @@
+#include "headers/business_logic_internal.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// A snapshot is one file laid out so it can be mapped and read in place:
+//
+//   | header | merch records | shelf records | cart slots | cart items | name index | shelf index | strings |
+//
+// Records refer to each other by index and to strings by offset from the start of the
+// strings section, so nothing in the file depends on where it is mapped. The cart slots are
+// the raw state of db->carts, so cart ids survive a save and load unchanged. The format is
+// native endian and is only read on the machine type that wrote it.
+//
+// Loading only reads the header and the carts. A merch is built from its record the first
+// time it is used: by name through the name index, an open addressing table of record
+// numbers, or by shelf through the shelf index, so stocking a shelf finds the merch that
+// holds it. Calls that read all merch build the rest first. Pages of merch that are never
+// used are never read, and descriptions are not copied, the merch point into the mapping.
+//
+// Every offset, index and count read from the file is checked before it is followed. The
+// indexes decide which record holds a name or a shelf, so a record they do not lead to, as
+// one that repeats a name, is left out instead of contradicting the store.
+
+#define Snapshot_magic      "WEBSTORE"
+#define Snapshot_version    3     //2 had no indexes and was loaded whole
+
+typedef struct snapshot_header snapshot_header_t;
+typedef struct snapshot_merch snapshot_merch_t;
+typedef struct snapshot_shelf snapshot_shelf_t;
+typedef struct snapshot_slot snapshot_slot_t;
+typedef struct snapshot_item snapshot_item_t;
+typedef struct snapshot_shelf_entry snapshot_shelf_entry_t;
+
+struct snapshot_header
+{
+    char        magic[8];
+    uint32_t    version;
+    int32_t     free_head;          //First free cart slot
+    int32_t     carts_created;
+    uint32_t    unused;
+    uint64_t    no_merch;
+    uint64_t    no_shelves;
+    uint64_t    no_slots;
+    uint64_t    no_items;
+    uint64_t    merch_offset;       //Offsets of the sections from the start of the file
+    uint64_t    shelves_offset;
+    uint64_t    slots_offset;
+    uint64_t    items_offset;
+    uint64_t    names_offset;       //Name index, names_size entries of a merch record index + 1, 0 if empty
+    uint64_t    names_size;         //A power of two, or 0 if there is no merch
+    uint64_t    shelf_index_offset; //Shelf index, shelf_index_size entries
+    uint64_t    shelf_index_size;   //A power of two, or 0 if there is no shelf
+    uint64_t    strings_offset;
+    uint64_t    file_size;
+};
+
+struct snapshot_merch
+{
+    uint64_t    name;               //Offsets into the strings section
+    uint64_t    desc;
+    uint64_t    first_shelf;        //Index of the first of this merch's shelf records
+    int32_t     price;
+    uint32_t    no_shelves;
+};
+
+struct snapshot_shelf
+{
+    int32_t     shelf_id;
+    int32_t     quantity;
+};
+
+struct snapshot_slot
+{
+    int32_t     generation;
+    int32_t     next_free;
+    uint32_t    live;
+    uint32_t    no_items;
+    uint64_t    first_item;         //Index of the first of this cart's item records
+};
+
+struct snapshot_item
+{
+    uint32_t    merch;              //Index of the merch record
+    int32_t     amount;
+};
+
+struct snapshot_shelf_entry
+{
+    int32_t     shelf_id;
+    uint32_t    merch;              //Index of the merch record that holds the shelf + 1, 0 if the entry is empty
+};
+
+struct snapshot
+{
+    char                    *base;          //The mapping
+    size_t                  size;
+    snapshot_header_t       *header;
+    snapshot_merch_t        *merch;
+    snapshot_shelf_t        *shelves;
+    uint32_t                *names;
+    snapshot_shelf_entry_t  *shelf_index;
+    char                    *strings;
+    uint64_t                strings_size;
+    unsigned char           *states;        //Record_* of each merch record
+    uint64_t                no_unbuilt;
+};
+
+#define Record_unbuilt  0
+#define Record_built    1
+#define Record_left_out 2   //Damaged, or not the one the indexes lead to
+
+//Hashes of names and shelves in the indexes, fixed by the format
+static uint32_t name_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;    //FNV-1a
+    for(; *name; ++name)
+    {
+        hash = (hash ^ (unsigned char) *name) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t shelf_hash(int32_t shelf_id)
+{
+    uint32_t hash = (uint32_t) shelf_id * 2654435761u;
+    return hash ^ (hash >> 16);
+}
+
+//Entries of an index for count keys, at most half of them used
+static uint64_t index_size(uint64_t count)
+{
+    uint64_t size = count > 0 ? 1 : 0;
+    while(size < 2 * count)
+    {
+        size *= 2;
+    }
+    return size;
+}
+
+/*=================================================================
+ *  Saving
+ *=================================================================*/
+
+typedef struct snapshot_writer snapshot_writer_t;
+
+struct snapshot_writer
+{
+    FILE        *file;
+    uint64_t    strings_size;
+    uint64_t    no_shelves;
+    uint64_t    no_items;
+    snapshot_shelf_entry_t *shelf_index;
+    uint64_t    shelf_index_size;
+};
+
+static uint64_t align8(uint64_t offset)
+{
+    return (offset + 7) & ~(uint64_t) 7;
+}
+
+static void write_padding(FILE *file, uint64_t from, uint64_t to)
+{
+    static const char zeros[8] = { 0 };
+    fwrite(zeros, 1, to - from, file);
+}
+
+static void write_merch(snapshot_writer_t *writer, merch_t *merch)
+{
+    snapshot_merch_t record = { 0 };
+    record.name         = writer->strings_size;
+    record.desc         = record.name + strlen(merch->name) + 1;
+    record.first_shelf  = writer->no_shelves;
+    record.price        = merch_price(merch);
+    record.no_shelves   = ioopm_hash_table_size(merch->locs);
+    
+    writer->strings_size = record.desc + strlen(merch->desc) + 1;
+    writer->no_shelves  += record.no_shelves;
+    fwrite(&record, sizeof(record), 1, writer->file);
+}
+
+static void write_shelves(snapshot_writer_t *writer, merch_t *merch)
+{
+    uint64_t mask = writer->shelf_index_size - 1;
+    ioopm_list_t *shelves = ioopm_hash_table_values(merch->locs);
+    ioopm_list_iterator_t *iter = ioopm_list_iterator(shelves);
+    elem_t res;
+    
+    bool has_next = ioopm_iterator_current(iter, &res);
+    while(has_next)
+    {
+        shelf_t *shelf = res.ptr_val;
+        snapshot_shelf_t record = { .shelf_id = shelf->shelf_id, .quantity = shelf->quantity };
+        fwrite(&record, sizeof(record), 1, writer->file);
+        
+        uint64_t i = shelf_hash(shelf->shelf_id) & mask;
+        while(writer->shelf_index[i].merch != 0)
+        {
+            i = (i + 1) & mask;
+        }
+        writer->shelf_index[i] = (snapshot_shelf_entry_t) { .shelf_id = shelf->shelf_id, .merch = merch->id + 1 };
+        has_next = ioopm_iterator_next(iter, &res);
+    }
+    
+    ioopm_iterator_destroy(&iter);
+    ioopm_linked_list_destroy(shelves);
+}
+
+static void write_name_index(snapshot_writer_t *writer, merch_t **records, uint64_t no_merch, uint64_t size)
+{
+    uint32_t *index = calloc(size, sizeof(uint32_t));
+    uint64_t mask = size - 1;
+    for(uint64_t r = 0; r < no_merch; ++r)
+    {
+        uint64_t i = name_hash(records[r]->name) & mask;
+        while(index[i] != 0)
+        {
+            i = (i + 1) & mask;
+        }
+        index[i] = r + 1;
+    }
+    fwrite(index, sizeof(uint32_t), size, writer->file);
+    free(index);
+}
+
+//Items refer to merch by index in the snapshot, which is the merch id
+static void write_items(snapshot_writer_t *writer, db_t *db, cart_t *cart)
+{
+    ioopm_list_t *names = ioopm_hash_table_keys(cart->items);
+    ioopm_list_t *amounts = ioopm_hash_table_values(cart->items);
+    ioopm_list_iterator_t *name_iter = ioopm_list_iterator(names);
+    ioopm_list_iterator_t *amount_iter = ioopm_list_iterator(amounts);
+    elem_t name, amount, index;
+    
+    bool has_next = ioopm_iterator_current(name_iter, &name) && ioopm_iterator_current(amount_iter, &amount);
+    while(has_next)
+    {
+        ioopm_hash_table_lookup(db->merch, name, &index);
+        snapshot_item_t record = { .merch = index.int_val, .amount = amount.int_val };
+        fwrite(&record, sizeof(record), 1, writer->file);
+        has_next = ioopm_iterator_next(name_iter, &name) && ioopm_iterator_next(amount_iter, &amount);
+    }
+    
+    ioopm_iterator_destroy(&name_iter);
+    ioopm_iterator_destroy(&amount_iter);
+    ioopm_linked_list_destroy(names);
+    ioopm_linked_list_destroy(amounts);
+}
+
+//Writes the snapshot of db to file, which is open at its start
+static bool write_sections(db_t *db, FILE *file)
+{
+    load_snapshot_merch(db);       //Merch not yet built from the snapshot the store was loaded from
+    snapshot_writer_t writer = { .file = file };
+    snapshot_header_t header = { .magic = Snapshot_magic, .version = Snapshot_version };
+    merch_t **records = db->columns.records;
+    
+    header.no_merch         = db->columns.size;
+    header.no_slots         = ioopm_slot_map_no_slots(db->carts);
+    header.free_head        = ioopm_slot_map_free_head(db->carts);
+    header.carts_created    = db->carts_created;
+    header.merch_offset     = align8(sizeof(header));
+    fwrite(&header, sizeof(header), 1, file);       //Written again once the offsets are known
+    write_padding(file, sizeof(header), header.merch_offset);
+    
+    for(size_t i = 0; i < header.no_merch; ++i)
+    {
+        write_merch(&writer, records[i]);
+    }
+    header.no_shelves       = writer.no_shelves;
+    header.shelves_offset   = header.merch_offset + header.no_merch * sizeof(snapshot_merch_t);
+    
+    writer.shelf_index_size = index_size(header.no_shelves);
+    writer.shelf_index      = calloc(writer.shelf_index_size, sizeof(snapshot_shelf_entry_t));
+    for(size_t i = 0; i < header.no_merch; ++i)
+    {
+        write_shelves(&writer, records[i]);
+    }
+    header.slots_offset     = header.shelves_offset + header.no_shelves * sizeof(snapshot_shelf_t);
+    
+    for(size_t i = 0; i < header.no_slots; ++i)
+    {
+        snapshot_slot_t record = { 0 };
+        int generation, next_free;
+        elem_t value;
+        record.live         = ioopm_slot_map_get_slot(db->carts, i, &generation, &next_free, &value);
+        record.generation   = generation;
+        record.next_free    = next_free;
+        record.first_item   = writer.no_items;
+        record.no_items     = record.live ? ioopm_hash_table_size(((cart_t *) value.ptr_val)->items) : 0;
+        writer.no_items    += record.no_items;
+        fwrite(&record, sizeof(record), 1, file);
+    }
+    header.no_items         = writer.no_items;
+    header.items_offset     = header.slots_offset + header.no_slots * sizeof(snapshot_slot_t);
+    
+    for(size_t i = 0; i < header.no_slots; ++i)
+    {
+        int generation, next_free;
+        elem_t value;
+        if(ioopm_slot_map_get_slot(db->carts, i, &generation, &next_free, &value))
+        {
+            write_items(&writer, db, value.ptr_val);
+        }
+    }
+    uint64_t items_end      = header.items_offset + header.no_items * sizeof(snapshot_item_t);
+    header.names_offset     = align8(items_end);
+    header.names_size       = index_size(header.no_merch);
+    write_padding(file, items_end, header.names_offset);
+    write_name_index(&writer, records, header.no_merch, header.names_size);
+    
+    uint64_t names_end      = header.names_offset + header.names_size * sizeof(uint32_t);
+    header.shelf_index_offset = align8(names_end);
+    header.shelf_index_size = writer.shelf_index_size;
+    write_padding(file, names_end, header.shelf_index_offset);
+    fwrite(writer.shelf_index, sizeof(snapshot_shelf_entry_t), writer.shelf_index_size, file);
+    free(writer.shelf_index);
+    header.strings_offset   = header.shelf_index_offset + header.shelf_index_size * sizeof(snapshot_shelf_entry_t);
+    
+    for(size_t i = 0; i < header.no_merch; ++i)
+    {
+        fwrite(records[i]->name, 1, strlen(records[i]->name) + 1, file);
+        fwrite(records[i]->desc, 1, strlen(records[i]->desc) + 1, file);
+    }
+    header.file_size        = header.strings_offset + writer.strings_size;
+    
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    return !ferror(file);
+}
+
+//Syncs the directory that holds path, so a file renamed into it stays there
+static bool sync_parent(char *path)
+{
+    char *copy = strdup(path);
+    int fd = open(dirname(copy), O_RDONLY | O_DIRECTORY);
+    free(copy);
+    if(fd < 0)
+    {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
+//The snapshot is written to path.tmp and renamed over path once it is on disk, so a crash or a
+//full disk partway through leaves the snapshot that was at path whole
+bool bl_save_snapshot(db_t *db, char *path)
+{
+    char *tmp_path = malloc(strlen(path) + sizeof(".tmp"));
+    sprintf(tmp_path, "%s.tmp", path);
+    FILE *file = fopen(tmp_path, "wb");
+    if(file == NULL)
+    {
+        free(tmp_path);
+        return false;
+    }
+    
+    bool written = write_sections(db, file);
+    written = (fflush(file) == 0) && (fsync(fileno(file)) == 0) && written;
+    written = (fclose(file) == 0) && written;
+    written = written && rename(tmp_path, path) == 0 && sync_parent(path);
+    if(!written)
+    {
+        unlink(tmp_path);       //Gone already if only the directory sync failed
+    }
+    free(tmp_path);
+    return written;
+}
+
+/*=================================================================
+ *  Loading
+ *=================================================================*/
+
+//Whether count records of record_size bytes fit between offset, which must be 8-aligned, and end
+static bool section_fits(uint64_t offset, uint64_t count, size_t record_size, uint64_t end)
+{
+    return offset % 8 == 0 && offset <= end && count <= (end - offset) / record_size;
+}
+
+//The sections must follow each other in the order they are written, all within the file. The
+//strings section must end in a NUL, so every string that starts in it also ends in it
+static bool valid_header(snapshot_header_t *header, size_t size)
+{
+    if(size < sizeof(snapshot_header_t)
+       || memcmp(header->magic, Snapshot_magic, sizeof(header->magic)) != 0
+       || header->version != Snapshot_version
+       || header->file_size != size)
+    {
+        return false;
+    }
+    
+    char *base = (char *) header;
+    return header->merch_offset >= sizeof(snapshot_header_t)
+        && section_fits(header->merch_offset, header->no_merch, sizeof(snapshot_merch_t), header->shelves_offset)
+        && section_fits(header->shelves_offset, header->no_shelves, sizeof(snapshot_shelf_t), header->slots_offset)
+        && section_fits(header->slots_offset, header->no_slots, sizeof(snapshot_slot_t), header->items_offset)
+        && section_fits(header->items_offset, header->no_items, sizeof(snapshot_item_t), header->names_offset)
+        && section_fits(header->names_offset, header->names_size, sizeof(uint32_t), header->shelf_index_offset)
+        && section_fits(header->shelf_index_offset, header->shelf_index_size, sizeof(snapshot_shelf_entry_t), header->strings_offset)
+        && (header->names_size & (header->names_size - 1)) == 0
+        && (header->shelf_index_size & (header->shelf_index_size - 1)) == 0
+        && header->strings_offset <= size
+        && (header->no_merch == 0 || (header->strings_offset < size && base[size - 1] == '\0'))
+        && header->no_merch <= INT_MAX
+        && header->no_slots <= INT_MAX;
+}
+
+//Checks that every index in the cart slots and items is in range, and that the free list only
+//passes free slots that are not retired and does not loop
+static bool valid_carts(snapshot_header_t *header, char *base)
+{
+    snapshot_slot_t *slot_records   = (snapshot_slot_t *) (base + header->slots_offset);
+    snapshot_item_t *item_records   = (snapshot_item_t *) (base + header->items_offset);
+    
+    for(size_t i = 0; i < header->no_slots; ++i)
+    {
+        snapshot_slot_t *record = &slot_records[i];
+        if(record->live > 1 || record->first_item > header->no_items || record->no_items > header->no_items - record->first_item)
+        {
+            return false;
+        }
+        if(!record->live && (record->no_items > 0 || record->next_free < -2 || record->next_free >= (int64_t) header->no_slots))
+        {
+            return false;
+        }
+        for(uint64_t j = record->first_item; j < record->first_item + record->no_items; ++j)
+        {
+            if(item_records[j].merch >= header->no_merch || item_records[j].amount < 1)
+            {
+                return false;
+            }
+        }
+    }
+    
+    int free_slot = header->free_head;
+    for(uint64_t steps = 0; free_slot != -1; ++steps)
+    {
+        if(free_slot < 0 || free_slot >= (int64_t) header->no_slots || steps == header->no_slots
+           || slot_records[free_slot].live || slot_records[free_slot].next_free == -2)
+        {
+            return false;
+        }
+        free_slot = slot_records[free_slot].next_free;
+    }
+    return true;
+}
+
+//The merch record the name index leads to for name, or -1 if it leads to none
+static int64_t find_name(snapshot_t *snapshot, const char *name)
+{
+    uint64_t size = snapshot->header->names_size;
+    uint64_t i = name_hash(name) & (size - 1);
+    for(uint64_t steps = 0; steps < size; ++steps, i = (i + 1) & (size - 1))
+    {
+        uint64_t entry = snapshot->names[i];
+        if(entry == 0)
+        {
+            return -1;
+        }
+        if(entry <= snapshot->header->no_merch)
+        {
+            snapshot_merch_t *record = &snapshot->merch[entry - 1];
+            if(record->name < snapshot->strings_size && strcmp(snapshot->strings + record->name, name) == 0)
+            {
+                return entry - 1;
+            }
+        }
+    }
+    return -1;
+}
+
+//The merch record the shelf index gives a shelf to, or -1 if it gives it to none
+static int64_t find_shelf(snapshot_t *snapshot, int shelf_id)
+{
+    uint64_t size = snapshot->header->shelf_index_size;
+    uint64_t i = shelf_hash(shelf_id) & (size - 1);
+    for(uint64_t steps = 0; steps < size; ++steps, i = (i + 1) & (size - 1))
+    {
+        snapshot_shelf_entry_t *entry = &snapshot->shelf_index[i];
+        if(entry->merch == 0)
+        {
+            return -1;
+        }
+        if(entry->shelf_id == shelf_id)
+        {
+            return entry->merch <= snapshot->header->no_merch ? (int64_t) entry->merch - 1 : -1;
+        }
+    }
+    return -1;
+}
+
+//Builds merch record r, which is not built yet. It is left out, and NULL returned, if it is
+//damaged, if the indexes do not lead to it, or if its name or one of its shelves is taken
+static merch_t *build_merch(db_t *db, uint64_t r)
+{
+    snapshot_t *snapshot = db->snapshot;
+    snapshot_merch_t *record = &snapshot->merch[r];
+    snapshot->states[r] = Record_left_out;     //Until it is built
+    snapshot->no_unbuilt -= 1;
+    
+    if(record->name >= snapshot->strings_size || record->desc >= snapshot->strings_size || record->price < 1
+       || record->first_shelf > snapshot->header->no_shelves
+       || record->no_shelves > snapshot->header->no_shelves - record->first_shelf
+       || find_name(snapshot, snapshot->strings + record->name) != (int64_t) r)
+    {
+        return NULL;
+    }
+    
+    snapshot_shelf_t *shelves = snapshot->shelves + record->first_shelf;
+    elem_t ignore_value;
+    long long stock = 0;
+    for(uint32_t s = 0; s < record->no_shelves; ++s)
+    {
+        stock += shelves[s].quantity;
+        if(!valid_shelf_id(shelves[s].shelf_id) || shelves[s].quantity < 0 || stock > INT_MAX
+           || find_shelf(snapshot, shelves[s].shelf_id) != (int64_t) r
+           || ioopm_hash_table_lookup(db->storage, int_elem(shelves[s].shelf_id), &ignore_value))
+        {
+            return NULL;
+        }
+    }
+    
+    char *name = ioopm_string_pool_intern(db->names, snapshot->strings + record->name);
+    if(ioopm_hash_table_lookup(db->merch, str_elem(name), &ignore_value))
+    {
+        ioopm_string_pool_release(db->names, name);
+        return NULL;
+    }
+    
+    merch_t *merch = create_merch(db, name, snapshot->strings + record->desc, record->price);
+    merch->owns_desc = false;       //It is in the mapping
+    insert_merch(db, merch);
+    snapshot->states[r] = Record_built;
+    for(uint32_t s = 0; s < record->no_shelves; ++s)
+    {
+        stock_shelf(db, merch, shelves[s].shelf_id, shelves[s].quantity);
+    }
+    return merch;
+}
+
+merch_t *load_snapshot_name(db_t *db, char *name)
+{
+    snapshot_t *snapshot = db->snapshot;
+    if(snapshot == NULL || snapshot->no_unbuilt == 0)
+    {
+        return NULL;
+    }
+    
+    int64_t r = find_name(snapshot, name);
+    return r >= 0 && snapshot->states[r] == Record_unbuilt ? build_merch(db, r) : NULL;
+}
+
+void load_snapshot_shelf(db_t *db, int shelf_id)
+{
+    snapshot_t *snapshot = db->snapshot;
+    if(snapshot == NULL || snapshot->no_unbuilt == 0)
+    {
+        return;
+    }
+    
+    int64_t r = find_shelf(snapshot, shelf_id);
+    if(r >= 0 && snapshot->states[r] == Record_unbuilt)
+    {
+        build_merch(db, r);
+    }
+}
+
+void load_snapshot_merch(db_t *db)
+{
+    snapshot_t *snapshot = db->snapshot;
+    if(snapshot == NULL || snapshot->no_unbuilt == 0)
+    {
+        return;
+    }
+    
+    ioopm_hash_table_reserve(db->merch, ioopm_hash_table_size(db->merch) + snapshot->no_unbuilt);
+    ioopm_hash_table_reserve(db->storage, ioopm_hash_table_size(db->storage) + snapshot->header->no_shelves);
+    for(uint64_t r = 0; r < snapshot->header->no_merch && snapshot->no_unbuilt > 0; ++r)
+    {
+        if(snapshot->states[r] == Record_unbuilt)
+        {
+            build_merch(db, r);
+        }
+    }
+}
+
+void close_snapshot(db_t *db)
+{
+    munmap(db->snapshot->base, db->snapshot->size);
+    free(db->snapshot->states);
+    free(db->snapshot);
+    db->snapshot = NULL;
+}
+
+//The merch of record r for a cart item, built if it is not yet. Nothing is renamed or removed
+//while the carts are loaded, so a built record still has its name
+static merch_t *item_merch(db_t *db, uint32_t r)
+{
+    snapshot_t *snapshot = db->snapshot;
+    if(snapshot->states[r] == Record_unbuilt)
+    {
+        return build_merch(db, r);
+    }
+    return snapshot->states[r] == Record_built ? get_merch(db, snapshot->strings + snapshot->merch[r].name) : NULL;
+}
+
+//Fills db->carts from the slots of a snapshot that passed valid_carts, building the merch in
+//them. Fails if an item is merch that is left out, or if more is reserved than there is
+static bool load_carts(db_t *db)
+{
+    snapshot_header_t *header       = db->snapshot->header;
+    snapshot_slot_t *slot_records   = (snapshot_slot_t *) (db->snapshot->base + header->slots_offset);
+    snapshot_item_t *item_records   = (snapshot_item_t *) (db->snapshot->base + header->items_offset);
+    
+    for(size_t i = 0; i < header->no_slots; ++i)
+    {
+        snapshot_slot_t *record = &slot_records[i];
+        cart_t *cart = record->live ? create_cart(db) : NULL;
+        int cart_id = ioopm_slot_map_set_slot(db->carts, i, record->generation, record->next_free, record->live, ptr_elem(cart));
+        if(cart_id == 0)
+        {
+            if(cart)
+            {
+                ioopm_hash_table_destroy(&cart->items);
+                free(cart);
+            }
+            return false;
+        }
+        if(record->live)
+        {
+            cart->cart_id = cart_id;
+            for(uint64_t j = record->first_item; j < record->first_item + record->no_items; ++j)
+            {
+                merch_t *merch = item_merch(db, item_records[j].merch);
+                if(merch == NULL || !reserve_stock(merch, item_records[j].amount))
+                {
+                    return false;
+                }
+                put_in_cart(cart, merch, item_records[j].amount);
+            }
+        }
+    }
+    ioopm_slot_map_set_free_head(db->carts, header->free_head);
+    return true;
+}
+
+db_t *bl_load_snapshot(char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        return NULL;
+    }
+    
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+    {
+        close(fd);
+        return NULL;
+    }
+    size_t size = file_stat.st_size;
+    char *base = size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(base == MAP_FAILED)
+    {
+        return NULL;
+    }
+    
+    snapshot_header_t *header = (snapshot_header_t *) base;
+    if(!valid_header(header, size) || !valid_carts(header, base))
+    {
+        munmap(base, size);
+        return NULL;
+    }
+    
+    snapshot_t *snapshot    = calloc(1, sizeof(snapshot_t));
+    snapshot->base          = base;
+    snapshot->size          = size;
+    snapshot->header        = header;
+    snapshot->merch         = (snapshot_merch_t *) (base + header->merch_offset);
+    snapshot->shelves       = (snapshot_shelf_t *) (base + header->shelves_offset);
+    snapshot->names         = (uint32_t *) (base + header->names_offset);
+    snapshot->shelf_index   = (snapshot_shelf_entry_t *) (base + header->shelf_index_offset);
+    snapshot->strings       = base + header->strings_offset;
+    snapshot->strings_size  = header->file_size - header->strings_offset;
+    snapshot->states        = calloc(header->no_merch, sizeof(unsigned char));   //Pages of zeros until records are built
+    snapshot->no_unbuilt    = header->no_merch;
+    
+    db_t *db = create_webstore();
+    db->snapshot        = snapshot;     //Unmapped with the store, also if loading fails below
+    db->carts_created   = header->carts_created;
+    if(!load_carts(db))
+    {
+        destroy_webstore(db);
+        return NULL;
+    }
+    return db;
+}
@@ -0,0 +1,19 @@
+#include "headers/business_logic.h"
+#include "headers/generic_utils.h"
+#include "headers/user_interface.h"
+
+int main()
+{
+    db_t *yo = create_webstore();
+    ioopm_arena_t *answers = ioopm_arena_create(0);    //The store copies the name, so it only lives as long as the prompt
+    
+    char *name = ask_question_string_in(answers, "name\n");
+    char *desc = ask_question_string("desc\n");    //Taken over by the store
+    
+    bl_add_merchandise(yo, name, desc, 4);
+    printf("Hello world!\n");
+    bl_remove_merchandise(yo, name);
+    ioopm_arena_destroy(&answers);
+    destroy_webstore(yo);
+    return 0;
+}
\ No newline at end of file
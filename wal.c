@@ -0,0 +1,705 @@
+#include "headers/business_logic_internal.h"
+#include "headers/operations.h"
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// A store kept on disk is a directory of snapshots and log segments:
+//
+//   snapshot-N     the store as it was when segment N was started
+//   wal-N          the operations applied after that, in order
+//
+// Opening the store loads the latest snapshot and replays the segments from its number on.
+// Every bl_* call that changes the store appends its operation to the log and returns once
+// the operation is on disk. Appending only copies the record into a buffer; a flusher thread
+// writes and syncs the buffer, and everything appended while a sync is running goes out
+// together in the next one. A caller that appends many operations (an import or a batch
+// checkout) waits once, after the last one.
+//
+// If a write or sync fails, the log is failed for good: what was written after the last good
+// sync may be torn, and replay would stop there anyway. Nothing from then on becomes durable,
+// so every later commit fails and the store has to be reopened from disk.
+//
+// Compaction starts a new segment and forks. The child writes the snapshot of that moment
+// from its copy of the store while the parent goes on logging to the new segment, and the
+// older files are removed once the snapshot is complete.
+//
+// A record is | payload length (u32) | crc32 of payload (u32) | encoded operation |, the
+// integers little endian. Replay stops at the first record that is cut short or does not
+// match its crc, which is where a crash interrupted the last write.
+
+#define Record_header_size  8
+#define Compact_after       (64 << 20)      //Bytes logged to a segment before it is compacted
+#define Initial_buffer_size (64 << 10)
+#define Flush_after         (1 << 20)       //Bytes buffered before they are written without waiting for a commit
+#define Path_size           4096
+
+struct wal
+{
+    char            *dir;
+    int             fd;                 //The segment being appended to
+    uint64_t        segment;
+    uint64_t        segment_bytes;
+    pthread_mutex_t lock;
+    pthread_cond_t  pending;            //Signalled when a flush is requested or the log is closed
+    pthread_cond_t  synced;             //Signalled when a sync is done
+    char            *buffer;            //Records appended and not yet handed to the flusher
+    size_t          used;
+    size_t          capacity;
+    char            *writing;           //Records being written by the flusher
+    size_t          writing_capacity;
+    uint64_t        appended;           //Log position after the last record appended
+    uint64_t        durable;            //Log position up to which everything is synced
+    int             error;              //errno of the write or sync that failed the log, or 0
+    bool            defer_commits;      //Commits wait for bl_commit instead
+    bool            flush_requested;    //Set when records are to be written without waiting for more
+    bool            closing;
+    pthread_t       flusher;
+    pid_t           compactor;          //The process writing a snapshot, or 0
+    uint64_t        compacting;         //The number of the snapshot it writes
+    bl_log_stats_t  stats;
+};
+
+/*=================================================================
+ *  Records
+ *=================================================================*/
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
+
+static void init_crc_table()
+{
+    for(uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t crc = i;
+        for(int bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320 : 0);
+        }
+        crc_table[i] = crc;
+    }
+}
+
+static uint32_t crc32(char *buf, size_t length)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for(size_t i = 0; i < length; ++i)
+    {
+        crc = (crc >> 8) ^ crc_table[(crc ^ (uint8_t) buf[i]) & 0xFF];
+    }
+    return ~crc;
+}
+
+static void put_u32(char *buf, uint32_t value)
+{
+    for(int i = 0; i < 4; ++i)
+    {
+        buf[i] = (char) (value >> (8 * i));
+    }
+}
+
+static uint32_t get_u32(char *buf)
+{
+    uint32_t value = 0;
+    for(int i = 0; i < 4; ++i)
+    {
+        value |= (uint32_t) (uint8_t) buf[i] << (8 * i);
+    }
+    return value;
+}
+
+static uint64_t now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*=================================================================
+ *  Files
+ *=================================================================*/
+
+static void file_path(char *buf, char *dir, char *kind, uint64_t number)
+{
+    snprintf(buf, Path_size, "%s/%s-%010" PRIu64, dir, kind, number);
+}
+
+//Parses the number of a file named kind-N, returns false for other names
+static bool file_number(char *name, char *kind, uint64_t *number)
+{
+    size_t length = strlen(kind);
+    if(strncmp(name, kind, length) != 0 || name[length] != '-' || name[length + 1] == '\0')
+    {
+        return false;
+    }
+    char *end;
+    *number = strtoull(name + length + 1, &end, 10);
+    return *end == '\0';
+}
+
+static bool sync_dir(char *dir)
+{
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if(fd < 0)
+    {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
+static int create_segment(char *dir, uint64_t segment)
+{
+    char path[Path_size];
+    file_path(path, dir, "wal", segment);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if(fd >= 0 && !sync_dir(dir))   //Or the segment may be lost even though its records were synced
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+//Removes all snapshots and segments numbered below first, and unfinished snapshots
+static void remove_files_before(char *dir, uint64_t first)
+{
+    DIR *entries = opendir(dir);
+    struct dirent *entry;
+    while(entries != NULL && (entry = readdir(entries)) != NULL)
+    {
+        uint64_t number;
+        char *dot = strrchr(entry->d_name, '.');
+        bool unfinished = dot != NULL && strcmp(dot, ".tmp") == 0;
+        if(unfinished || ((file_number(entry->d_name, "snapshot", &number) || file_number(entry->d_name, "wal", &number))
+                          && number < first))
+        {
+            char path[Path_size];
+            snprintf(path, Path_size, "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    if(entries != NULL)
+    {
+        closedir(entries);
+    }
+}
+
+/*=================================================================
+ *  Appending
+ *=================================================================*/
+
+static bool write_all(int fd, char *buf, size_t length)
+{
+    while(length > 0)
+    {
+        ssize_t written = write(fd, buf, length);
+        if(written < 0 && errno != EINTR)
+        {
+            return false;
+        }
+        if(written > 0)
+        {
+            buf += written;
+            length -= written;
+        }
+    }
+    return true;
+}
+
+//Called with the lock held
+static void request_flush(wal_t *wal)
+{
+    wal->flush_requested = true;
+    pthread_cond_signal(&wal->pending);
+}
+
+static void *flush_log(void *arg)
+{
+    wal_t *wal = arg;
+    pthread_mutex_lock(&wal->lock);
+    while(true)
+    {
+        while(!wal->closing && (wal->used == 0 || !wal->flush_requested))
+        {
+            pthread_cond_wait(&wal->pending, &wal->lock);
+        }
+        if(wal->used == 0)
+        {
+            break; //Closing and everything is written
+        }
+        
+        //Take the whole buffer, appends go on into the other one while this is written
+        char *records = wal->buffer;
+        size_t no_bytes = wal->used;
+        size_t capacity = wal->capacity;
+        uint64_t end = wal->appended;
+        int fd = wal->fd;
+        wal->buffer = wal->writing;
+        wal->capacity = wal->writing_capacity;
+        wal->writing = records;
+        wal->writing_capacity = capacity;
+        wal->used = 0;
+        wal->flush_requested = false;
+        bool failed = wal->error != 0;
+        pthread_mutex_unlock(&wal->lock);
+        
+        //Records after a failure are dropped, they would follow what may be a torn record
+        uint64_t start = now_ns();
+        int error = 0;
+        if(!failed && !(write_all(fd, records, no_bytes) && fdatasync(fd) == 0))
+        {
+            error = errno != 0 ? errno : EIO;
+        }
+        uint64_t time = now_ns() - start;
+        
+        pthread_mutex_lock(&wal->lock);
+        if(error != 0)
+        {
+            wal->error = error;
+            wal->stats.failed = true;
+            wal->stats.error = error;
+        }
+        else if(!failed)
+        {
+            wal->durable = end;
+            wal->stats.no_syncs += 1;
+            wal->stats.sync_ns += time;
+        }
+        pthread_cond_broadcast(&wal->synced);
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return NULL;
+}
+
+void log_operation(db_t *db, operation_t *op)
+{
+    wal_t *wal = db->wal;
+    if(wal == NULL)
+    {
+        return; //The store is not kept on disk
+    }
+    
+    size_t max_size = Record_header_size + max_encoded_size(op);
+    pthread_mutex_lock(&wal->lock);
+    if(wal->used + max_size > wal->capacity)
+    {
+        while(wal->used + max_size > wal->capacity)
+        {
+            wal->capacity *= 2;
+        }
+        wal->buffer = realloc(wal->buffer, wal->capacity);
+    }
+    
+    char *record = wal->buffer + wal->used;
+    size_t length = encode_operation(op, record + Record_header_size);
+    put_u32(record, length);
+    put_u32(record + 4, crc32(record + Record_header_size, length));
+    
+    wal->used           += Record_header_size + length;
+    wal->appended       += Record_header_size + length;
+    wal->segment_bytes  += Record_header_size + length;
+    wal->stats.no_records += 1;
+    wal->stats.no_bytes += Record_header_size + length;
+    if(wal->used >= Flush_after)
+    {
+        request_flush(wal);
+    }
+    pthread_mutex_unlock(&wal->lock);
+}
+
+static void finish_compaction(wal_t *wal, bool wait);
+
+bool bl_commit(db_t *db)
+{
+    wal_t *wal = db->wal;
+    if(wal == NULL)
+    {
+        return true;
+    }
+    
+    uint64_t start = now_ns();
+    pthread_mutex_lock(&wal->lock);
+    uint64_t position = wal->appended;
+    if(wal->durable < position)
+    {
+        request_flush(wal);
+    }
+    while(wal->durable < position && wal->error == 0)
+    {
+        pthread_cond_wait(&wal->synced, &wal->lock);
+    }
+    bool committed = wal->durable >= position;
+    uint64_t time = now_ns() - start;
+    wal->stats.no_commits += 1;
+    wal->stats.commit_ns += time;
+    wal->stats.max_commit_ns = time > wal->stats.max_commit_ns ? time : wal->stats.max_commit_ns;
+    bool compact = committed && wal->segment_bytes >= Compact_after;
+    pthread_mutex_unlock(&wal->lock);
+    
+    finish_compaction(wal, false);
+    if(compact)
+    {
+        bl_compact_store(db);
+    }
+    return committed;
+}
+
+bool commit_log(db_t *db)
+{
+    return db->wal == NULL || db->wal->defer_commits || bl_commit(db);
+}
+
+void bl_defer_commits(db_t *db, bool defer)
+{
+    if(db->wal != NULL)
+    {
+        db->wal->defer_commits = defer;
+    }
+}
+
+bool commit_operation(db_t *db, operation_t *op)
+{
+    log_operation(db, op);
+    return commit_log(db);
+}
+
+static wal_t *start_log(char *dir, uint64_t segment)
+{
+    int fd = create_segment(dir, segment);
+    if(fd < 0)
+    {
+        return NULL;
+    }
+    
+    wal_t *wal = calloc(1, sizeof(wal_t));
+    wal->dir                = strdup(dir);
+    wal->fd                 = fd;
+    wal->segment            = segment;
+    wal->capacity           = Initial_buffer_size;
+    wal->buffer             = malloc(wal->capacity);
+    wal->writing_capacity   = Initial_buffer_size;
+    wal->writing            = malloc(wal->writing_capacity);
+    pthread_mutex_init(&wal->lock, NULL);
+    pthread_cond_init(&wal->pending, NULL);
+    pthread_cond_init(&wal->synced, NULL);
+    pthread_create(&wal->flusher, NULL, flush_log, wal);
+    return wal;
+}
+
+void close_log(db_t *db)
+{
+    wal_t *wal = db->wal;
+    db->wal = NULL;
+    
+    pthread_mutex_lock(&wal->lock);
+    wal->closing = true;
+    pthread_cond_signal(&wal->pending);
+    pthread_mutex_unlock(&wal->lock);
+    pthread_join(wal->flusher, NULL);   //It writes out everything appended before it stops
+    close(wal->fd);
+    finish_compaction(wal, true);
+    
+    pthread_mutex_destroy(&wal->lock);
+    pthread_cond_destroy(&wal->pending);
+    pthread_cond_destroy(&wal->synced);
+    free(wal->buffer);
+    free(wal->writing);
+    free(wal->dir);
+    free(wal);
+}
+
+bool bl_log_stats(db_t *db, bl_log_stats_t *stats)
+{
+    wal_t *wal = db->wal;
+    if(wal == NULL)
+    {
+        return false;
+    }
+    
+    pthread_mutex_lock(&wal->lock);
+    *stats = wal->stats;
+    pthread_mutex_unlock(&wal->lock);
+    return true;
+}
+
+/*=================================================================
+ *  Compaction
+ *=================================================================*/
+
+//Starts segment number + 1 once everything appended to the current one is synced
+static bool rotate_segment(wal_t *wal)
+{
+    pthread_mutex_lock(&wal->lock);
+    if(wal->durable < wal->appended)
+    {
+        request_flush(wal);
+    }
+    while(wal->durable < wal->appended && wal->error == 0)
+    {
+        pthread_cond_wait(&wal->synced, &wal->lock);
+    }
+    if(wal->error != 0)
+    {
+        pthread_mutex_unlock(&wal->lock);
+        return false; //The log is failed, a snapshot would take in changes that were never durable
+    }
+    int fd = create_segment(wal->dir, wal->segment + 1);
+    if(fd >= 0)
+    {
+        close(wal->fd);
+        wal->fd = fd;
+        wal->segment += 1;
+        wal->segment_bytes = 0;
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return fd >= 0;
+}
+
+//Runs in the forked child, on its own copy of the store
+static bool write_snapshot(db_t *db, char *dir, uint64_t number)
+{
+    char path[Path_size];
+    file_path(path, dir, "snapshot", number);
+    return bl_save_snapshot(db, path);     //Written next to path and renamed over it
+}
+
+static void finish_compaction(wal_t *wal, bool wait)
+{
+    int status;
+    if(wal->compactor == 0 || waitpid(wal->compactor, &status, wait ? 0 : WNOHANG) != wal->compactor)
+    {
+        return; //None is running, or it is not done yet
+    }
+    
+    if(WIFEXITED(status) && WEXITSTATUS(status) == 0)
+    {
+        remove_files_before(wal->dir, wal->compacting);     //The new snapshot covers them
+        wal->stats.no_compactions += 1;
+    }
+    wal->compactor = 0;
+}
+
+bool bl_compact_store(db_t *db)
+{
+    wal_t *wal = db->wal;
+    if(wal == NULL)
+    {
+        return false;
+    }
+    
+    finish_compaction(wal, false);
+    if(wal->compactor != 0 || !rotate_segment(wal))
+    {
+        return false; //One compaction at a time
+    }
+    
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        _exit(write_snapshot(db, wal->dir, wal->segment) ? 0 : 1);
+    }
+    if(pid < 0)
+    {
+        return false;
+    }
+    
+    wal->compactor = pid;
+    wal->compacting = wal->segment;
+    return true;
+}
+
+/*=================================================================
+ *  Opening
+ *=================================================================*/
+
+//Applies the records of a segment to db. *valid_length is set to the length of the records
+//that could be read, returns false if one of them could not be applied
+static bool replay_segment(db_t *db, char *path, size_t *valid_length)
+{
+    *valid_length = 0;
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    size_t size = file_stat.st_size;
+    char *base = size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if(base == MAP_FAILED)
+    {
+        return false;
+    }
+    
+    bool applied = true;
+    size_t offset = 0;
+    while(applied && offset + Record_header_size <= size)
+    {
+        char *payload = base + offset + Record_header_size;
+        uint32_t length = get_u32(base + offset);
+        operation_t op;
+        if(length > size - offset - Record_header_size || get_u32(base + offset + 4) != crc32(payload, length)
+           || decode_operation(payload, length, &op) != length)
+        {
+            break; //The end of what was written before a crash
+        }
+        
+        int cart_id;
+        applied = apply_operation(db, &op, &cart_id) && (op.kind != Op_create_cart || cart_id == op.cart_id);
+        offset += Record_header_size + length;
+    }
+    
+    *valid_length = offset;
+    if(base != NULL)
+    {
+        munmap(base, size);
+    }
+    return applied;
+}
+
+//Cuts the torn tail off a segment, for good, so records appended after it are not lost behind it
+static bool cut_segment(char *path, size_t length)
+{
+    int fd = open(path, O_WRONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+    bool cut = ftruncate(fd, length) == 0 && fsync(fd) == 0;
+    close(fd);
+    return cut;
+}
+
+static int compare_numbers(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+//Finds the latest snapshot and the segments to replay on top of it, in order
+static bool find_files(char *dir, uint64_t *snapshot, bool *has_snapshot, uint64_t **segments, size_t *no_segments)
+{
+    DIR *entries = opendir(dir);
+    if(entries == NULL)
+    {
+        return false;
+    }
+    
+    size_t capacity = 16;
+    *segments = calloc(capacity, sizeof(uint64_t));
+    *no_segments = 0;
+    *snapshot = 0;
+    *has_snapshot = false;
+    
+    struct dirent *entry;
+    uint64_t number;
+    while((entry = readdir(entries)) != NULL)
+    {
+        if(file_number(entry->d_name, "snapshot", &number) && (!*has_snapshot || number > *snapshot))
+        {
+            *snapshot = number;
+            *has_snapshot = true;
+        }
+        else if(file_number(entry->d_name, "wal", &number))
+        {
+            if(*no_segments == capacity)
+            {
+                capacity *= 2;
+                *segments = realloc(*segments, capacity * sizeof(uint64_t));
+            }
+            (*segments)[(*no_segments)++] = number;
+        }
+    }
+    closedir(entries);
+    qsort(*segments, *no_segments, sizeof(uint64_t), compare_numbers);
+    return true;
+}
+
+db_t *bl_open_store(char *dir)
+{
+    pthread_once(&crc_table_once, init_crc_table);
+    if(mkdir(dir, 0755) != 0 && errno != EEXIST)
+    {
+        return NULL;
+    }
+    
+    uint64_t snapshot, *segments;
+    size_t no_segments;
+    bool has_snapshot;
+    if(!find_files(dir, &snapshot, &has_snapshot, &segments, &no_segments))
+    {
+        return NULL;
+    }
+    
+    char path[Path_size];
+    file_path(path, dir, "snapshot", snapshot);
+    db_t *db = has_snapshot ? bl_load_snapshot(path) : create_webstore();
+    
+    uint64_t last = snapshot;
+    bool torn = false;
+    for(size_t i = 0; db != NULL && i < no_segments; ++i)
+    {
+        if(segments[i] < snapshot)
+        {
+            continue; //Left behind by a compaction that did not get to remove it
+        }
+        
+        file_path(path, dir, "wal", segments[i]);
+        if(torn)
+        {
+            if(unlink(path) != 0)   //Written after a record that was lost, so it cannot be applied
+            {
+                destroy_webstore(db);
+                db = NULL;
+            }
+            continue;
+        }
+        
+        size_t valid_length;
+        struct stat file_stat;
+        if(!replay_segment(db, path, &valid_length) || stat(path, &file_stat) != 0)
+        {
+            destroy_webstore(db);   //The log does not match the snapshot, or could not be read
+            db = NULL;
+            break;
+        }
+        
+        torn = (size_t) file_stat.st_size > valid_length;
+        if(torn && !cut_segment(path, valid_length))
+        {
+            destroy_webstore(db);   //The next replay would stop at the torn tail, before what is appended now
+            db = NULL;
+            break;
+        }
+        last = segments[i];
+    }
+    free(segments);
+    
+    if(db != NULL)
+    {
+        db->wal = start_log(dir, last + 1);     //Always a new segment, the last one may end in a torn record
+        if(db->wal == NULL)
+        {
+            destroy_webstore(db);
+            db = NULL;
+        }
+    }
+    return db;
+}